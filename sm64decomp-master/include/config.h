@@ -23,6 +23,51 @@
 /// Fixes bug where it shows a star when you grab a key in bowser battle stages
 #define BUGFIX_STAR_BOWSER_KEY (0 || VERSION_US || VERSION_EU || VERSION_SH)
 
+// Performance
+// These are all disabled by default so that the matching build is unaffected.
+/// Subdivides crowded static surface cells into a quadtree at area load
+#define SURFACE_QUADTREE 0
+/// Copies static floor and ceiling lists into packed arrays for find_floor/find_ceil
+#define SURFACE_PACKED_LISTS 0
+/// Reuses the surfaces of platforms whose transform hasn't changed since last frame
+#define DYNAMIC_SURFACE_CACHE 0
+/// Grows the surface and surface node pools in chunks instead of overflowing them
+#define SURFACE_POOL_ARENAS 0
+/// Records time spent per object list, behavior, and collision phase for the profiler
+#define OBJECT_PROFILER 0
+/// Finds colliding objects through a uniform grid instead of testing every pair
+#define OBJECT_COLLISION_GRID 0
+/// Runs behavior scripts from a cache of predecoded commands
+#define BEHAVIOR_SCRIPT_CACHE 0
+/// Culls static level geometry against the view frustum using bounds found at load time
+#define GEO_FRUSTUM_CULLING 0
+/// Sorts opaque master list layers by display list and skips repeated matrix loads
+#define MASTER_LIST_SORTING 0
+/// Keeps the matrices of level geometry's transform nodes until the camera moves
+#define GEO_STATIC_MATRIX_CACHE 0
+/// Uses SSE2 for matrix multiplication and float-to-fixed conversion in host builds
+#define SIMD_MATRIX_MATH 0
+/// Expands animations into per-frame tables, and keeps recently loaded Mario animations in RAM
+#define ANIMATION_CACHE 0
+/// Evaluates each animation frame's part matrices once per frame and shares them between objects
+#define ANIMATION_POSES 0
+/// With ANIMATION_POSES, blends between frames by the frame fraction of accelerated animations
+#define POSE_INTERPOLATION 0
+/// The maximum number of objects that can be loaded at once (240 in the original game)
+#define OBJECT_POOL_CAPACITY 240
+/// Clears new objects in bulk, tags object slots with generations, and counts live objects per behavior
+#define OBJECT_POOL_TELEMETRY 0
+/// Records main pool allocations and peak usage per area, and checks pushed pool states
+#define MAIN_POOL_TRACKING 0
+/// Queues the level script's segment loads and decompresses each one while the next is read from ROM
+#define SEGMENT_LOAD_PIPELINE 0
+/// Replaces the handwritten MIO0 decoder with one that copies aligned lookbacks a word at a time and can decode in steps
+#define MIO0_FAST_DECODER 0
+/// In the headless build, runs the audio command lists on the host so that the game's audio can be timed and rendered
+#define HOST_AUDIO_MIXER 0
+/// Files active notes into per-priority buckets so that stealing a note only scans notes of priority 16 or more (not on SH)
+#define NOTE_PRIORITY_BUCKETS 0
+
 // Screen Size Defines
 #define SCREEN_WIDTH 320
 #define SCREEN_HEIGHT 240
@@ -6,6 +6,7 @@
 
 #include <ultra64.h>
 #include "macros.h"
+#include "config.h"
 
 
 // Certain functions are marked as having return values, but do not
@@ -107,6 +108,12 @@ struct GraphNode
     /*0x08*/ struct GraphNode *next;
     /*0x0C*/ struct GraphNode *parent;
     /*0x10*/ struct GraphNode *children;
+#if GEO_FRUSTUM_CULLING
+    /*0x14*/ struct GraphNodeBounds *bounds; // set for static level geometry
+#endif
+#if GEO_STATIC_MATRIX_CACHE
+    struct GraphNodeMatrixCache *matrixCache; // set for static transform nodes
+#endif
 };
 
 struct AnimInfo
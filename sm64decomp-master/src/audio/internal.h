@@ -39,6 +39,17 @@
 #define NOTE_PRIORITY_MIN 2
 #define NOTE_PRIORITY_DEFAULT 3
 
+// SH also steals notes from the releasing lists, and changes the priorities of
+// the notes in them, so it keeps scanning the lists.
+#if NOTE_PRIORITY_BUCKETS && !defined(VERSION_SH)
+#define NOTE_BUCKETS 1
+#else
+#define NOTE_BUCKETS 0
+#endif
+// Priorities below this get a bucket each, and the rest share the last one.
+#define NOTE_BUCKET_SHARED 16
+#define NOTE_BUCKET_COUNT (NOTE_BUCKET_SHARED + 1)
+
 #define TATUMS_PER_BEAT 48
 
 #ifdef VERSION_JP
@@ -104,6 +115,15 @@ struct AudioListItem
         s32 count;
     } u;
     struct NotePool *pool;
+#if NOTE_BUCKETS
+    // Notes in an active list are also linked into the bucket for their
+    // priority. 'bucket' is the bucket's index plus one, or 0 if the item
+    // isn't in one, and 'bucketKey' orders the list's items.
+    struct AudioListItem *bucketPrev;
+    struct AudioListItem *bucketNext;
+    s32 bucket;
+    s32 bucketKey;
+#endif
 }; // size = 0x10
 
 struct NotePool
@@ -112,6 +132,15 @@ struct NotePool
     struct AudioListItem decaying;
     struct AudioListItem releasing;
     struct AudioListItem active;
+#if NOTE_BUCKETS
+    // The active notes by priority, each bucket in list order. A bit is set
+    // in the mask for each bucket that isn't empty.
+    u32 activeBucketMask;
+    s32 activeFrontKey;
+    s32 activeBackKey;
+    struct AudioListItem *activeBucketHead[NOTE_BUCKET_COUNT];
+    struct AudioListItem *activeBucketTail[NOTE_BUCKET_COUNT];
+#endif
 };
 
 struct VibratoState {
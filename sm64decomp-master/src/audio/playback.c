@@ -376,6 +376,11 @@ void process_notes(void) {
 
     // Macro versions of audio_list_push_front and audio_list_remove.
     // Should ideally be changed to use copt.
+#if NOTE_BUCKETS
+    // The functions keep the buckets up to date.
+#define PREPEND(item, head_arg) (it = (item), audio_list_push_front((head_arg), it))
+#define POP(item) (it = (item), it->prev == NULL ? it : (audio_list_remove(it), it))
+#else
 #define PREPEND(item, head_arg)                                                                        \
     ((it = (item), it->prev != NULL)                                                                   \
          ? it                                                                                          \
@@ -385,6 +390,7 @@ void process_notes(void) {
     ((it = (item), it->prev == NULL)                                                                   \
          ? it                                                                                          \
          : (it->prev->next = it->next, it->next->prev = it->prev, it->prev = NULL, it))
+#endif
 
     for (i = 0; i < gMaxSimultaneousNotes; i++) {
         note = &gNotes[i];
@@ -434,6 +440,9 @@ void process_notes(void) {
                 eu_stubbed_printf_0("CAUTION:SUB IS SEPARATED FROM GROUP");
                 sequence_channel_disable(playbackState->parentLayer->seqChannel);
                 playbackState->priority = NOTE_PRIORITY_STOPPING;
+#if NOTE_BUCKETS
+                note_priority_changed(note);
+#endif
                 continue;
             } else if (playbackState->parentLayer->seqChannel->seqPlayer->muted) {
                 if ((playbackState->parentLayer->seqChannel->muteBehavior
@@ -802,6 +811,10 @@ void seq_channel_layer_decay_release_internal(struct SequenceChannelLayer *seqLa
         audio_list_remove(&note->listItem);
         audio_list_push_front(&note->listItem.pool->decaying, &note->listItem);
     }
+#if NOTE_BUCKETS
+    // a released note stays in the active list
+    note_priority_changed(note);
+#endif
 }
 
 void seq_channel_layer_note_decay(struct SequenceChannelLayer *seqLayer) {
@@ -949,6 +962,9 @@ void init_note_lists(struct NotePool *pool) {
     pool->decaying.pool = pool;
     pool->releasing.pool = pool;
     pool->active.pool = pool;
+#if NOTE_BUCKETS
+    note_buckets_init(pool);
+#endif
 }
 
 void init_note_free_list(void) {
@@ -958,6 +974,9 @@ void init_note_free_list(void) {
     for (i = 0; i < gMaxSimultaneousNotes; i++) {
         gNotes[i].listItem.u.value = &gNotes[i];
         gNotes[i].listItem.prev = NULL;
+#if NOTE_BUCKETS
+        gNotes[i].listItem.bucket = 0;
+#endif
         audio_list_push_back(&gNoteFreeLists.disabled, &gNotes[i].listItem);
     }
 }
@@ -1079,6 +1098,9 @@ void audio_list_push_front(struct AudioListItem *list, struct AudioListItem *ite
         list->next = item;
         list->u.count++;
         item->pool = list->pool;
+#if NOTE_BUCKETS
+        note_bucket_add(list, item, TRUE);
+#endif
     }
 }
 
@@ -1090,9 +1112,179 @@ void audio_list_remove(struct AudioListItem *item) {
         item->prev->next = item->next;
         item->next->prev = item->prev;
         item->prev = NULL;
+#if NOTE_BUCKETS
+        note_bucket_remove(item);
+#endif
+    }
+}
+
+#if NOTE_BUCKETS
+// Each pool's active notes are also kept in buckets by priority, so that the
+// note to steal is the last note of the lowest bucket in use. A bucket keeps
+// its notes in list order, which holds as long as notes are only added at the
+// ends of the list; when a listed note's priority changes, its key, which
+// grows along the list, says where it goes in its new bucket. Finding that
+// place walks back from the bucket's tail, so it costs up to the size of the
+// new bucket. Other places that change a note's priority move it out of the
+// active list right after.
+
+// Keys are renumbered before they get this far from 0.
+#define NOTE_BUCKET_KEY_LIMIT 0x40000000
+
+void note_buckets_init(struct NotePool *pool) {
+    s32 i;
+
+    pool->activeBucketMask = 0;
+    pool->activeFrontKey = 0;
+    pool->activeBackKey = 0;
+    for (i = 0; i < NOTE_BUCKET_COUNT; i++) {
+        pool->activeBucketHead[i] = NULL;
+        pool->activeBucketTail[i] = NULL;
+    }
+}
+
+static s32 note_bucket_for_priority(s32 priority) {
+    return priority < NOTE_BUCKET_SHARED ? priority : NOTE_BUCKET_SHARED;
+}
+
+// Link 'item' into bucket 'b' before 'next', or at the end if 'next' is NULL.
+static void note_bucket_link(struct NotePool *pool, struct AudioListItem *item, s32 b,
+                             struct AudioListItem *next) {
+    item->bucket = b + 1;
+    item->bucketNext = next;
+    if (next == NULL) {
+        item->bucketPrev = pool->activeBucketTail[b];
+        pool->activeBucketTail[b] = item;
+    } else {
+        item->bucketPrev = next->bucketPrev;
+        next->bucketPrev = item;
+    }
+    if (item->bucketPrev == NULL) {
+        pool->activeBucketHead[b] = item;
+    } else {
+        item->bucketPrev->bucketNext = item;
+    }
+    pool->activeBucketMask |= 1 << b;
+}
+
+static void note_bucket_unlink(struct NotePool *pool, struct AudioListItem *item) {
+    s32 b = item->bucket - 1;
+
+    if (item->bucketPrev == NULL) {
+        pool->activeBucketHead[b] = item->bucketNext;
+    } else {
+        item->bucketPrev->bucketNext = item->bucketNext;
+    }
+    if (item->bucketNext == NULL) {
+        pool->activeBucketTail[b] = item->bucketPrev;
+    } else {
+        item->bucketNext->bucketPrev = item->bucketPrev;
+    }
+    if (pool->activeBucketHead[b] == NULL) {
+        pool->activeBucketMask &= ~(1 << b);
+    }
+    item->bucket = 0;
+}
+
+/**
+ * File an item just added to the front or back of 'list' into its bucket, if
+ * 'list' is a pool's active list.
+ */
+void note_bucket_add(struct AudioListItem *list, struct AudioListItem *item, s32 atFront) {
+    struct NotePool *pool = list->pool;
+    struct AudioListItem *cur;
+    s32 b;
+
+    if (pool == NULL || list != &pool->active) {
+        return;
+    }
+
+    if (pool->activeBucketMask == 0) {
+        pool->activeFrontKey = 0;
+        pool->activeBackKey = 0;
+    } else if (pool->activeFrontKey <= -NOTE_BUCKET_KEY_LIMIT
+               || pool->activeBackKey >= NOTE_BUCKET_KEY_LIMIT) {
+        pool->activeFrontKey = 0;
+        pool->activeBackKey = 0;
+        for (cur = list->next; cur != list; cur = cur->next) {
+            cur->bucketKey = ++pool->activeBackKey;
+        }
+    }
+
+    b = note_bucket_for_priority(((struct Note *) item->u.value)->priority);
+    if (atFront) {
+        item->bucketKey = --pool->activeFrontKey;
+        note_bucket_link(pool, item, b, pool->activeBucketHead[b]);
+    } else {
+        item->bucketKey = ++pool->activeBackKey;
+        note_bucket_link(pool, item, b, NULL);
+    }
+}
+
+void note_bucket_remove(struct AudioListItem *item) {
+    if (item->bucket != 0) {
+        note_bucket_unlink(item->pool, item);
+    }
+}
+
+/**
+ * Move a note that stays in its list to the bucket for its new priority. This
+ * walks the new bucket from its tail to the first note that comes before it
+ * in the list; a released note usually goes near the tail of the
+ * NOTE_PRIORITY_STOPPING bucket.
+ */
+void note_priority_changed(struct Note *note) {
+    struct AudioListItem *item = &note->listItem;
+    struct AudioListItem *next = NULL;
+    struct AudioListItem *cur;
+    s32 b;
+
+    if (item->bucket == 0) {
+        return;
+    }
+
+    b = note_bucket_for_priority(note->priority);
+    if (item->bucket == b + 1) {
+        return;
+    }
+
+    note_bucket_unlink(item->pool, item);
+    for (cur = item->pool->activeBucketTail[b]; cur != NULL && cur->bucketKey > item->bucketKey;
+         cur = cur->bucketPrev) {
+        next = cur;
     }
+    note_bucket_link(item->pool, item, b, next);
 }
 
+// The item pop_node_with_lower_prio would find by scanning the active list:
+// the last of the notes with the lowest priority. This only scans when the
+// lowest bucket in use is the shared one.
+static struct AudioListItem *note_bucket_find_lowest(struct NotePool *pool) {
+    u32 mask = pool->activeBucketMask;
+    struct AudioListItem *cur;
+    struct AudioListItem *best;
+    s32 b;
+
+#ifdef __GNUC__
+    b = __builtin_ctz(mask);
+#else
+    for (b = 0; !(mask & (1 << b)); b++) {
+    }
+#endif
+
+    if (b != NOTE_BUCKET_SHARED) {
+        return pool->activeBucketTail[b];
+    }
+
+    for (best = cur = pool->activeBucketHead[b]; cur != NULL; cur = cur->bucketNext) {
+        if (((struct Note *) best->u.value)->priority >= ((struct Note *) cur->u.value)->priority) {
+            best = cur;
+        }
+    }
+    return best;
+}
+#endif
+
 struct Note *pop_node_with_lower_prio(struct AudioListItem *list, s32 limit) {
     struct AudioListItem *cur = list->next;
     struct AudioListItem *best;
@@ -1101,6 +1293,11 @@ struct Note *pop_node_with_lower_prio(struct AudioListItem *list, s32 limit) {
         return NULL;
     }
 
+#if NOTE_BUCKETS
+    if (list->pool != NULL && list == &list->pool->active) {
+        best = note_bucket_find_lowest(list->pool);
+    } else
+#endif
     for (best = cur; cur != list; cur = cur->next) {
         if (((struct Note *) best->u.value)->priority >= ((struct Note *) cur->u.value)->priority) {
             best = cur;
@@ -1397,9 +1594,15 @@ void reclaim_notes(void) {
                 audio_list_push_back(&gLayerFreeList, &note->parentLayer->listItem);
                 seq_channel_layer_disable(note->parentLayer);
                 note->priority = NOTE_PRIORITY_STOPPING;
+#if NOTE_BUCKETS
+                note_priority_changed(note);
+#endif
             } else if (note->parentLayer->seqChannel->seqPlayer == NULL) {
                 sequence_channel_disable(note->parentLayer->seqChannel);
                 note->priority = NOTE_PRIORITY_STOPPING;
+#if NOTE_BUCKETS
+                note_priority_changed(note);
+#endif
             } else if (note->parentLayer->seqChannel->seqPlayer->muted) {
                 if (note->parentLayer->seqChannel->muteBehavior
                     & (MUTE_BEHAVIOR_STOP_SCRIPT | MUTE_BEHAVIOR_STOP_NOTES)) {
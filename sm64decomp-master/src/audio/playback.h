@@ -29,6 +29,12 @@ void audio_list_remove(struct AudioListItem *item);
 struct Note *alloc_note(struct SequenceChannelLayer *seqLayer);
 void reclaim_notes(void);
 void note_init_all(void);
+#if NOTE_BUCKETS
+void note_buckets_init(struct NotePool *pool);
+void note_bucket_add(struct AudioListItem *list, struct AudioListItem *item, s32 atFront);
+void note_bucket_remove(struct AudioListItem *item);
+void note_priority_changed(struct Note *note);
+#endif
 
 #if defined(VERSION_SH)
 void note_set_vel_pan_reverb(struct Note *note, struct ReverbInfo *reverbInfo);
@@ -360,6 +360,9 @@ void audio_list_push_back(struct AudioListItem *list, struct AudioListItem *item
         list->prev = item;
         list->u.count++;
         item->pool = list->pool;
+#if NOTE_BUCKETS
+        note_bucket_add(list, item, FALSE);
+#endif
     }
 }
 
@@ -375,6 +378,9 @@ void *audio_list_pop_back(struct AudioListItem *list) {
     list->prev = item->prev;
     item->prev = NULL;
     list->u.count--;
+#if NOTE_BUCKETS
+    note_bucket_remove(item);
+#endif
     return item->u.value;
 }
 
@@ -0,0 +1,337 @@
+#include <ultra64.h>
+#include <string.h>
+
+#include "sm64.h"
+#include "anim_cache.h"
+#include "game/game_init.h"
+#include "game/memory.h"
+
+#if ANIMATION_CACHE
+
+/**
+ * The animation cache holds animations expanded into flat tables with one row
+ * per frame and one value per channel (three translation channels for the
+ * root, then three rotation channels per part), so that reading a part's
+ * values is an array access instead of a walk through the compressed index.
+ * It also keeps copies of Mario's animations as loaded from ROM, so that
+ * switching back to a recent animation doesn't DMA it again.
+ *
+ * Entries live in a memory pool allocated from the main pool when a level's
+ * objects are cleared, which also empties the cache since the level's data
+ * is about to be replaced. When the pool is full, the least recently used
+ * entries are evicted, but never ones used during the current frame, since
+ * the renderer may still be reading them.
+ */
+
+struct AnimCacheEntry {
+    struct AnimCacheEntry *prev; // toward the most recently used entry
+    struct AnimCacheEntry *next; // toward the least recently used entry
+    struct AnimCacheEntry *hashNext;
+    const void *key;
+    void *raw;
+    u32 rawSize;
+    s16 *frames;
+    s16 numFrames; // 0 once the animation turns out not to be cacheable
+    s16 numChannels;
+    u32 lastUsed;  // gGlobalTimer when the entry was last looked up
+};
+
+/**
+ * Buffers whose contents are loaded from somewhere else, keyed by the source
+ * instead since the buffer's own address is the same for every animation.
+ */
+struct AnimCacheSource {
+    struct Animation *anim;
+    const void *source;
+};
+
+struct AnimCacheStats gAnimCacheStats;
+
+static struct MemoryPool *sAnimCachePool = NULL;
+static struct AnimCacheEntry *sAnimCacheBuckets[ANIM_CACHE_NUM_BUCKETS];
+static struct AnimCacheEntry *sAnimCacheHead = NULL;
+static struct AnimCacheEntry *sAnimCacheTail = NULL;
+static struct AnimCacheSource sAnimCacheSources[ANIM_CACHE_NUM_SOURCES];
+
+#define ANIM_CACHE_BUCKET(key) (((uintptr_t)(key) >> 4) % ANIM_CACHE_NUM_BUCKETS)
+
+/**
+ * Allocate the cache's pool and empty it. The sources are kept, since the
+ * buffers still hold the same animations.
+ */
+void anim_cache_init(void) {
+    s32 i;
+
+    sAnimCachePool = mem_pool_init(ANIM_CACHE_SIZE, MEMORY_POOL_LEFT);
+    sAnimCacheHead = NULL;
+    sAnimCacheTail = NULL;
+    for (i = 0; i < ANIM_CACHE_NUM_BUCKETS; i++) {
+        sAnimCacheBuckets[i] = NULL;
+    }
+}
+
+/**
+ * Record that 'anim' now holds the animation loaded from 'source'.
+ */
+void anim_cache_set_source(struct Animation *anim, const void *source) {
+    s32 i;
+    s32 freeSlot = -1;
+
+    for (i = 0; i < ANIM_CACHE_NUM_SOURCES; i++) {
+        if (sAnimCacheSources[i].anim == anim) {
+            sAnimCacheSources[i].source = source;
+            return;
+        }
+        if (freeSlot < 0 && sAnimCacheSources[i].anim == NULL) {
+            freeSlot = i;
+        }
+    }
+
+    if (freeSlot >= 0) {
+        sAnimCacheSources[freeSlot].anim = anim;
+        sAnimCacheSources[freeSlot].source = source;
+    }
+}
+
+/**
+ * Move an entry to the front of the LRU list.
+ */
+static void anim_cache_touch(struct AnimCacheEntry *entry) {
+    entry->lastUsed = gGlobalTimer;
+    if (entry == sAnimCacheHead) {
+        return;
+    }
+
+    entry->prev->next = entry->next;
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        sAnimCacheTail = entry->prev;
+    }
+
+    entry->prev = NULL;
+    entry->next = sAnimCacheHead;
+    sAnimCacheHead->prev = entry;
+    sAnimCacheHead = entry;
+}
+
+/**
+ * Unlink the least recently used entry and free everything it holds.
+ */
+static void anim_cache_evict_tail(void) {
+    struct AnimCacheEntry *entry = sAnimCacheTail;
+    struct AnimCacheEntry **link = &sAnimCacheBuckets[ANIM_CACHE_BUCKET(entry->key)];
+
+    while (*link != entry) {
+        link = &(*link)->hashNext;
+    }
+    *link = entry->hashNext;
+
+    sAnimCacheTail = entry->prev;
+    if (sAnimCacheTail != NULL) {
+        sAnimCacheTail->next = NULL;
+    } else {
+        sAnimCacheHead = NULL;
+    }
+
+    if (entry->raw != NULL) {
+        mem_pool_free(sAnimCachePool, entry->raw);
+    }
+    if (entry->frames != NULL) {
+        mem_pool_free(sAnimCachePool, entry->frames);
+    }
+    mem_pool_free(sAnimCachePool, entry);
+    gAnimCacheStats.numEvictions++;
+}
+
+/**
+ * Allocate from the cache's pool, evicting entries until there is room.
+ * Return NULL if there is no room even so.
+ */
+static void *anim_cache_alloc(u32 size) {
+    void *addr;
+
+    while ((addr = mem_pool_alloc(sAnimCachePool, size)) == NULL) {
+        if (sAnimCacheTail == NULL || sAnimCacheTail->lastUsed == gGlobalTimer) {
+            break;
+        }
+        anim_cache_evict_tail();
+    }
+    return addr;
+}
+
+/**
+ * Find the entry for 'key', or create an empty one. Either way it becomes the
+ * most recently used entry.
+ */
+static struct AnimCacheEntry *anim_cache_find(const void *key) {
+    struct AnimCacheEntry **bucket = &sAnimCacheBuckets[ANIM_CACHE_BUCKET(key)];
+    struct AnimCacheEntry *entry;
+
+    for (entry = *bucket; entry != NULL; entry = entry->hashNext) {
+        if (entry->key == key) {
+            anim_cache_touch(entry);
+            return entry;
+        }
+    }
+
+    entry = anim_cache_alloc(sizeof(struct AnimCacheEntry));
+    if (entry != NULL) {
+        entry->key = key;
+        entry->raw = NULL;
+        entry->rawSize = 0;
+        entry->frames = NULL;
+        entry->numFrames = -1;
+        entry->numChannels = 0;
+        entry->lastUsed = gGlobalTimer;
+
+        // The bucket may have lost entries to eviction above
+        bucket = &sAnimCacheBuckets[ANIM_CACHE_BUCKET(key)];
+        entry->hashNext = *bucket;
+        *bucket = entry;
+
+        entry->prev = NULL;
+        entry->next = sAnimCacheHead;
+        if (sAnimCacheHead != NULL) {
+            sAnimCacheHead->prev = entry;
+        } else {
+            sAnimCacheTail = entry;
+        }
+        sAnimCacheHead = entry;
+    }
+    return entry;
+}
+
+/**
+ * Expand an animation into a frame table. Every frame past the longest
+ * channel reads the last value of each channel, so the table stops there.
+ */
+static void anim_cache_decode(struct AnimCacheEntry *entry, struct Animation *anim) {
+    u16 *index = segmented_to_virtual((void *) anim->index);
+    s16 *values = segmented_to_virtual((void *) anim->values);
+    s32 numChannels = (anim->unusedBoneCount + 1) * 3;
+    s32 numFrames = 0;
+    s16 *row;
+    s32 frame;
+    s32 i;
+
+    entry->numFrames = 0;
+    if (anim->unusedBoneCount <= 0) {
+        return;
+    }
+
+    for (i = 0; i < numChannels; i++) {
+        if (index[i * 2] > numFrames) {
+            numFrames = index[i * 2];
+        }
+    }
+    if (numFrames == 0 || numFrames * numChannels * sizeof(s16) > ANIM_CACHE_MAX_ENTRY_SIZE) {
+        return;
+    }
+
+    entry->frames = anim_cache_alloc(numFrames * numChannels * sizeof(s16));
+    if (entry->frames == NULL) {
+        return;
+    }
+
+    row = entry->frames;
+    for (frame = 0; frame < numFrames; frame++) {
+        for (i = 0; i < numChannels; i++) {
+            if (frame < index[i * 2]) {
+                *row++ = values[index[i * 2 + 1] + frame];
+            } else {
+                *row++ = values[index[i * 2 + 1] + index[i * 2] - 1];
+            }
+        }
+    }
+
+    entry->numFrames = numFrames;
+    entry->numChannels = numChannels;
+    gAnimCacheStats.numDecodes++;
+}
+
+/**
+ * Return the row of decoded values for 'frame' of 'anim', and set
+ * 'numChannels' to its length. Return NULL if the animation can't be cached,
+ * in which case it has to be read the usual way.
+ */
+s16 *anim_cache_get_frame(struct Animation *anim, s32 frame, s32 *numChannels) {
+    struct AnimCacheEntry *entry;
+    const void *key = anim;
+    s32 i;
+
+    if (sAnimCachePool == NULL || frame < 0) {
+        return NULL;
+    }
+
+    for (i = 0; i < ANIM_CACHE_NUM_SOURCES; i++) {
+        if (sAnimCacheSources[i].anim == anim) {
+            key = sAnimCacheSources[i].source;
+            break;
+        }
+    }
+
+    entry = anim_cache_find(key);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    if (entry->frames == NULL) {
+        if (entry->numFrames == 0) {
+            return NULL;
+        }
+        anim_cache_decode(entry, anim);
+        if (entry->frames == NULL) {
+            return NULL;
+        }
+    } else {
+        gAnimCacheStats.numHits++;
+    }
+
+    if (frame >= entry->numFrames) {
+        frame = entry->numFrames - 1;
+    }
+    *numChannels = entry->numChannels;
+    return entry->frames + frame * entry->numChannels;
+}
+
+/**
+ * Copy the data loaded from 'source' to 'dest' if the cache has it.
+ * Return whether it did.
+ */
+s32 anim_cache_load(void *dest, const void *source, u32 size) {
+    struct AnimCacheEntry *entry;
+    s32 loaded = FALSE;
+
+    if (sAnimCachePool != NULL) {
+        entry = anim_cache_find(source);
+        if (entry != NULL && entry->raw != NULL && entry->rawSize == size) {
+            memcpy(dest, entry->raw, size);
+            gAnimCacheStats.numLoads++;
+            loaded = TRUE;
+        }
+    }
+    return loaded;
+}
+
+/**
+ * Keep a copy of the data just loaded from 'source'.
+ */
+void anim_cache_store(const void *source, const void *data, u32 size) {
+    struct AnimCacheEntry *entry;
+
+    if (sAnimCachePool == NULL || size > ANIM_CACHE_MAX_ENTRY_SIZE) {
+        return;
+    }
+
+    entry = anim_cache_find(source);
+    if (entry != NULL && entry->raw == NULL) {
+        entry->raw = anim_cache_alloc(size);
+        if (entry->raw != NULL) {
+            memcpy(entry->raw, data, size);
+            entry->rawSize = size;
+        }
+    }
+}
+
+#endif
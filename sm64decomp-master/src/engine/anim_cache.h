@@ -0,0 +1,38 @@
+#ifndef ANIM_CACHE_H
+#define ANIM_CACHE_H
+
+#include <PR/ultratypes.h>
+
+#include "config.h"
+#include "types.h"
+
+#if ANIMATION_CACHE
+// Bytes of the main pool set aside for the animation cache in each level
+#define ANIM_CACHE_SIZE 0x10000
+
+// Animations larger than this fraction of the cache are always decoded in place
+#define ANIM_CACHE_MAX_ENTRY_SIZE (ANIM_CACHE_SIZE / 4)
+
+#define ANIM_CACHE_NUM_BUCKETS 64
+#define ANIM_CACHE_NUM_SOURCES 4
+
+/**
+ * Running totals since boot, for profiling.
+ */
+struct AnimCacheStats {
+    u32 numHits;      // frames read from an already decoded animation
+    u32 numDecodes;   // animations expanded into frame tables
+    u32 numEvictions; // entries dropped to make room for others
+    u32 numLoads;     // Mario animations copied from the cache instead of ROM
+};
+
+extern struct AnimCacheStats gAnimCacheStats;
+
+void anim_cache_init(void);
+void anim_cache_set_source(struct Animation *anim, const void *source);
+s16 *anim_cache_get_frame(struct Animation *anim, s32 frame, s32 *numChannels);
+s32 anim_cache_load(void *dest, const void *source, u32 size);
+void anim_cache_store(const void *source, const void *data, u32 size);
+#endif
+
+#endif // ANIM_CACHE_H
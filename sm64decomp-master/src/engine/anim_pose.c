@@ -0,0 +1,193 @@
+#include <ultra64.h>
+#include <string.h>
+
+#include "sm64.h"
+#include "anim_cache.h"
+#include "anim_pose.h"
+#include "graph_node.h"
+#include "math_util.h"
+
+#if ANIMATION_POSES
+
+/**
+ * Pose evaluation turns an animation at a given position into the matrices of
+ * its parts, so that the renderer only has to copy them and fill in the
+ * translation. Poses are kept for the rest of the frame in a small table keyed
+ * by animation and position, so objects sharing an animation frame (a crowd of
+ * the same enemy, or the same object drawn twice) share one evaluation, and
+ * shadows and held objects read the pose instead of decoding it again.
+ *
+ * With POSE_INTERPOLATION, a position between two frames blends them, which
+ * smooths animations that play at a fraction of the frame rate.
+ */
+
+#define POSE_MAX_PARTS 48
+#define POSE_MAX_CHANNELS ((POSE_MAX_PARTS + 1) * 3)
+
+#define POSE_TABLE_SLOT(anim, position) \
+    ((((uintptr_t)(anim) >> 4) + ((u32)(position) >> 12)) % POSE_TABLE_SIZE)
+
+struct AnimPoseStats gAnimPoseStats;
+
+static struct AnimPose sPoseTable[POSE_TABLE_SIZE];
+static Mat4 sPoseMatrices[POSE_BUFFER_MATRICES];
+static s32 sNumPoseMatrices = 0;
+
+/**
+ * Forget the poses of the previous frame. Mario's animation buffer may hold a
+ * different animation by now.
+ */
+void anim_pose_reset(void) {
+    s32 i;
+
+    for (i = 0; i < POSE_TABLE_SIZE; i++) {
+        sPoseTable[i].anim = NULL;
+    }
+    sNumPoseMatrices = 0;
+    gAnimPoseStats.numEvaluated = 0;
+    gAnimPoseStats.numReused = 0;
+}
+
+/**
+ * Read the first 'numChannels' channels of 'anim' at 'frame'.
+ */
+static void anim_pose_read_channels(struct Animation *anim, s32 frame, s16 *values, s32 numChannels) {
+    u16 *attribute = segmented_to_virtual((void *) anim->index);
+    s16 *data = segmented_to_virtual((void *) anim->values);
+    s32 i;
+#if ANIMATION_CACHE
+    s32 numCachedChannels;
+    s16 *row = anim_cache_get_frame(anim, frame, &numCachedChannels);
+
+    if (row != NULL && numCachedChannels >= numChannels) {
+        memcpy(values, row, numChannels * sizeof(s16));
+        return;
+    }
+#endif
+
+    for (i = 0; i < numChannels; i++) {
+        values[i] = data[retrieve_animation_index(frame, &attribute)];
+    }
+}
+
+/**
+ * Return the pose of 'anim' at 'position', a frame in 16.16 fixed point, or
+ * NULL if it can't be posed: negative frames, animations without a part
+ * count, or the frame's pose buffer is full. The pose stays valid until the
+ * next anim_pose_reset.
+ */
+struct AnimPose *anim_pose_get(struct Animation *anim, s32 position) {
+    s16 values[POSE_MAX_CHANNELS];
+#if POSE_INTERPOLATION
+    s16 nextValues[POSE_MAX_CHANNELS];
+    s32 nextFrame;
+    s32 blend;
+#endif
+    struct AnimPose *pose;
+    s32 numParts = anim->unusedBoneCount;
+    s32 numChannels = (numParts + 1) * 3;
+    s32 frame;
+    Vec3s rotation;
+    s32 i;
+
+#if !POSE_INTERPOLATION
+    position &= ~0xFFFF;
+#endif
+    frame = position >> 16;
+    if (frame < 0 || numParts <= 0 || numParts > POSE_MAX_PARTS) {
+        return NULL;
+    }
+
+    pose = &sPoseTable[POSE_TABLE_SLOT(anim, position)];
+    if (pose->anim == anim && pose->position == position) {
+        gAnimPoseStats.numReused++;
+        return pose;
+    }
+    if (sNumPoseMatrices + numParts > POSE_BUFFER_MATRICES) {
+        return NULL;
+    }
+
+    anim_pose_read_channels(anim, frame, values, numChannels);
+    for (i = 0; i < 3; i++) {
+        pose->translation[i] = values[i];
+    }
+
+#if POSE_INTERPOLATION
+    blend = position & 0xFFFF;
+    if (blend != 0) {
+        nextFrame = frame + 1;
+        if (nextFrame >= anim->loopEnd) {
+            nextFrame = (anim->flags & ANIM_FLAG_NOLOOP) ? frame : anim->loopStart;
+        }
+        anim_pose_read_channels(anim, nextFrame, nextValues, numChannels);
+
+        for (i = 0; i < 3; i++) {
+            pose->translation[i] += (nextValues[i] - values[i]) * (blend / 65536.0f);
+        }
+        // Rotations take the shorter way around
+        for (i = 3; i < numChannels; i++) {
+            values[i] += ((s16)(nextValues[i] - values[i]) * blend) >> 16;
+        }
+    }
+#endif
+
+    pose->anim = anim;
+    pose->position = position;
+    pose->numParts = numParts;
+    pose->partMatrices = &sPoseMatrices[sNumPoseMatrices];
+    sNumPoseMatrices += numParts;
+
+    for (i = 0; i < numParts; i++) {
+        vec3s_set(rotation, values[i * 3 + 3], values[i * 3 + 4], values[i * 3 + 5]);
+        mtxf_rotate_xyz_and_translate(pose->partMatrices[i], gVec3fZero, rotation);
+    }
+
+    gAnimPoseStats.numEvaluated++;
+    return pose;
+}
+
+/**
+ * Check the pose of 'anim' at 'frame' against the animation read the way
+ * geo_process_animated_part reads it. Return the number of parts and
+ * translations that differ, or -1 if the animation can't be posed.
+ */
+s32 anim_pose_check(struct Animation *anim, s32 frame) {
+    struct AnimPose *pose = anim_pose_get(anim, frame << 16);
+    u16 *attribute;
+    s16 *data;
+    Mat4 matrix;
+    Vec3s rotation;
+    s32 numMismatches = 0;
+    s32 i;
+    s32 j;
+
+    if (pose == NULL) {
+        return -1;
+    }
+
+    attribute = segmented_to_virtual((void *) anim->index);
+    data = segmented_to_virtual((void *) anim->values);
+
+    for (i = 0; i < 3; i++) {
+        if (pose->translation[i] != data[retrieve_animation_index(frame, &attribute)]) {
+            numMismatches++;
+        }
+    }
+
+    for (i = 0; i < pose->numParts; i++) {
+        rotation[0] = data[retrieve_animation_index(frame, &attribute)];
+        rotation[1] = data[retrieve_animation_index(frame, &attribute)];
+        rotation[2] = data[retrieve_animation_index(frame, &attribute)];
+        mtxf_rotate_xyz_and_translate(matrix, gVec3fZero, rotation);
+        for (j = 0; j < 16; j++) {
+            if (matrix[j / 4][j % 4] != pose->partMatrices[i][j / 4][j % 4]) {
+                numMismatches++;
+                break;
+            }
+        }
+    }
+
+    return numMismatches;
+}
+
+#endif
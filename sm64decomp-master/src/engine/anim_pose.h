@@ -0,0 +1,41 @@
+#ifndef ANIM_POSE_H
+#define ANIM_POSE_H
+
+#include <PR/ultratypes.h>
+
+#include "config.h"
+#include "types.h"
+
+#if ANIMATION_POSES
+// Part matrices available to the poses of one frame
+#define POSE_BUFFER_MATRICES 512
+
+#define POSE_TABLE_SIZE 64
+
+/**
+ * An animation evaluated at one position. The part matrices hold each part's
+ * rotation, with the translation row left zero for the renderer to fill in.
+ * The translation is the root's raw translation channels, before the
+ * object's translation multiplier.
+ */
+struct AnimPose {
+    struct Animation *anim;
+    s32 position; // frame in 16.16 fixed point
+    s32 numParts;
+    Vec3f translation;
+    Mat4 *partMatrices;
+};
+
+struct AnimPoseStats {
+    u32 numEvaluated; // poses evaluated this frame
+    u32 numReused;    // lookups this frame that found an already evaluated pose
+};
+
+extern struct AnimPoseStats gAnimPoseStats;
+
+void anim_pose_reset(void);
+struct AnimPose *anim_pose_get(struct Animation *anim, s32 position);
+s32 anim_pose_check(struct Animation *anim, s32 frame);
+#endif
+
+#endif // ANIM_POSE_H
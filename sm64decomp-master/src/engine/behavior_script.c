@@ -902,6 +902,382 @@ static BhvCommandProc BehaviorCmdTable[] = {
     bhv_cmd_spawn_water_droplet,
 };
 
+#if BEHAVIOR_SCRIPT_CACHE
+/**
+ * The behavior script cache holds a predecoded copy of every behavior command
+ * that has run, so that cur_obj_update can dispatch straight to a handler with
+ * the command's arguments already unpacked, and move to the next command
+ * without looking it up. Commands are decoded the first time they run, as a
+ * run of commands up to the next one that can't fall through, and are found
+ * by address through a hash table. The commands in loops are dispatched
+ * entirely through the decoded copies.
+ *
+ * gCurBhvCommand and the object's behavior stack are kept exactly as the
+ * interpreter keeps them, and commands without a handler of their own here
+ * are run through BehaviorCmdTable, so the results are identical. When the
+ * cache is full, it is flushed and refilled.
+ */
+#define BHV_CACHE_SIZE 1024
+#define BHV_CACHE_HASH_SIZE 256
+
+struct BhvCachedCommand;
+typedef s32 (*BhvCachedCommandProc)(struct BhvCachedCommand *cmd);
+
+struct BhvCachedCommand {
+    BhvCachedCommandProc proc;
+    const BehaviorScript *addr;
+    const BehaviorScript *nextAddr;
+    struct BhvCachedCommand *next; // the command at nextAddr, if it has been decoded
+    struct BhvCachedCommand *hashNext;
+    BehaviorScript word; // the first word of the command, to detect a reloaded script
+    union {
+        NativeBhvFunc func;
+        struct BhvCachedCommand *loopStart;
+        struct {
+            u8 field;
+            u8 field2;
+            u8 field3;
+            s16 value;
+        } i;
+        struct {
+            u8 field;
+            f32 value;
+        } f;
+    } args;
+};
+
+static struct BhvCachedCommand sBhvCache[BHV_CACHE_SIZE];
+static struct BhvCachedCommand *sBhvCacheHashTable[BHV_CACHE_HASH_SIZE];
+static s32 sBhvCacheCount = 0;
+
+// the last command each object in the object pool stopped at.
+static struct BhvCachedCommand *sBhvCacheObjectCommands[OBJECT_POOL_CAPACITY];
+
+// the command to run after the current one, or NULL if it must be looked up.
+static struct BhvCachedCommand *sBhvCacheNextCommand;
+
+// the number of words in each command.
+static u8 sBhvCommandLengths[] = {
+    1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1, // 0x00
+    1, 1, 1, 2, 2, 2, 2, 2, 1, 1, 1, 1, 3, 1, 1, 1, // 0x10
+    1, 1, 1, 2, 1, 1, 1, 2, 1, 3, 2, 3, 3, 1, 2, 2, // 0x20
+    5, 2, 1, 2, 1, 1, 2, 2,                         // 0x30
+};
+
+#define BHV_CACHE_HASH(addr) ((((uintptr_t)(addr)) >> 2) & (BHV_CACHE_HASH_SIZE - 1))
+
+static void bhv_cache_flush(void) {
+    sBhvCacheCount = 0;
+    bzero(sBhvCacheHashTable, sizeof(sBhvCacheHashTable));
+    bzero(sBhvCacheObjectCommands, sizeof(sBhvCacheObjectCommands));
+}
+
+static struct BhvCachedCommand *bhv_cache_lookup(const BehaviorScript *addr) {
+    struct BhvCachedCommand *cmd = sBhvCacheHashTable[BHV_CACHE_HASH(addr)];
+
+    while (cmd != NULL && cmd->addr != addr) {
+        cmd = cmd->hashNext;
+    }
+
+    return cmd;
+}
+
+// Run a command through the interpreter's table, then find the next command.
+static s32 bhv_cache_run_interpreted(struct BhvCachedCommand *cmd) {
+    s32 result = BehaviorCmdTable[cmd->word >> 24]();
+
+    if (gCurBhvCommand == cmd->nextAddr) {
+        sBhvCacheNextCommand = cmd->next;
+    } else if (gCurBhvCommand == cmd->addr) {
+        sBhvCacheNextCommand = cmd;
+    } else {
+        sBhvCacheNextCommand = NULL;
+    }
+
+    return result;
+}
+
+// Command 0x0C: CALL_NATIVE(func)
+static s32 bhv_cache_call_native(struct BhvCachedCommand *cmd) {
+    cmd->args.func();
+
+    gCurBhvCommand = cmd->nextAddr;
+    sBhvCacheNextCommand = cmd->next;
+    return BHV_PROC_CONTINUE;
+}
+
+// Command 0x08: BEGIN_LOOP()
+static s32 bhv_cache_begin_loop(struct BhvCachedCommand *cmd) {
+    cur_obj_bhv_stack_push((uintptr_t) cmd->nextAddr);
+
+    gCurBhvCommand = cmd->nextAddr;
+    sBhvCacheNextCommand = cmd->next;
+    return BHV_PROC_CONTINUE;
+}
+
+// Command 0x09: END_LOOP()
+static s32 bhv_cache_end_loop(struct BhvCachedCommand *cmd) {
+    // Popping the loop start and pushing it again leaves the stack as it was.
+    gCurBhvCommand = (const BehaviorScript *) gCurrentObject->bhvStack[gCurrentObject->bhvStackIndex - 1];
+
+    if (cmd->args.loopStart != NULL && cmd->args.loopStart->addr == gCurBhvCommand) {
+        sBhvCacheNextCommand = cmd->args.loopStart;
+    } else {
+        sBhvCacheNextCommand = NULL;
+    }
+    return BHV_PROC_BREAK;
+}
+
+// Commands 0x0A and 0x0B: BREAK() and BREAK_UNUSED()
+static s32 bhv_cache_break(struct BhvCachedCommand *cmd) {
+    sBhvCacheNextCommand = cmd;
+    return BHV_PROC_BREAK;
+}
+
+// Command 0x01: DELAY(num)
+static s32 bhv_cache_delay(struct BhvCachedCommand *cmd) {
+    if (gCurrentObject->bhvDelayTimer < cmd->args.i.value - 1) {
+        gCurrentObject->bhvDelayTimer++;
+        sBhvCacheNextCommand = cmd;
+    } else {
+        gCurrentObject->bhvDelayTimer = 0;
+        gCurBhvCommand = cmd->nextAddr;
+        sBhvCacheNextCommand = cmd->next;
+    }
+
+    return BHV_PROC_BREAK;
+}
+
+// Command 0x0D: ADD_FLOAT(field, value)
+static s32 bhv_cache_add_float(struct BhvCachedCommand *cmd) {
+    cur_obj_add_float(cmd->args.f.field, cmd->args.f.value);
+
+    gCurBhvCommand = cmd->nextAddr;
+    sBhvCacheNextCommand = cmd->next;
+    return BHV_PROC_CONTINUE;
+}
+
+// Command 0x0E: SET_FLOAT(field, value)
+static s32 bhv_cache_set_float(struct BhvCachedCommand *cmd) {
+    cur_obj_set_float(cmd->args.f.field, cmd->args.f.value);
+
+    gCurBhvCommand = cmd->nextAddr;
+    sBhvCacheNextCommand = cmd->next;
+    return BHV_PROC_CONTINUE;
+}
+
+// Command 0x0F: ADD_INT(field, value)
+static s32 bhv_cache_add_int(struct BhvCachedCommand *cmd) {
+    cur_obj_add_int(cmd->args.i.field, cmd->args.i.value);
+
+    gCurBhvCommand = cmd->nextAddr;
+    sBhvCacheNextCommand = cmd->next;
+    return BHV_PROC_CONTINUE;
+}
+
+// Command 0x10: SET_INT(field, value)
+static s32 bhv_cache_set_int(struct BhvCachedCommand *cmd) {
+    cur_obj_set_int(cmd->args.i.field, cmd->args.i.value);
+
+    gCurBhvCommand = cmd->nextAddr;
+    sBhvCacheNextCommand = cmd->next;
+    return BHV_PROC_CONTINUE;
+}
+
+// Command 0x11: OR_INT(field, value)
+static s32 bhv_cache_or_int(struct BhvCachedCommand *cmd) {
+    cur_obj_or_int(cmd->args.i.field, cmd->args.i.value & 0xFFFF);
+
+    gCurBhvCommand = cmd->nextAddr;
+    sBhvCacheNextCommand = cmd->next;
+    return BHV_PROC_CONTINUE;
+}
+
+// Command 0x1F: SUM_FLOAT(fieldDst, fieldSrc1, fieldSrc2)
+static s32 bhv_cache_sum_float(struct BhvCachedCommand *cmd) {
+    cur_obj_set_float(cmd->args.i.field,
+                      cur_obj_get_float(cmd->args.i.field2) + cur_obj_get_float(cmd->args.i.field3));
+
+    gCurBhvCommand = cmd->nextAddr;
+    sBhvCacheNextCommand = cmd->next;
+    return BHV_PROC_CONTINUE;
+}
+
+// Command 0x34: ANIMATE_TEXTURE(field, rate)
+static s32 bhv_cache_animate_texture(struct BhvCachedCommand *cmd) {
+    if ((gGlobalTimer % cmd->args.i.value) == 0) {
+        cur_obj_add_int(cmd->args.i.field, 1);
+    }
+
+    gCurBhvCommand = cmd->nextAddr;
+    sBhvCacheNextCommand = cmd->next;
+    return BHV_PROC_CONTINUE;
+}
+
+/**
+ * Fill in the handler and arguments for the command at cmd->addr.
+ */
+static void bhv_cache_decode(struct BhvCachedCommand *cmd) {
+    gCurBhvCommand = cmd->addr;
+    cmd->proc = bhv_cache_run_interpreted;
+
+    switch (cmd->word >> 24) {
+        case 0x0C:
+            cmd->proc = bhv_cache_call_native;
+            cmd->args.func = BHV_CMD_GET_VPTR(1);
+            break;
+        case 0x08:
+            cmd->proc = bhv_cache_begin_loop;
+            break;
+        case 0x09:
+            cmd->proc = bhv_cache_end_loop;
+            break;
+        case 0x0A:
+        case 0x0B:
+            cmd->proc = bhv_cache_break;
+            break;
+        case 0x01:
+            cmd->proc = bhv_cache_delay;
+            cmd->args.i.value = BHV_CMD_GET_2ND_S16(0);
+            break;
+        case 0x0D:
+        case 0x0E:
+            cmd->proc = (cmd->word >> 24) == 0x0D ? bhv_cache_add_float : bhv_cache_set_float;
+            cmd->args.f.field = BHV_CMD_GET_2ND_U8(0);
+            cmd->args.f.value = BHV_CMD_GET_2ND_S16(0);
+            break;
+        case 0x0F:
+        case 0x10:
+        case 0x11:
+            cmd->proc = (cmd->word >> 24) == 0x0F   ? bhv_cache_add_int
+                        : (cmd->word >> 24) == 0x10 ? bhv_cache_set_int
+                                                    : bhv_cache_or_int;
+            cmd->args.i.field = BHV_CMD_GET_2ND_U8(0);
+            cmd->args.i.value = BHV_CMD_GET_2ND_S16(0);
+            break;
+        case 0x1F:
+            cmd->proc = bhv_cache_sum_float;
+            cmd->args.i.field = BHV_CMD_GET_2ND_U8(0);
+            cmd->args.i.field2 = BHV_CMD_GET_3RD_U8(0);
+            cmd->args.i.field3 = BHV_CMD_GET_4TH_U8(0);
+            break;
+        case 0x34:
+            cmd->proc = bhv_cache_animate_texture;
+            cmd->args.i.field = BHV_CMD_GET_2ND_U8(0);
+            cmd->args.i.value = BHV_CMD_GET_2ND_S16(0);
+            break;
+    }
+}
+
+/**
+ * Return the cached command at addr, decoding it and the commands that follow
+ * it if it isn't cached yet. Return NULL if addr doesn't hold a valid command.
+ */
+static struct BhvCachedCommand *bhv_cache_get_command(const BehaviorScript *addr) {
+    const BehaviorScript *savedCommand = gCurBhvCommand;
+    struct BhvCachedCommand *first = bhv_cache_lookup(addr);
+    struct BhvCachedCommand *prev = NULL;
+    struct BhvCachedCommand *loopBody = NULL;
+    struct BhvCachedCommand *cmd;
+    u32 opcode;
+
+    if (first != NULL) {
+        if (first->word == *addr) {
+            return first;
+        }
+        // The script has changed since it was decoded.
+        bhv_cache_flush();
+    }
+
+    if (sBhvCacheCount == BHV_CACHE_SIZE) {
+        bhv_cache_flush();
+    }
+
+    first = NULL;
+    while (sBhvCacheCount < BHV_CACHE_SIZE) {
+        opcode = *addr >> 24;
+        if (opcode >= ARRAY_COUNT(BehaviorCmdTable)) {
+            break;
+        }
+
+        cmd = &sBhvCache[sBhvCacheCount++];
+        cmd->addr = addr;
+        cmd->nextAddr = addr + sBhvCommandLengths[opcode];
+        cmd->next = NULL;
+        cmd->word = *addr;
+        cmd->hashNext = sBhvCacheHashTable[BHV_CACHE_HASH(addr)];
+        sBhvCacheHashTable[BHV_CACHE_HASH(addr)] = cmd;
+        bhv_cache_decode(cmd);
+
+        if (prev != NULL) {
+            prev->next = cmd;
+        } else {
+            first = cmd;
+        }
+        prev = cmd;
+
+        // Remember the start of the loop so END_LOOP can jump back to it.
+        if (opcode == 0x08) {
+            loopBody = cmd;
+        } else if (opcode == 0x09) {
+            cmd->args.loopStart = loopBody != NULL ? loopBody->next : NULL;
+        }
+
+        // Stop after GOTO, RETURN, END_LOOP, BREAK, BREAK_UNUSED, and DEACTIVATE.
+        if (opcode == 0x03 || opcode == 0x04 || opcode == 0x09 || opcode == 0x0A || opcode == 0x0B
+            || opcode == 0x1D) {
+            break;
+        }
+
+        addr = cmd->nextAddr;
+        if ((cmd->next = bhv_cache_lookup(addr)) != NULL) {
+            break;
+        }
+    }
+
+    gCurBhvCommand = savedCommand;
+    return first;
+}
+
+/**
+ * Run the current object's behavior script from gCurBhvCommand using the
+ * cache. Return BHV_PROC_CONTINUE if it reached a command that couldn't be
+ * decoded, in which case the interpreter should carry on from gCurBhvCommand.
+ */
+static s32 bhv_cache_run_script(void) {
+    struct BhvCachedCommand **objCommand = NULL;
+    struct BhvCachedCommand *cmd = NULL;
+    s32 result = BHV_PROC_CONTINUE;
+
+    if (gCurrentObject >= gObjectPool && gCurrentObject < gObjectPool + OBJECT_POOL_CAPACITY) {
+        objCommand = &sBhvCacheObjectCommands[gCurrentObject - gObjectPool];
+        cmd = *objCommand;
+    }
+
+    if (cmd == NULL || cmd->addr != gCurBhvCommand || cmd->word != *gCurBhvCommand) {
+        cmd = bhv_cache_get_command(gCurBhvCommand);
+    }
+
+    while (cmd != NULL) {
+        result = cmd->proc(cmd);
+        cmd = sBhvCacheNextCommand;
+
+        if (result != BHV_PROC_CONTINUE) {
+            break;
+        }
+        if (cmd == NULL) {
+            cmd = bhv_cache_get_command(gCurBhvCommand);
+        }
+    }
+
+    if (objCommand != NULL) {
+        *objCommand = cmd;
+    }
+
+    return result;
+}
+#endif
+
 // Execute the behavior script of the current object, process the object flags, and other miscellaneous code for updating objects.
 void cur_obj_update(void) {
     UNUSED u32 unused;
@@ -933,10 +1309,19 @@ void cur_obj_update(void) {
     // Execute the behavior script.
     gCurBhvCommand = gCurrentObject->curBhvCommand;
 
+#if BEHAVIOR_SCRIPT_CACHE
+    bhvProcResult = bhv_cache_run_script();
+
+    while (bhvProcResult == BHV_PROC_CONTINUE) {
+        bhvCmdProc = BehaviorCmdTable[*gCurBhvCommand >> 24];
+        bhvProcResult = bhvCmdProc();
+    }
+#else
     do {
         bhvCmdProc = BehaviorCmdTable[*gCurBhvCommand >> 24];
         bhvProcResult = bhvCmdProc();
     } while (bhvProcResult == BHV_PROC_CONTINUE);
+#endif
 
     gCurrentObject->curBhvCommand = gCurBhvCommand;
 
@@ -791,5 +791,18 @@ struct GraphNode *process_geo_layout(struct AllocOnlyPool *pool, void *segptr) {
         GeoLayoutJumpTable[gGeoLayoutCommand[0x00]]();
     }
 
+#if GEO_FRUSTUM_CULLING
+    // Only areas are given bounds; object models are culled per object.
+    if (gCurRootGraphNode != NULL && gCurRootGraphNode->type == GRAPH_NODE_TYPE_ROOT) {
+        geo_compute_static_bounds(pool, gCurRootGraphNode);
+    }
+#endif
+#if GEO_STATIC_MATRIX_CACHE
+    // Object models are shared between objects, so only areas' nodes are static.
+    if (gCurRootGraphNode != NULL && gCurRootGraphNode->type == GRAPH_NODE_TYPE_ROOT) {
+        geo_mark_static_transforms(pool, gCurRootGraphNode);
+    }
+#endif
+
     return gCurRootGraphNode;
 }
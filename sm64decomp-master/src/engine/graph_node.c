@@ -29,6 +29,12 @@ void init_scene_graph_node_links(struct GraphNode *graphNode, s32 type) {
     graphNode->next = graphNode;
     graphNode->parent = NULL;
     graphNode->children = NULL;
+#if GEO_FRUSTUM_CULLING
+    graphNode->bounds = NULL;
+#endif
+#if GEO_STATIC_MATRIX_CACHE
+    graphNode->matrixCache = NULL;
+#endif
 }
 
 /**
@@ -886,3 +892,263 @@ struct GraphNodeRoot *geo_find_root(struct GraphNode *graphNode) {
 
     return resGraphNode;
 }
+
+#if GEO_FRUSTUM_CULLING || GEO_STATIC_MATRIX_CACHE
+/**
+ * Build the transform that a translation, rotation or scale node applies to
+ * its children, as the geo_process function for its type does, and return
+ * the node's display list.
+ */
+static void *geo_get_local_transform(struct GraphNode *graphNode, Mat4 dest) {
+    Vec3f translation;
+    Vec3f scale;
+
+    switch (graphNode->type) {
+        case GRAPH_NODE_TYPE_TRANSLATION_ROTATION:
+            vec3s_to_vec3f(translation, ((struct GraphNodeTranslationRotation *) graphNode)->translation);
+            mtxf_rotate_zxy_and_translate(dest, translation,
+                                          ((struct GraphNodeTranslationRotation *) graphNode)->rotation);
+            return ((struct GraphNodeTranslationRotation *) graphNode)->displayList;
+        case GRAPH_NODE_TYPE_TRANSLATION:
+            vec3s_to_vec3f(translation, ((struct GraphNodeTranslation *) graphNode)->translation);
+            mtxf_rotate_zxy_and_translate(dest, translation, gVec3sZero);
+            return ((struct GraphNodeTranslation *) graphNode)->displayList;
+        case GRAPH_NODE_TYPE_ROTATION:
+            mtxf_rotate_zxy_and_translate(dest, gVec3fZero, ((struct GraphNodeRotation *) graphNode)->rotation);
+            return ((struct GraphNodeRotation *) graphNode)->displayList;
+        case GRAPH_NODE_TYPE_SCALE:
+            vec3f_set(scale, ((struct GraphNodeScale *) graphNode)->scale,
+                      ((struct GraphNodeScale *) graphNode)->scale, ((struct GraphNodeScale *) graphNode)->scale);
+            mtxf_identity(dest);
+            mtxf_scale_vec3f(dest, dest, scale);
+            return ((struct GraphNodeScale *) graphNode)->displayList;
+    }
+
+    mtxf_identity(dest);
+    return NULL;
+}
+#endif
+
+#if GEO_FRUSTUM_CULLING
+// Limits on how much of a display list is read when finding its bounds, so
+// that a malformed one can't hang the game. Reaching them leaves it unbounded.
+#define GEO_BOUNDS_MAX_COMMANDS 0x8000
+#define GEO_BOUNDS_MAX_DEPTH 10
+
+/**
+ * Grow the box from min to max to include every vertex that the display list
+ * loads, following its calls and branches. Return FALSE if the display list
+ * couldn't be read to the end.
+ */
+static s32 geo_add_display_list_bounds(void *displayList, Vec3f min, Vec3f max, s32 depth,
+                                       s32 *numCommands) {
+    Gfx *cmd = segmented_to_virtual(displayList);
+    Vtx *vtx;
+    u32 opcode;
+    s32 numVertices;
+    s32 i;
+    s32 j;
+
+    while (++*numCommands <= GEO_BOUNDS_MAX_COMMANDS) {
+        opcode = (cmd->words.w0 >> 24) & 0xFF;
+
+        if (opcode == (u8) G_VTX) {
+#ifdef F3DEX_GBI_2
+            numVertices = (cmd->words.w0 >> 12) & 0xFF;
+#elif defined(F3DEX_GBI) || defined(F3DLP_GBI)
+            numVertices = (cmd->words.w0 >> 10) & 0x3F;
+#else
+            numVertices = (cmd->words.w0 & 0xFFFF) / sizeof(Vtx);
+#endif
+            vtx = segmented_to_virtual((void *) cmd->words.w1);
+            for (i = 0; i < numVertices; i++) {
+                for (j = 0; j < 3; j++) {
+                    if (vtx[i].v.ob[j] < min[j]) {
+                        min[j] = vtx[i].v.ob[j];
+                    }
+                    if (vtx[i].v.ob[j] > max[j]) {
+                        max[j] = vtx[i].v.ob[j];
+                    }
+                }
+            }
+        } else if (opcode == (u8) G_DL) {
+            if (depth >= GEO_BOUNDS_MAX_DEPTH
+                || !geo_add_display_list_bounds((void *) cmd->words.w1, min, max, depth + 1,
+                                                numCommands)) {
+                return FALSE;
+            }
+            if (((cmd->words.w0 >> 16) & 0xFF) == G_DL_NOPUSH) {
+                return TRUE;
+            }
+        } else if (opcode == (u8) G_ENDDL) {
+            return TRUE;
+        }
+
+        cmd++;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Grow the box from min to max, in the space of the node's parent, to include
+ * everything the node and its children draw, and give the node its bounds.
+ * Return FALSE if the subtree isn't static, draws something without
+ * vertices, which could set state for the display lists after it, or has a
+ * node with a function, which must run every frame even when out of view
+ * (e.g. geo_switch_area sets Mario's current room). Such a subtree must never
+ * be culled.
+ */
+static s32 geo_compute_bounds(struct AllocOnlyPool *pool, struct GraphNode *graphNode, Vec3f min,
+                              Vec3f max) {
+    struct GraphNode *child;
+    void *displayList = NULL;
+    s32 isStatic = TRUE;
+    s32 hasTransform = TRUE;
+    s32 numCommands = 0;
+    Mat4 transform;
+    Vec3f localMin = { 32767.0f, 32767.0f, 32767.0f };
+    Vec3f localMax = { -32768.0f, -32768.0f, -32768.0f };
+    Vec3f center;
+    Vec3f extent;
+    s32 i;
+    s32 j;
+
+    switch (graphNode->type) {
+        case GRAPH_NODE_TYPE_DISPLAY_LIST:
+            displayList = ((struct GraphNodeDisplayList *) graphNode)->displayList;
+            hasTransform = FALSE;
+            break;
+        case GRAPH_NODE_TYPE_TRANSLATION_ROTATION:
+        case GRAPH_NODE_TYPE_TRANSLATION:
+        case GRAPH_NODE_TYPE_ROTATION:
+        case GRAPH_NODE_TYPE_SCALE:
+            displayList = geo_get_local_transform(graphNode, transform);
+            break;
+        case GRAPH_NODE_TYPE_START:
+        case GRAPH_NODE_TYPE_LEVEL_OF_DETAIL:
+        case GRAPH_NODE_TYPE_CULLING_RADIUS:
+            hasTransform = FALSE;
+            break;
+        // This includes switch cases and every other node with a function.
+        default:
+            isStatic = FALSE;
+            break;
+    }
+
+    if (displayList != NULL) {
+        if (!geo_add_display_list_bounds(displayList, localMin, localMax, 0, &numCommands)
+            || localMin[0] > localMax[0]) {
+            isStatic = FALSE;
+        }
+    }
+
+    // Children are visited even under a dynamic node, since they may be static themselves.
+    if ((child = graphNode->children) != NULL) {
+        do {
+            if (!geo_compute_bounds(pool, child, localMin, localMax)) {
+                isStatic = FALSE;
+            }
+        } while ((child = child->next) != graphNode->children);
+    }
+
+    if (!isStatic || localMin[0] > localMax[0]) {
+        return isStatic;
+    }
+
+    for (i = 0; i < 3; i++) {
+        center[i] = (localMin[i] + localMax[i]) * 0.5f;
+        extent[i] = (localMax[i] - localMin[i]) * 0.5f;
+    }
+
+    // Move the box into the parent's space, growing it to fit its rotated corners.
+    if (hasTransform) {
+        Vec3f parentCenter;
+        Vec3f parentExtent;
+        f32 m;
+
+        for (j = 0; j < 3; j++) {
+            parentCenter[j] = transform[3][j];
+            parentExtent[j] = 0.0f;
+            for (i = 0; i < 3; i++) {
+                m = transform[i][j];
+                parentCenter[j] += center[i] * m;
+                parentExtent[j] += extent[i] * (m < 0.0f ? -m : m);
+            }
+        }
+        vec3f_copy(center, parentCenter);
+        vec3f_copy(extent, parentExtent);
+    }
+
+    if ((graphNode->bounds = alloc_only_pool_alloc(pool, sizeof(struct GraphNodeBounds))) == NULL) {
+        return FALSE;
+    }
+    vec3f_copy(graphNode->bounds->center, center);
+    graphNode->bounds->radius = sqrtf(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+
+    for (i = 0; i < 3; i++) {
+        if (center[i] - extent[i] < min[i]) {
+            min[i] = center[i] - extent[i];
+        }
+        if (center[i] + extent[i] > max[i]) {
+            max[i] = center[i] + extent[i];
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Find the bounds of every static subtree under the root of a newly loaded
+ * area's geo layout, which lets rendering skip those that are out of view.
+ */
+void geo_compute_static_bounds(struct AllocOnlyPool *pool, struct GraphNode *graphNode) {
+    Vec3f min = { 32767.0f, 32767.0f, 32767.0f };
+    Vec3f max = { -32768.0f, -32768.0f, -32768.0f };
+
+    geo_compute_bounds(pool, graphNode, min, max);
+}
+#endif
+
+#if GEO_STATIC_MATRIX_CACHE
+/**
+ * Mark every translation, rotation and scale node under a newly loaded area's
+ * root as static, and give it a matrix cache. Their transforms never change,
+ * so rendering only needs to rebuild their matrices when the matrix of the
+ * node above them changes. Nodes under generated lists are left alone, since
+ * the list's function could move them.
+ */
+void geo_mark_static_transforms(struct AllocOnlyPool *pool, struct GraphNode *graphNode) {
+    struct GraphNode *child;
+    struct GraphNodeMatrixCache *cache;
+    uintptr_t addr;
+
+    switch (graphNode->type) {
+        case GRAPH_NODE_TYPE_TRANSLATION_ROTATION:
+        case GRAPH_NODE_TYPE_TRANSLATION:
+        case GRAPH_NODE_TYPE_ROTATION:
+        case GRAPH_NODE_TYPE_SCALE:
+            // The pool only aligns to 4 bytes, but the RSP reads matrices from 8 byte aligned addresses.
+            addr = (uintptr_t) alloc_only_pool_alloc(pool, sizeof(struct GraphNodeMatrixCache) + 4);
+            if (addr == 0) {
+                break;
+            }
+            cache = (struct GraphNodeMatrixCache *) ((addr + 7) & ~7);
+            geo_get_local_transform(graphNode, cache->local);
+            cache->version = 0;
+            cache->mtxVersions[0] = 0;
+            cache->mtxVersions[1] = 0;
+            graphNode->matrixCache = cache;
+            graphNode->flags |= GRAPH_RENDER_STATIC;
+            break;
+        case GRAPH_NODE_TYPE_GENERATED_LIST:
+            return;
+    }
+
+    if ((child = graphNode->children) != NULL) {
+        do {
+            geo_mark_static_transforms(pool, child);
+        } while ((child = child->next) != graphNode->children);
+    }
+}
+#endif
@@ -13,6 +13,7 @@
 #define GRAPH_RENDER_Z_BUFFER       (1 << 3)
 #define GRAPH_RENDER_INVISIBLE      (1 << 4)
 #define GRAPH_RENDER_HAS_ANIMATION  (1 << 5)
+#define GRAPH_RENDER_STATIC         (1 << 6)
 
 // Whether the node type has a function pointer of type GraphNodeFunc
 #define GRAPH_NODE_TYPE_FUNCTIONAL            0x100
@@ -119,6 +120,10 @@ struct DisplayListNode
     Mtx *transform;
     void *displayList;
     struct DisplayListNode *next;
+#if MASTER_LIST_SORTING
+    u8 isGenerated; // made by a geo function, so it may change the matrix
+    u8 isBarrier;   // generated or loads no vertices, so it may set state for later lists
+#endif
 };
 
 /** GraphNode that manages the 8 top-level display lists that will be drawn
@@ -346,6 +351,34 @@ struct GraphNodeCullingRadius
     u8 pad1E[2];
 };
 
+#if GEO_FRUSTUM_CULLING
+/** A sphere enclosing everything that a node of the level geometry and its
+ *  children draw, in the space of the node's parent. Only subtrees that are
+ *  static from load time have one, so they can be culled as a whole.
+ */
+struct GraphNodeBounds
+{
+    Vec3f center;
+    f32 radius;
+};
+#endif
+
+#if GEO_STATIC_MATRIX_CACHE
+/** The matrices of a static translation, rotation or scale node, kept from
+ *  frame to frame. There is a fixed point matrix per gfx pool, since the RSP
+ *  may still be reading the one from the last frame.
+ */
+struct GraphNodeMatrixCache
+{
+    Mat4 local;  // the node's own transform
+    Mat4 parent; // the matrix of the node above it when matrix was last built
+    Mat4 matrix;
+    Mtx mtx[2];
+    u32 version; // incremented whenever matrix is rebuilt
+    u32 mtxVersions[2];
+};
+#endif
+
 extern struct GraphNodeMasterList *gCurGraphNodeMasterList;
 extern struct GraphNodePerspective *gCurGraphNodeCamFrustum;
 extern struct GraphNodeCamera *gCurGraphNodeCamera;
@@ -425,6 +458,13 @@ void geo_retreive_animation_translation(struct GraphNodeObject *obj, Vec3f posit
 
 struct GraphNodeRoot *geo_find_root(struct GraphNode *graphNode);
 
+#if GEO_FRUSTUM_CULLING
+void geo_compute_static_bounds(struct AllocOnlyPool *pool, struct GraphNode *graphNode);
+#endif
+#if GEO_STATIC_MATRIX_CACHE
+void geo_mark_static_transforms(struct AllocOnlyPool *pool, struct GraphNode *graphNode);
+#endif
+
 // graph_node_manager
 s16 *read_vec3s_to_vec3f(Vec3f, s16 *src);
 s16 *read_vec3s(Vec3s dst, s16 *src);
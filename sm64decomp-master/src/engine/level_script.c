@@ -55,6 +55,10 @@ static s16 sScriptStatus;
 static s32 sRegister;
 static struct LevelCommand *sCurrentCmd;
 
+#ifdef HEADLESS
+u32 gNumLevelInits = 0;
+#endif
+
 static s32 eval_script_op(s8 op, s32 arg) {
     s32 result = 0;
 
@@ -270,13 +274,21 @@ static void level_cmd_load_to_fixed_address(void) {
 }
 
 static void level_cmd_load_raw(void) {
+#if SEGMENT_LOAD_PIPELINE
+    queue_segment_load(SEGMENT_LOAD_RAW, CMD_GET(s16, 2), CMD_GET(void *, 4), CMD_GET(void *, 8));
+#else
     load_segment(CMD_GET(s16, 2), CMD_GET(void *, 4), CMD_GET(void *, 8),
             MEMORY_POOL_LEFT);
+#endif
     sCurrentCmd = CMD_NEXT;
 }
 
 static void level_cmd_load_mio0(void) {
+#if SEGMENT_LOAD_PIPELINE
+    queue_segment_load(SEGMENT_LOAD_MIO0, CMD_GET(s16, 2), CMD_GET(void *, 4), CMD_GET(void *, 8));
+#else
     load_segment_decompress(CMD_GET(s16, 2), CMD_GET(void *, 4), CMD_GET(void *, 8));
+#endif
     sCurrentCmd = CMD_NEXT;
 }
 
@@ -296,7 +308,11 @@ static void level_cmd_load_mario_head(void) {
 }
 
 static void level_cmd_load_mio0_texture(void) {
+#if SEGMENT_LOAD_PIPELINE
+    queue_segment_load(SEGMENT_LOAD_MIO0_HEAP, CMD_GET(s16, 2), CMD_GET(void *, 4), CMD_GET(void *, 8));
+#else
     load_segment_decompress_heap(CMD_GET(s16, 2), CMD_GET(void *, 4), CMD_GET(void *, 8));
+#endif
     sCurrentCmd = CMD_NEXT;
 }
 
@@ -305,6 +321,9 @@ static void level_cmd_init_level(void) {
     clear_objects();
     clear_areas();
     main_pool_push_state();
+#ifdef HEADLESS
+    gNumLevelInits++;
+#endif
 
     sCurrentCmd = CMD_NEXT;
 }
@@ -823,8 +842,20 @@ struct LevelCommand *level_script_execute(struct LevelCommand *cmd) {
     sCurrentCmd = cmd;
 
     while (sScriptStatus == SCRIPT_RUNNING) {
+#if SEGMENT_LOAD_PIPELINE
+        // Queued loads finish before any command that might use their segments
+        if (sCurrentCmd->type != 0x17 && sCurrentCmd->type != 0x18 && sCurrentCmd->type != 0x1A) {
+            flush_segment_loads();
+        }
+#endif
+#if MAIN_POOL_TRACKING
+        gMainPoolLevelCmd = sCurrentCmd->type;
+#endif
         LevelScriptJumpTable[sCurrentCmd->type]();
     }
+#if MAIN_POOL_TRACKING
+    gMainPoolLevelCmd = MAIN_POOL_NO_LEVEL_CMD;
+#endif
 
     profiler_log_thread5_time(LEVEL_SCRIPT_EXECUTE);
     init_render_image();
@@ -7,6 +7,11 @@ struct LevelCommand;
 
 extern u8 level_script_entry[];
 
+#ifdef HEADLESS
+// Number of times a level has been initialized, for timing level loads
+extern u32 gNumLevelInits;
+#endif
+
 struct LevelCommand *level_script_execute(struct LevelCommand *cmd);
 
 #endif // LEVEL_SCRIPT_H
@@ -7,6 +7,10 @@
 
 #include "trig_tables.inc.c"
 
+#ifdef MATH_UTIL_SSE2
+#include <emmintrin.h>
+#endif
+
 // Variables for a spline curve animation (used for the flight path in the grand star cutscene)
 Vec4s *gSplineKeyframe;
 float gSplineKeyframeFraction;
@@ -481,7 +485,11 @@ void mtxf_align_terrain_triangle(Mat4 mtx, Vec3f pos, s16 yaw, f32 radius) {
  * The resulting matrix represents first applying transformation b and
  * then a.
  */
+#ifdef MATH_UTIL_SSE2
+void mtxf_mul_ref(Mat4 dest, Mat4 a, Mat4 b) {
+#else
 void mtxf_mul(Mat4 dest, Mat4 a, Mat4 b) {
+#endif
     Mat4 temp;
     register f32 entry0;
     register f32 entry1;
@@ -563,7 +571,11 @@ void mtxf_mul_vec3s(Mat4 mtx, Vec3s b) {
  * exception. On Wii and Wii U Virtual Console the value will simply be clamped
  * and no crashes occur.
  */
+#ifdef MATH_UTIL_SSE2
+void mtxf_to_mtx_ref(Mtx *dest, Mat4 src) {
+#else
 void mtxf_to_mtx(Mtx *dest, Mat4 src) {
+#endif
 #ifdef AVOID_UB
     // Avoid type-casting which is technically UB by calling the equivalent
     // guMtxF2L function. This helps little-endian systems, as well.
@@ -583,6 +595,86 @@ void mtxf_to_mtx(Mtx *dest, Mat4 src) {
 #endif
 }
 
+#ifdef MATH_UTIL_SSE2
+/**
+ * SSE2 version of mtxf_mul. Each row of the result is a sum of rows of b
+ * scaled by the entries of the same row of a, added in the same order as the
+ * C version so that the results match exactly. All of b is loaded before
+ * anything is stored, so 'dest' may be either operand.
+ */
+void mtxf_mul(Mat4 dest, Mat4 a, Mat4 b) {
+    __m128 b0 = _mm_loadu_ps(b[0]);
+    __m128 b1 = _mm_loadu_ps(b[1]);
+    __m128 b2 = _mm_loadu_ps(b[2]);
+    __m128 b3 = _mm_loadu_ps(b[3]);
+    __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    __m128 row;
+    s32 i;
+
+    for (i = 0; i < 3; i++) {
+        row = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[i][0]), b0),
+                                    _mm_mul_ps(_mm_set1_ps(a[i][1]), b1)),
+                         _mm_mul_ps(_mm_set1_ps(a[i][2]), b2));
+        _mm_storeu_ps(dest[i], _mm_and_ps(row, xyzMask));
+    }
+
+    row = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[3][0]), b0),
+                                           _mm_mul_ps(_mm_set1_ps(a[3][1]), b1)),
+                                _mm_mul_ps(_mm_set1_ps(a[3][2]), b2)),
+                     b3);
+    _mm_storeu_ps(dest[3], _mm_or_ps(_mm_and_ps(row, xyzMask), _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f)));
+}
+
+/**
+ * Swap the 16-bit halves of each 32-bit lane. Mtx is laid out as big-endian
+ * pairs of s16 within each word, as guMtxF2L writes it.
+ */
+static __m128i swap_s16_pairs(__m128i v) {
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+/**
+ * SSE2 version of mtxf_to_mtx, producing the same words as guMtxF2L. The
+ * conversion truncates like the C cast, and out of range entries give the
+ * same 0x80000000 as the scalar instruction.
+ */
+void mtxf_to_mtx(Mtx *dest, Mat4 src) {
+    __m128 scale = _mm_set1_ps(65536.0f);
+    __m128i r0 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src[0]), scale));
+    __m128i r1 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src[1]), scale));
+    __m128i r2 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src[2]), scale));
+    __m128i r3 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src[3]), scale));
+    __m128i *out = (__m128i *) dest->m;
+
+    // integer parts
+    _mm_storeu_si128(out + 0, swap_s16_pairs(_mm_packs_epi32(_mm_srai_epi32(r0, 16), _mm_srai_epi32(r1, 16))));
+    _mm_storeu_si128(out + 1, swap_s16_pairs(_mm_packs_epi32(_mm_srai_epi32(r2, 16), _mm_srai_epi32(r3, 16))));
+
+    // fraction parts, sign extended so that packing doesn't saturate them
+    r0 = _mm_srai_epi32(_mm_slli_epi32(r0, 16), 16);
+    r1 = _mm_srai_epi32(_mm_slli_epi32(r1, 16), 16);
+    r2 = _mm_srai_epi32(_mm_slli_epi32(r2, 16), 16);
+    r3 = _mm_srai_epi32(_mm_slli_epi32(r3, 16), 16);
+    _mm_storeu_si128(out + 2, swap_s16_pairs(_mm_packs_epi32(r0, r1)));
+    _mm_storeu_si128(out + 3, swap_s16_pairs(_mm_packs_epi32(r2, r3)));
+}
+#endif
+
+#if SIMD_MATRIX_MATH
+/**
+ * Convert 'count' float matrices from 'src' to fixed point matrices in 'dest',
+ * e.g. a whole matrix stack at once.
+ */
+void mtxf_to_mtx_batch(Mtx *dest, Mat4 *src, s32 count) {
+    s32 i;
+
+    for (i = 0; i < count; i++) {
+        mtxf_to_mtx(&dest[i], src[i]);
+    }
+}
+#endif
+
 /**
  * Set 'mtx' to a transformation matrix that rotates around the z axis.
  */
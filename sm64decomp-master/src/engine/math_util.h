@@ -32,6 +32,15 @@ extern f32 gCosineTable[];
 
 #define sqr(x) ((x) * (x))
 
+/*
+ * Host builds with SSE2 replace mtxf_mul and mtxf_to_mtx with vector versions
+ * that give bit-identical results. The C versions stay available with a _ref
+ * suffix so the two can be checked against each other.
+ */
+#if SIMD_MATRIX_MATH && defined(__SSE2__) && defined(AVOID_UB)
+#define MATH_UTIL_SSE2
+#endif
+
 void *vec3f_copy(Vec3f dest, Vec3f src);
 void *vec3f_set(Vec3f dest, f32 x, f32 y, f32 z);
 void *vec3f_add(Vec3f dest, Vec3f a);
@@ -60,6 +69,13 @@ void mtxf_scale_vec3f(Mat4 dest, Mat4 mtx, Vec3f s);
 void mtxf_mul_vec3s(Mat4 mtx, Vec3s b);
 void mtxf_to_mtx(Mtx *dest, Mat4 src);
 void mtxf_rotate_xy(Mtx *mtx, s16 angle);
+#if SIMD_MATRIX_MATH
+void mtxf_to_mtx_batch(Mtx *dest, Mat4 *src, s32 count);
+#endif
+#ifdef MATH_UTIL_SSE2
+void mtxf_mul_ref(Mat4 dest, Mat4 a, Mat4 b);
+void mtxf_to_mtx_ref(Mtx *dest, Mat4 src);
+#endif
 void get_pos_from_transform_mtx(Vec3f dest, Mat4 objMtx, Mat4 camMtx);
 void vec3f_get_dist_and_angle(Vec3f from, Vec3f to, f32 *dist, s16 *pitch, s16 *yaw);
 void vec3f_set_dist_and_angle(Vec3f from, Vec3f to, f32  dist, s16  pitch, s16  yaw);
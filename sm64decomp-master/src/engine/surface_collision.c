@@ -1,12 +1,19 @@
 #include <PR/ultratypes.h>
 
 #include "sm64.h"
+#include "game/area.h"
 #include "game/debug.h"
 #include "game/level_update.h"
 #include "game/mario.h"
 #include "game/object_list_processor.h"
 #include "surface_collision.h"
 #include "surface_load.h"
+#include "level_table.h"
+
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+static struct Surface *find_static_floor_or_ceil(s16 cellX, s16 cellZ, s32 x, s32 y, s32 z, s32 isCeil,
+                                                 f32 *pheight);
+#endif
 
 /**************************************************
  *                      WALLS                     *
@@ -187,6 +194,9 @@ s32 find_wall_collisions(struct WallCollisionData *colData) {
     s32 numCollisions = 0;
     s16 x = colData->x;
     s16 z = colData->z;
+#if SURFACE_QUADTREE
+    s32 pushedX, pushedZ;
+#endif
 
     colData->numWalls = 0;
 
@@ -207,7 +217,22 @@ s32 find_wall_collisions(struct WallCollisionData *colData) {
     numCollisions += find_wall_collisions_from_list(node, colData);
 
     // Check for surfaces that are a part of level geometry.
+#if SURFACE_QUADTREE
+    // The static walls are tested from where the object walls pushed the point,
+    // so find the quadrant from there. If it was pushed out of the cell, search
+    // the whole cell like the original code does.
+    pushedX = colData->x;
+    pushedZ = colData->z;
+    if (pushedX > -LEVEL_BOUNDARY_MAX && pushedX < LEVEL_BOUNDARY_MAX && pushedZ > -LEVEL_BOUNDARY_MAX
+        && pushedZ < LEVEL_BOUNDARY_MAX && (pushedX + LEVEL_BOUNDARY_MAX) / CELL_SIZE == cellX
+        && (pushedZ + LEVEL_BOUNDARY_MAX) / CELL_SIZE == cellZ) {
+        node = find_static_surface_list(cellX, cellZ, pushedX, pushedZ, SPATIAL_PARTITION_WALLS);
+    } else {
+        node = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
+    }
+#else
     node = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
+#endif
     numCollisions += find_wall_collisions_from_list(node, colData);
 
     // Increment the debug tracker.
@@ -216,6 +241,243 @@ s32 find_wall_collisions(struct WallCollisionData *colData) {
     return numCollisions;
 }
 
+#if SURFACE_PACKED_LISTS
+/**************************************************
+ *                  PACKED LISTS                  *
+ **************************************************/
+
+/**
+ * Finish testing a packed floor or ceiling that contains (x, z) laterally and
+ * whose y bounds are in reach: find its height at the point, check that the
+ * point is within 78 units of the right side, and check the camera/type flags.
+ * These are the same tests as find_floor_from_list and find_ceil_from_list.
+ */
+static struct Surface *check_packed_surface(s32 slot, s32 x, s32 y, s32 z, s32 isCeil, f32 *pheight) {
+    struct Surface *surf;
+    f32 *plane = gStaticPackedSurfaces.plane[slot];
+    f32 height;
+
+    // If a wall, ignore it. Likely a remnant, should never occur.
+    if (plane[1] == 0.0f) {
+        return NULL;
+    }
+
+    height = -(x * plane[0] + plane[2] * z + plane[3]) / plane[1];
+
+    if (isCeil) {
+        if (y - (height - -78.0f) > 0.0f) {
+            return NULL;
+        }
+    } else {
+        if (y - (height + -78.0f) < 0.0f) {
+            return NULL;
+        }
+    }
+
+    // Only surfaces that pass the geometric tests need their flags read.
+    surf = gStaticPackedSurfaces.surfaces[slot];
+
+    if (gCheckingSurfaceCollisionsForCamera != 0) {
+        if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
+            return NULL;
+        }
+    } else if (surf->type == SURFACE_CAMERA_BOUNDARY) {
+        return NULL;
+    }
+
+    *pheight = height;
+    return surf;
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PACKED_BATCH_SIZE 8
+#else
+#include <emmintrin.h>
+#define PACKED_BATCH_SIZE 4
+
+/**
+ * SSE2 has no 32 bit multiply that keeps the low halves, so build one from
+ * two 32x32->64 multiplies. The low 32 bits are the same for signed values.
+ */
+static __m128i mullo_epi32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
+/**
+ * Test PACKED_BATCH_SIZE slots starting at the given one against (x, y, z) and
+ * return a mask of those that pass the y bound and lateral tests, with bit 0 being
+ * the first slot. The edge products are computed in 32 bit lanes, which wrap the
+ * same way as the scalar code.
+ */
+static u32 find_packed_batch_candidates(s32 slot, s32 x, s32 y, s32 z, s32 isCeil) {
+#if defined(__AVX2__)
+#define LOAD_S16(stream) _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i *) &(stream)[slot]))
+    __m256i px = _mm256_set1_epi32(x);
+    __m256i pz = _mm256_set1_epi32(z);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i x1 = LOAD_S16(gStaticPackedSurfaces.vertexX[0]);
+    __m256i z1 = LOAD_S16(gStaticPackedSurfaces.vertexZ[0]);
+    __m256i x2 = LOAD_S16(gStaticPackedSurfaces.vertexX[1]);
+    __m256i z2 = LOAD_S16(gStaticPackedSurfaces.vertexZ[1]);
+    __m256i x3 = LOAD_S16(gStaticPackedSurfaces.vertexX[2]);
+    __m256i z3 = LOAD_S16(gStaticPackedSurfaces.vertexZ[2]);
+    __m256i e1, e2, e3, reject;
+
+#define EDGE(xa, za, xb, zb)                                                                        \
+    _mm256_sub_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(za, pz), _mm256_sub_epi32(xb, xa)),        \
+                     _mm256_mullo_epi32(_mm256_sub_epi32(xa, px), _mm256_sub_epi32(zb, za)))
+    e1 = EDGE(x1, z1, x2, z2);
+    e2 = EDGE(x2, z2, x3, z3);
+    e3 = EDGE(x3, z3, x1, z1);
+#undef EDGE
+
+    if (isCeil) {
+        reject = _mm256_cmpgt_epi32(_mm256_set1_epi32(y - 78), LOAD_S16(gStaticPackedSurfaces.upperY));
+        reject = _mm256_or_si256(reject, _mm256_cmpgt_epi32(e1, zero));
+        reject = _mm256_or_si256(reject, _mm256_cmpgt_epi32(e2, zero));
+        reject = _mm256_or_si256(reject, _mm256_cmpgt_epi32(e3, zero));
+    } else {
+        reject = _mm256_cmpgt_epi32(LOAD_S16(gStaticPackedSurfaces.lowerY), _mm256_set1_epi32(y + 78));
+        reject = _mm256_or_si256(reject, _mm256_cmpgt_epi32(zero, e1));
+        reject = _mm256_or_si256(reject, _mm256_cmpgt_epi32(zero, e2));
+        reject = _mm256_or_si256(reject, _mm256_cmpgt_epi32(zero, e3));
+    }
+#undef LOAD_S16
+
+    return ~_mm256_movemask_ps(_mm256_castsi256_ps(reject)) & 0xFF;
+#else
+// Sign extend four s16 values by moving them to the top of each lane.
+#define LOAD_S16(stream)                                                                            \
+    _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(),                                         \
+                                      _mm_loadl_epi64((__m128i *) &(stream)[slot])), 16)
+    __m128i px = _mm_set1_epi32(x);
+    __m128i pz = _mm_set1_epi32(z);
+    __m128i zero = _mm_setzero_si128();
+    __m128i x1 = LOAD_S16(gStaticPackedSurfaces.vertexX[0]);
+    __m128i z1 = LOAD_S16(gStaticPackedSurfaces.vertexZ[0]);
+    __m128i x2 = LOAD_S16(gStaticPackedSurfaces.vertexX[1]);
+    __m128i z2 = LOAD_S16(gStaticPackedSurfaces.vertexZ[1]);
+    __m128i x3 = LOAD_S16(gStaticPackedSurfaces.vertexX[2]);
+    __m128i z3 = LOAD_S16(gStaticPackedSurfaces.vertexZ[2]);
+    __m128i e1, e2, e3, reject;
+
+#define EDGE(xa, za, xb, zb)                                                                        \
+    _mm_sub_epi32(mullo_epi32(_mm_sub_epi32(za, pz), _mm_sub_epi32(xb, xa)),                        \
+                  mullo_epi32(_mm_sub_epi32(xa, px), _mm_sub_epi32(zb, za)))
+    e1 = EDGE(x1, z1, x2, z2);
+    e2 = EDGE(x2, z2, x3, z3);
+    e3 = EDGE(x3, z3, x1, z1);
+#undef EDGE
+
+    if (isCeil) {
+        reject = _mm_cmplt_epi32(LOAD_S16(gStaticPackedSurfaces.upperY), _mm_set1_epi32(y - 78));
+        reject = _mm_or_si128(reject, _mm_cmpgt_epi32(e1, zero));
+        reject = _mm_or_si128(reject, _mm_cmpgt_epi32(e2, zero));
+        reject = _mm_or_si128(reject, _mm_cmpgt_epi32(e3, zero));
+    } else {
+        reject = _mm_cmpgt_epi32(LOAD_S16(gStaticPackedSurfaces.lowerY), _mm_set1_epi32(y + 78));
+        reject = _mm_or_si128(reject, _mm_cmplt_epi32(e1, zero));
+        reject = _mm_or_si128(reject, _mm_cmplt_epi32(e2, zero));
+        reject = _mm_or_si128(reject, _mm_cmplt_epi32(e3, zero));
+    }
+#undef LOAD_S16
+
+    return ~_mm_movemask_ps(_mm_castsi128_ps(reject)) & 0xF;
+#endif
+}
+#endif
+
+/**
+ * Iterate through a packed static floor or ceiling list and find the first surface
+ * under (or over, for ceilings) a given point, in the same order as the linked list
+ * it was packed from. Candidates are rejected by their y bounds before the lateral
+ * test, which never changes the result since the bounds are padded by 5 units.
+ */
+static struct Surface *find_surface_from_packed_list(struct PackedSurfaceList *list, s32 x, s32 y,
+                                                     s32 z, s32 isCeil, f32 *pheight) {
+    register s32 slot = list->start;
+    s32 end = slot + list->count;
+    struct Surface *surf;
+#ifdef PACKED_BATCH_SIZE
+    u32 candidates;
+
+    // Test whole batches at once, then finish off the candidates in list order.
+    for (; slot < end; slot += PACKED_BATCH_SIZE) {
+        candidates = find_packed_batch_candidates(slot, x, y, z, isCeil);
+
+        if (end - slot < PACKED_BATCH_SIZE) {
+            candidates &= (1 << (end - slot)) - 1;
+        }
+
+        while (candidates != 0) {
+            surf = check_packed_surface(slot + __builtin_ctz(candidates), x, y, z, isCeil, pheight);
+            if (surf != NULL) {
+                return surf;
+            }
+
+            candidates &= candidates - 1;
+        }
+    }
+#else
+    register s32 x1, z1, x2, z2, x3, z3;
+    register s32 edge;
+
+    for (; slot < end; slot++) {
+        if (isCeil) {
+            // The ceiling height can be no higher than upperY, so it is out of reach.
+            if (y - 78 > gStaticPackedSurfaces.upperY[slot]) {
+                continue;
+            }
+        } else {
+            // The floor height can be no lower than lowerY, so it is out of reach.
+            if (y + 78 < gStaticPackedSurfaces.lowerY[slot]) {
+                continue;
+            }
+        }
+
+        x1 = gStaticPackedSurfaces.vertexX[0][slot];
+        z1 = gStaticPackedSurfaces.vertexZ[0][slot];
+        x2 = gStaticPackedSurfaces.vertexX[1][slot];
+        z2 = gStaticPackedSurfaces.vertexZ[1][slot];
+
+        // Check that the point is within the triangle bounds. Ceilings wind the
+        // other way, so the edge tests are flipped for them.
+        edge = (z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1);
+        if (isCeil ? edge > 0 : edge < 0) {
+            continue;
+        }
+
+        x3 = gStaticPackedSurfaces.vertexX[2][slot];
+        z3 = gStaticPackedSurfaces.vertexZ[2][slot];
+
+        edge = (z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2);
+        if (isCeil ? edge > 0 : edge < 0) {
+            continue;
+        }
+
+        edge = (z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3);
+        if (isCeil ? edge > 0 : edge < 0) {
+            continue;
+        }
+
+        surf = check_packed_surface(slot, x, y, z, isCeil, pheight);
+        if (surf != NULL) {
+            return surf;
+        }
+    }
+#endif
+
+    return NULL;
+}
+#endif
+
 /**************************************************
  *                     CEILINGS                   *
  **************************************************/
@@ -335,8 +597,12 @@ f32 find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil) {
     dynamicCeil = find_ceil_from_list(surfaceList, x, y, z, &dynamicHeight);
 
     // Check for surfaces that are a part of level geometry.
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+    ceil = find_static_floor_or_ceil(cellX, cellZ, x, y, z, TRUE, &height);
+#else
     surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next;
     ceil = find_ceil_from_list(surfaceList, x, y, z, &height);
+#endif
 
     if (dynamicHeight < height) {
         ceil = dynamicCeil;
@@ -468,6 +734,36 @@ static struct Surface *find_floor_from_list(struct SurfaceNode *surfaceNode, s32
     return floor;
 }
 
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+/**
+ * Find the first static floor or ceiling at a point, from the packed lists if
+ * the area's surfaces fit in them and from the (quadtree) linked lists otherwise.
+ */
+static struct Surface *find_static_floor_or_ceil(s16 cellX, s16 cellZ, s32 x, s32 y, s32 z, s32 isCeil,
+                                                 f32 *pheight) {
+    struct SurfaceNode *surfaceList;
+    s32 listIndex = isCeil ? SPATIAL_PARTITION_CEILS : SPATIAL_PARTITION_FLOORS;
+#if SURFACE_PACKED_LISTS
+    struct PackedSurfaceList *packedList = find_static_packed_list(cellX, cellZ, x, z, listIndex);
+
+    if (packedList != NULL) {
+        return find_surface_from_packed_list(packedList, x, y, z, isCeil, pheight);
+    }
+#endif
+
+#if SURFACE_QUADTREE
+    surfaceList = find_static_surface_list(cellX, cellZ, x, z, listIndex);
+#else
+    surfaceList = gStaticSurfacePartition[cellZ][cellX][listIndex].next;
+#endif
+
+    if (isCeil) {
+        return find_ceil_from_list(surfaceList, x, y, z, pheight);
+    }
+    return find_floor_from_list(surfaceList, x, y, z, pheight);
+}
+#endif
+
 /**
  * Find the height of the highest floor below a point.
  */
@@ -542,8 +838,12 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
     dynamicFloor = find_floor_from_list(surfaceList, x, y, z, &dynamicHeight);
 
     // Check for surfaces that are a part of level geometry.
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+    floor = find_static_floor_or_ceil(cellX, cellZ, x, y, z, FALSE, &height);
+#else
     surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
     floor = find_floor_from_list(surfaceList, x, y, z, &height);
+#endif
 
     // To prevent the Merry-Go-Round room from loading when Mario passes above the hole that leads
     // there, SURFACE_INTANGIBLE is used. This prevent the wrong room from loading, but can also allow
@@ -554,7 +854,11 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
         //  (happens when there is no floor under the SURFACE_INTANGIBLE floor) but returns the height
         //  of the SURFACE_INTANGIBLE floor instead of the typical -11000 returned for a NULL floor.
         if (floor != NULL && floor->type == SURFACE_INTANGIBLE) {
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+            floor = find_static_floor_or_ceil(cellX, cellZ, x, (s32)(height - 200.0f), z, FALSE, &height);
+#else
             floor = find_floor_from_list(surfaceList, x, (s32)(height - 200.0f), z, &height);
+#endif
         }
     } else {
         // To prevent accidentally leaving the floor tangible, stop checking for it.
@@ -726,6 +1030,19 @@ void debug_surface_list_info(f32 xPos, f32 zPos) {
     print_debug_top_down_mapinfo("listal %d", gSurfaceNodesAllocated);
     print_debug_top_down_mapinfo("statbg %d", gNumStaticSurfaces);
     print_debug_top_down_mapinfo("movebg %d", gSurfacesAllocated - gNumStaticSurfaces);
+#if DYNAMIC_SURFACE_CACHE
+    // Moving background surfaces rebuilt and reused from last frame
+    print_debug_top_down_mapinfo("mvnew  %d", gDynamicSurfaceCacheStats.rebuilt);
+    print_debug_top_down_mapinfo("mvold  %d", gDynamicSurfaceCacheStats.reused);
+#endif
+#if SURFACE_POOL_ARENAS
+    // Peak list and surface allocations for this level, and failed allocations
+    if (gCurrLevelNum >= 0 && gCurrLevelNum < LEVEL_COUNT) {
+        print_debug_top_down_mapinfo("pklist %d", gSurfacePoolUsage[gCurrLevelNum].peakSurfaceNodes);
+        print_debug_top_down_mapinfo("pkbg   %d", gSurfacePoolUsage[gCurrLevelNum].peakSurfaces);
+        print_debug_top_down_mapinfo("drop   %d", gSurfacePoolUsage[gCurrLevelNum].numDropped);
+    }
+#endif
 
     gNumCalls.floor = 0;
     gNumCalls.ceil = 0;
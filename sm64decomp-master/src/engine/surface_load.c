@@ -3,6 +3,7 @@
 #include "prevent_bss_reordering.h"
 
 #include "sm64.h"
+#include "game/area.h"
 #include "game/ingame_menu.h"
 #include "graph_node.h"
 #include "behavior_script.h"
@@ -14,6 +15,7 @@
 #include "game/mario.h"
 #include "game/object_list_processor.h"
 #include "surface_load.h"
+#include "level_table.h"
 
 s32 unused8038BE90;
 
@@ -24,11 +26,32 @@ s32 unused8038BE90;
 SpatialPartitionCell gStaticSurfacePartition[NUM_CELLS][NUM_CELLS];
 SpatialPartitionCell gDynamicSurfacePartition[NUM_CELLS][NUM_CELLS];
 
+#if SURFACE_POOL_ARENAS
+/**
+ * A pool that is allocated in fixed size chunks as it fills up, so that entries
+ * never move and need no header of their own.
+ */
+struct SurfaceArena
+{
+    u8 *chunks[SURFACE_ARENA_MAX_CHUNKS];
+    u32 entrySize;
+    s32 numChunks;
+};
+
+/**
+ * Arenas of data to contain either surface nodes or surfaces.
+ */
+static struct SurfaceArena sSurfaceNodeArena = { { NULL }, sizeof(struct SurfaceNode), 0 };
+static struct SurfaceArena sSurfaceArena = { { NULL }, sizeof(struct Surface), 0 };
+
+struct SurfacePoolUsage gSurfacePoolUsage[LEVEL_COUNT];
+#else
 /**
  * Pools of data to contain either surface nodes or surfaces.
  */
 struct SurfaceNode *sSurfaceNodePool;
 struct Surface *sSurfacePool;
+#endif
 
 /**
  * The size of the surface pool (2300).
@@ -37,6 +60,178 @@ s16 sSurfacePoolSize;
 
 u8 unused8038EEA8[0x30];
 
+#if SURFACE_QUADTREE
+/**
+ * Quadrants of the static partition cells that hold too many surfaces,
+ * or NULL for cells that are small enough to walk linearly.
+ */
+struct SurfaceQuadNode *gStaticSurfaceQuadtree[NUM_CELLS][NUM_CELLS];
+
+static struct SurfaceQuadNode *sSurfaceQuadNodePool;
+static struct SurfaceNode *sSurfaceQuadListPool;
+static s32 sSurfaceQuadNodesAllocated;
+static s32 sSurfaceQuadListNodesAllocated;
+#endif
+
+#if DYNAMIC_SURFACE_CACHE
+/**
+ * What an object's surfaces were built from, and where they were put, the last
+ * frame it loaded its collision model. Indexed by the object's slot in gObjectPool.
+ */
+struct DynamicSurfaceCacheEntry
+{
+    Mat4 transform;
+    void *collisionData;
+    const BehaviorScript *behavior;
+    u32 frame;
+    s16 surfaceStart; // relative to gNumStaticSurfaces
+    s16 numSurfaces;
+};
+
+static struct DynamicSurfaceCacheEntry sDynamicSurfaceCache[OBJECT_POOL_CAPACITY];
+
+/**
+ * A copy of last frame's dynamic surfaces, made before the pool is reset.
+ */
+static struct Surface *sCachedDynamicSurfaces;
+static s32 sNumCachedDynamicSurfaces;
+
+/**
+ * Incremented each time the dynamic surfaces are cleared, starting at 1 so that
+ * unused cache entries are never treated as being from last frame.
+ */
+static u32 sDynamicSurfaceFrame = 1;
+
+struct DynamicSurfaceCacheStats gDynamicSurfaceCacheStats;
+#endif
+
+#if SURFACE_PACKED_LISTS
+/**
+ * Packed copies of the static floor and ceiling lists. Wall lists are not packed.
+ */
+PackedPartitionCell gStaticPackedPartition[NUM_CELLS][NUM_CELLS];
+struct PackedSurfaces gStaticPackedSurfaces;
+#endif
+
+#if SURFACE_POOL_ARENAS
+/**
+ * Add a chunk to the arena, taking it from the main pool. Returns FALSE if there
+ * is no room left. The effects pool is not used, since paintings and
+ * environment effects allocate from it without checking for NULL.
+ */
+static s32 surface_arena_grow(struct SurfaceArena *arena) {
+    u32 size = SURFACE_ARENA_CHUNK_LENGTH * arena->entrySize;
+    u8 *chunk;
+
+    if (arena->numChunks >= SURFACE_ARENA_MAX_CHUNKS) {
+        return FALSE;
+    }
+
+    chunk = main_pool_alloc(size, MEMORY_POOL_LEFT);
+    if (chunk == NULL) {
+        return FALSE;
+    }
+
+    arena->chunks[arena->numChunks++] = chunk;
+    return TRUE;
+}
+
+/**
+ * Return the address of the entry at index, growing the arena if it doesn't
+ * reach that far yet. Returns NULL if the arena can't grow.
+ */
+static void *surface_arena_get(struct SurfaceArena *arena, s32 index) {
+    s32 chunkIndex = index / SURFACE_ARENA_CHUNK_LENGTH;
+
+    while (chunkIndex >= arena->numChunks) {
+        if (!surface_arena_grow(arena)) {
+            return NULL;
+        }
+    }
+
+    return arena->chunks[chunkIndex] + (index % SURFACE_ARENA_CHUNK_LENGTH) * arena->entrySize;
+}
+
+/**
+ * Forget the chunks of the previous level and allocate enough for the original
+ * pool size up front, so that levels which fit in the old pools never grow.
+ * The chunks were already freed when the previous level was unloaded.
+ */
+static void surface_arena_init(struct SurfaceArena *arena, s32 length) {
+    arena->numChunks = 0;
+
+    surface_arena_get(arena, length - 1);
+}
+
+/**
+ * Record how many surfaces and surface nodes are in use for the current level.
+ */
+static void record_surface_pool_usage(void) {
+    struct SurfacePoolUsage *usage;
+
+    if (gCurrLevelNum < 0 || gCurrLevelNum >= LEVEL_COUNT) {
+        return;
+    }
+
+    usage = &gSurfacePoolUsage[gCurrLevelNum];
+    if (gSurfaceNodesAllocated > usage->peakSurfaceNodes) {
+        usage->peakSurfaceNodes = gSurfaceNodesAllocated;
+    }
+    if (gSurfacesAllocated > usage->peakSurfaces) {
+        usage->peakSurfaces = gSurfacesAllocated;
+    }
+}
+
+/**
+ * Count an allocation that failed because the main pool is full.
+ */
+static void record_dropped_surface_alloc(void) {
+    if (gCurrLevelNum >= 0 && gCurrLevelNum < LEVEL_COUNT) {
+        gSurfacePoolUsage[gCurrLevelNum].numDropped++;
+    }
+}
+
+/**
+ * Allocate a surface node from the surface node arena, or return NULL if there
+ * is no memory left for it.
+ */
+static struct SurfaceNode *alloc_surface_node(void) {
+    struct SurfaceNode *node = surface_arena_get(&sSurfaceNodeArena, gSurfaceNodesAllocated);
+
+    if (node == NULL) {
+        record_dropped_surface_alloc();
+        return NULL;
+    }
+
+    gSurfaceNodesAllocated++;
+    node->next = NULL;
+
+    return node;
+}
+
+/**
+ * Allocate a surface from the surface arena and initialize it, or return NULL
+ * if there is no memory left for it.
+ */
+static struct Surface *alloc_surface(void) {
+    struct Surface *surface = surface_arena_get(&sSurfaceArena, gSurfacesAllocated);
+
+    if (surface == NULL) {
+        record_dropped_surface_alloc();
+        return NULL;
+    }
+
+    gSurfacesAllocated++;
+
+    surface->type = 0;
+    surface->force = 0;
+    surface->flags = 0;
+    surface->room = 0;
+    surface->object = NULL;
+
+    return surface;
+}
+#else
 /**
  * Allocate the part of the surface node pool to contain a surface node.
  */
@@ -49,7 +244,7 @@ static struct SurfaceNode *alloc_surface_node(void) {
     //! A bounds check! If there's more surface nodes than 7000 allowed,
     //  we, um...
     // Perhaps originally just debug feedback?
-    if (gSurfaceNodesAllocated >= 7000) {
+    if (gSurfaceNodesAllocated >= SURFACE_NODE_POOL_SIZE) {
     }
 
     return node;
@@ -78,6 +273,7 @@ static struct Surface *alloc_surface(void) {
 
     return surface;
 }
+#endif
 
 /**
  * Iterates through the entire partition, clearing the surfaces.
@@ -116,6 +312,12 @@ static void add_surface_to_cell(s16 dynamic, s16 cellX, s16 cellZ, struct Surfac
     s16 sortDir;
     s16 listIndex;
 
+#if SURFACE_POOL_ARENAS
+    if (newNode == NULL) {
+        return;
+    }
+
+#endif
     if (surface->normal.y > 0.01) {
         listIndex = SPATIAL_PARTITION_FLOORS;
         sortDir = 1; // highest to lowest, then insertion order
@@ -291,6 +493,284 @@ static void add_surface(struct Surface *surface, s32 dynamic) {
     }
 }
 
+#if SURFACE_QUADTREE
+/**
+ * Returns the number of surfaces in a list.
+ */
+static s32 surface_list_count(struct SurfaceNode *list) {
+    s32 count = 0;
+
+    while (list != NULL) {
+        list = list->next;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * Copy the surfaces of a list whose bounds (expanded by margin) overlap the
+ * square [minX, minX + size) x [minZ, minZ + size) into dest, keeping their order
+ * so that the first hit of any query within the square is unchanged.
+ */
+static void filter_surface_list(struct SurfaceNode *dest, struct SurfaceNode *list, s32 minX,
+                                s32 minZ, s32 size, s32 margin) {
+    struct Surface *surf;
+    struct SurfaceNode *node;
+    s32 maxX = minX + size - 1;
+    s32 maxZ = minZ + size - 1;
+
+    dest->next = NULL;
+
+    while (list != NULL) {
+        surf = list->surface;
+        list = list->next;
+
+        if (max_3(surf->vertex1[0], surf->vertex2[0], surf->vertex3[0]) + margin < minX
+            || min_3(surf->vertex1[0], surf->vertex2[0], surf->vertex3[0]) - margin > maxX
+            || max_3(surf->vertex1[2], surf->vertex2[2], surf->vertex3[2]) + margin < minZ
+            || min_3(surf->vertex1[2], surf->vertex2[2], surf->vertex3[2]) - margin > maxZ) {
+            continue;
+        }
+
+        node = &sSurfaceQuadListPool[sSurfaceQuadListNodesAllocated++];
+        node->surface = surf;
+        node->next = NULL;
+
+        dest->next = node;
+        dest = node;
+    }
+}
+
+/**
+ * Split a square of a static cell into quadrants if any of its lists is too long,
+ * recursing until the lists are short enough or the pools run out. Returns the
+ * four quadrants, or NULL if the square was left as is.
+ */
+static struct SurfaceQuadNode *subdivide_surface_quad(SpatialPartitionCell lists, s32 minX, s32 minZ,
+                                                      s32 size, s32 depth) {
+    struct SurfaceQuadNode *children;
+    s32 floors = surface_list_count(lists[SPATIAL_PARTITION_FLOORS].next);
+    s32 ceils = surface_list_count(lists[SPATIAL_PARTITION_CEILS].next);
+    s32 walls = surface_list_count(lists[SPATIAL_PARTITION_WALLS].next);
+    s32 half = size / 2;
+    s32 i;
+
+    if (depth >= SURFACE_QUADTREE_MAX_DEPTH) {
+        return NULL;
+    }
+
+    if (floors <= SURFACE_QUADTREE_LEAF_SIZE && ceils <= SURFACE_QUADTREE_LEAF_SIZE
+        && walls <= SURFACE_QUADTREE_LEAF_SIZE) {
+        return NULL;
+    }
+
+    // Leave the square unsplit rather than run out of nodes partway through.
+    if (sSurfaceQuadNodesAllocated + 4 > SURFACE_QUADTREE_NODE_POOL_SIZE
+        || sSurfaceQuadListNodesAllocated + 4 * (floors + ceils + walls)
+               > SURFACE_QUADTREE_LIST_POOL_SIZE) {
+        return NULL;
+    }
+
+    children = &sSurfaceQuadNodePool[sSurfaceQuadNodesAllocated];
+    sSurfaceQuadNodesAllocated += 4;
+
+    for (i = 0; i < 4; i++) {
+        s32 childX = minX + (i & 1) * half;
+        s32 childZ = minZ + (i >> 1) * half;
+
+        filter_surface_list(&children[i].lists[SPATIAL_PARTITION_FLOORS],
+                            lists[SPATIAL_PARTITION_FLOORS].next, childX, childZ, half, 0);
+        filter_surface_list(&children[i].lists[SPATIAL_PARTITION_CEILS],
+                            lists[SPATIAL_PARTITION_CEILS].next, childX, childZ, half, 0);
+        filter_surface_list(&children[i].lists[SPATIAL_PARTITION_WALLS],
+                            lists[SPATIAL_PARTITION_WALLS].next, childX, childZ, half,
+                            SURFACE_QUADTREE_WALL_MARGIN);
+    }
+
+    for (i = 0; i < 4; i++) {
+        children[i].children = subdivide_surface_quad(children[i].lists, minX + (i & 1) * half,
+                                                      minZ + (i >> 1) * half, half, depth + 1);
+    }
+
+    return children;
+}
+
+/**
+ * Build the quadtree over the static partition once all level surfaces are loaded.
+ */
+static void build_static_surface_quadtree(void) {
+    s32 cellX, cellZ;
+
+    sSurfaceQuadNodesAllocated = 0;
+    sSurfaceQuadListNodesAllocated = 0;
+
+    for (cellZ = 0; cellZ < NUM_CELLS; cellZ++) {
+        for (cellX = 0; cellX < NUM_CELLS; cellX++) {
+            gStaticSurfaceQuadtree[cellZ][cellX] = subdivide_surface_quad(
+                gStaticSurfacePartition[cellZ][cellX], cellX * CELL_SIZE - LEVEL_BOUNDARY_MAX,
+                cellZ * CELL_SIZE - LEVEL_BOUNDARY_MAX, CELL_SIZE, 0);
+        }
+    }
+}
+
+/**
+ * Find the smallest quadrant containing the point (x, z), which must lie within
+ * the cell (cellX, cellZ). Returns NULL if the cell was not split.
+ */
+static struct SurfaceQuadNode *find_static_surface_quad(s16 cellX, s16 cellZ, s16 x, s16 z) {
+    struct SurfaceQuadNode *children = gStaticSurfaceQuadtree[cellZ][cellX];
+    struct SurfaceQuadNode *quad = NULL;
+    s32 localX = (x + LEVEL_BOUNDARY_MAX) & (CELL_SIZE - 1);
+    s32 localZ = (z + LEVEL_BOUNDARY_MAX) & (CELL_SIZE - 1);
+    s32 half = CELL_SIZE / 2;
+
+    while (children != NULL) {
+        quad = children;
+
+        if (localX >= half) {
+            quad += 1;
+            localX -= half;
+        }
+        if (localZ >= half) {
+            quad += 2;
+            localZ -= half;
+        }
+
+        children = quad->children;
+        half /= 2;
+    }
+
+    return quad;
+}
+
+/**
+ * Find the smallest static surface list containing the point (x, z), which must
+ * lie within the cell (cellX, cellZ).
+ */
+struct SurfaceNode *find_static_surface_list(s16 cellX, s16 cellZ, s16 x, s16 z, s32 listIndex) {
+    struct SurfaceQuadNode *quad = find_static_surface_quad(cellX, cellZ, x, z);
+
+    if (quad == NULL) {
+        return gStaticSurfacePartition[cellZ][cellX][listIndex].next;
+    }
+
+    return quad->lists[listIndex].next;
+}
+#endif
+
+#if SURFACE_PACKED_LISTS
+/**
+ * Copy a surface list into the next free slots of gStaticPackedSurfaces.
+ */
+static void pack_surface_list(struct PackedSurfaceList *dest, struct SurfaceNode *list) {
+    struct PackedSurfaces *packed = &gStaticPackedSurfaces;
+    struct Surface *surf;
+    s32 slot;
+
+    dest->start = packed->count;
+    dest->count = 0;
+
+    while (list != NULL) {
+        surf = list->surface;
+        list = list->next;
+
+        slot = packed->count++;
+
+        packed->lowerY[slot] = surf->lowerY;
+        packed->upperY[slot] = surf->upperY;
+
+        packed->vertexX[0][slot] = surf->vertex1[0];
+        packed->vertexZ[0][slot] = surf->vertex1[2];
+        packed->vertexX[1][slot] = surf->vertex2[0];
+        packed->vertexZ[1][slot] = surf->vertex2[2];
+        packed->vertexX[2][slot] = surf->vertex3[0];
+        packed->vertexZ[2][slot] = surf->vertex3[2];
+
+        packed->plane[slot][0] = surf->normal.x;
+        packed->plane[slot][1] = surf->normal.y;
+        packed->plane[slot][2] = surf->normal.z;
+        packed->plane[slot][3] = surf->originOffset;
+
+        packed->surfaces[slot] = surf;
+
+        dest->count++;
+    }
+}
+
+/**
+ * Pack the static floor and ceiling lists (and their quadrants, if any)
+ * once all level surfaces are loaded.
+ */
+static void pack_static_surfaces(void) {
+    s32 cellX, cellZ;
+#if SURFACE_QUADTREE
+    s32 i;
+#endif
+
+    gStaticPackedSurfaces.count = 0;
+
+#if SURFACE_POOL_ARENAS
+    // With growable pools there may be more static nodes than packed slots, in
+    // which case find_floor and find_ceil keep walking the linked lists.
+#if SURFACE_QUADTREE
+    if (gSurfaceNodesAllocated + sSurfaceQuadListNodesAllocated
+        > SURFACE_PACKED_POOL_SIZE - SURFACE_PACKED_POOL_PADDING) {
+#else
+    if (gSurfaceNodesAllocated > SURFACE_PACKED_POOL_SIZE - SURFACE_PACKED_POOL_PADDING) {
+#endif
+        gStaticPackedSurfaces.count = -1;
+        return;
+    }
+
+#endif
+    for (cellZ = 0; cellZ < NUM_CELLS; cellZ++) {
+        for (cellX = 0; cellX < NUM_CELLS; cellX++) {
+            pack_surface_list(&gStaticPackedPartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS],
+                              gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next);
+            pack_surface_list(&gStaticPackedPartition[cellZ][cellX][SPATIAL_PARTITION_CEILS],
+                              gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next);
+        }
+    }
+
+#if SURFACE_QUADTREE
+    for (i = 0; i < sSurfaceQuadNodesAllocated; i++) {
+        pack_surface_list(&sSurfaceQuadNodePool[i].packedLists[SPATIAL_PARTITION_FLOORS],
+                          sSurfaceQuadNodePool[i].lists[SPATIAL_PARTITION_FLOORS].next);
+        pack_surface_list(&sSurfaceQuadNodePool[i].packedLists[SPATIAL_PARTITION_CEILS],
+                          sSurfaceQuadNodePool[i].lists[SPATIAL_PARTITION_CEILS].next);
+    }
+#endif
+}
+
+/**
+ * Find the packed static surface list to search for the point (x, z), which must
+ * lie within the cell (cellX, cellZ).
+ */
+struct PackedSurfaceList *find_static_packed_list(s16 cellX, s16 cellZ, UNUSED s16 x, UNUSED s16 z,
+                                                  s32 listIndex) {
+#if SURFACE_QUADTREE
+    struct SurfaceQuadNode *quad;
+#endif
+
+    // The lists weren't packed because they outgrew the packed arrays, or the
+    // headless collision bench is searching the linked lists for comparison.
+    if (gStaticPackedSurfaces.count < 0) {
+        return NULL;
+    }
+
+#if SURFACE_QUADTREE
+    quad = find_static_surface_quad(cellX, cellZ, x, z);
+
+    if (quad != NULL) {
+        return &quad->packedLists[listIndex];
+    }
+#endif
+
+    return &gStaticPackedPartition[cellZ][cellX][listIndex];
+}
+#endif
+
 static void stub_surface_load_1(void) {
 }
 
@@ -358,6 +838,11 @@ static struct Surface *read_surface_data(s16 *vertexData, s16 **vertexIndices) {
     nz *= mag;
 
     surface = alloc_surface();
+#if SURFACE_POOL_ARENAS
+    if (surface == NULL) {
+        return NULL;
+    }
+#endif
 
     surface->vertex1[0] = x1;
     surface->vertex2[0] = x2;
@@ -524,9 +1009,42 @@ static void load_environmental_regions(s16 **data) {
  * Allocate some of the main pool for surfaces (2300 surf) and for surface nodes (7000 nodes).
  */
 void alloc_surface_pools(void) {
-    sSurfacePoolSize = 2300;
-    sSurfaceNodePool = main_pool_alloc(7000 * sizeof(struct SurfaceNode), MEMORY_POOL_LEFT);
+#if SURFACE_PACKED_LISTS
+    s32 i;
+
+#endif
+    sSurfacePoolSize = SURFACE_POOL_SIZE;
+#if SURFACE_POOL_ARENAS
+    surface_arena_init(&sSurfaceNodeArena, SURFACE_NODE_POOL_SIZE);
+    surface_arena_init(&sSurfaceArena, sSurfacePoolSize);
+#else
+    sSurfaceNodePool = main_pool_alloc(SURFACE_NODE_POOL_SIZE * sizeof(struct SurfaceNode), MEMORY_POOL_LEFT);
     sSurfacePool = main_pool_alloc(sSurfacePoolSize * sizeof(struct Surface), MEMORY_POOL_LEFT);
+#endif
+#if SURFACE_QUADTREE
+    sSurfaceQuadNodePool = main_pool_alloc(
+        SURFACE_QUADTREE_NODE_POOL_SIZE * sizeof(struct SurfaceQuadNode), MEMORY_POOL_LEFT);
+    sSurfaceQuadListPool = main_pool_alloc(
+        SURFACE_QUADTREE_LIST_POOL_SIZE * sizeof(struct SurfaceNode), MEMORY_POOL_LEFT);
+#endif
+#if DYNAMIC_SURFACE_CACHE
+    sCachedDynamicSurfaces = main_pool_alloc(SURFACE_POOL_SIZE * sizeof(struct Surface), MEMORY_POOL_LEFT);
+    sNumCachedDynamicSurfaces = 0;
+#endif
+#if SURFACE_PACKED_LISTS
+    gStaticPackedSurfaces.lowerY = main_pool_alloc(SURFACE_PACKED_POOL_SIZE * sizeof(s16), MEMORY_POOL_LEFT);
+    gStaticPackedSurfaces.upperY = main_pool_alloc(SURFACE_PACKED_POOL_SIZE * sizeof(s16), MEMORY_POOL_LEFT);
+    for (i = 0; i < 3; i++) {
+        gStaticPackedSurfaces.vertexX[i] =
+            main_pool_alloc(SURFACE_PACKED_POOL_SIZE * sizeof(s16), MEMORY_POOL_LEFT);
+        gStaticPackedSurfaces.vertexZ[i] =
+            main_pool_alloc(SURFACE_PACKED_POOL_SIZE * sizeof(s16), MEMORY_POOL_LEFT);
+    }
+    gStaticPackedSurfaces.plane =
+        main_pool_alloc(SURFACE_PACKED_POOL_SIZE * sizeof(*gStaticPackedSurfaces.plane), MEMORY_POOL_LEFT);
+    gStaticPackedSurfaces.surfaces =
+        main_pool_alloc(SURFACE_PACKED_POOL_SIZE * sizeof(*gStaticPackedSurfaces.surfaces), MEMORY_POOL_LEFT);
+#endif
 
     gCCMEnteredSlide = 0;
     reset_red_coins_collected();
@@ -598,6 +1116,12 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
     gSurfaceNodesAllocated = 0;
     gSurfacesAllocated = 0;
 
+#if DYNAMIC_SURFACE_CACHE
+    // The dynamic surfaces loaded so far are about to be overwritten.
+    sNumCachedDynamicSurfaces = 0;
+    sDynamicSurfaceFrame++;
+#endif
+
     clear_static_surfaces();
 
     // A while loop iterating through each section of the level data. Sections of data
@@ -625,6 +1149,13 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
         }
     }
 
+#if SURFACE_QUADTREE
+    build_static_surface_quadtree();
+#endif
+#if SURFACE_PACKED_LISTS
+    pack_static_surfaces();
+#endif
+
     if (macroObjects != NULL && *macroObjects != -1) {
         // If the first macro object presetID is within the range [0, 29].
         // Generally an early spawning method, every object is in BBH (the first level).
@@ -639,6 +1170,9 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
 
     gNumStaticSurfaceNodes = gSurfaceNodesAllocated;
     gNumStaticSurfaces = gSurfacesAllocated;
+#if SURFACE_POOL_ARENAS
+    record_surface_pool_usage();
+#endif
 }
 
 /**
@@ -646,6 +1180,32 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
  */
 void clear_dynamic_surfaces(void) {
     if (!(gTimeStopState & TIME_STOP_ACTIVE)) {
+#if DYNAMIC_SURFACE_CACHE
+        s32 i;
+
+        sNumCachedDynamicSurfaces = gSurfacesAllocated - gNumStaticSurfaces;
+#if SURFACE_POOL_ARENAS
+        // The copy has a fixed size, so objects past its end are rebuilt next frame.
+        if (sNumCachedDynamicSurfaces > SURFACE_POOL_SIZE) {
+            sNumCachedDynamicSurfaces = SURFACE_POOL_SIZE;
+        }
+        for (i = 0; i < sNumCachedDynamicSurfaces; i++) {
+            sCachedDynamicSurfaces[i] =
+                *(struct Surface *) surface_arena_get(&sSurfaceArena, gNumStaticSurfaces + i);
+        }
+#else
+        for (i = 0; i < sNumCachedDynamicSurfaces; i++) {
+            sCachedDynamicSurfaces[i] = sSurfacePool[gNumStaticSurfaces + i];
+        }
+#endif
+        sDynamicSurfaceFrame++;
+        gDynamicSurfaceCacheStats.rebuilt = 0;
+        gDynamicSurfaceCacheStats.reused = 0;
+#endif
+#if SURFACE_POOL_ARENAS
+        record_surface_pool_usage();
+#endif
+
         gSurfacesAllocated = gNumStaticSurfaces;
         gSurfaceNodesAllocated = gNumStaticSurfaceNodes;
 
@@ -656,10 +1216,51 @@ void clear_dynamic_surfaces(void) {
 static void unused_80383604(void) {
 }
 
+#if DYNAMIC_SURFACE_CACHE
+/**
+ * Applies a transformation to an object's vertices.
+ */
+static void transform_vertices(s16 **data, s16 *vertexData, Mat4 m) {
+    register s16 *vertices;
+    register f32 vx, vy, vz;
+    register s32 numVertices;
+
+    numVertices = *(*data);
+    (*data)++;
+
+    vertices = *data;
+
+    // Go through all vertices, rotating and translating them to transform the object.
+    while (numVertices--) {
+        vx = *(vertices++);
+        vy = *(vertices++);
+        vz = *(vertices++);
+
+        //! No bounds check on vertex data
+        *vertexData++ = (s16)(vx * m[0][0] + vy * m[1][0] + vz * m[2][0] + m[3][0]);
+        *vertexData++ = (s16)(vx * m[0][1] + vy * m[1][1] + vz * m[2][1] + m[3][1]);
+        *vertexData++ = (s16)(vx * m[0][2] + vy * m[1][2] + vz * m[2][2] + m[3][2]);
+    }
+
+    *data = vertices;
+}
+#endif
+
 /**
  * Applies an object's transformation to the object's vertices.
  */
 void transform_object_vertices(s16 **data, s16 *vertexData) {
+#if DYNAMIC_SURFACE_CACHE
+    Mat4 m;
+
+    if (gCurrentObject->header.gfx.throwMatrix == NULL) {
+        gCurrentObject->header.gfx.throwMatrix = &gCurrentObject->transform;
+        obj_build_transform_from_pos_and_angle(gCurrentObject, O_POS_INDEX, O_FACE_ANGLE_INDEX);
+    }
+
+    obj_apply_scale_to_matrix(gCurrentObject, m, gCurrentObject->transform);
+    transform_vertices(data, vertexData, m);
+#else
     register s16 *vertices;
     register f32 vx, vy, vz;
     register s32 numVertices;
@@ -694,6 +1295,7 @@ void transform_object_vertices(s16 **data, s16 *vertexData) {
     }
 
     *data = vertices;
+#endif
 }
 
 /**
@@ -752,6 +1354,95 @@ void load_object_surfaces(s16 **data, s16 *vertexData) {
     }
 }
 
+#if DYNAMIC_SURFACE_CACHE
+/**
+ * Copy a matrix, returning whether it differed from the destination. Compared
+ * bitwise, since the surfaces are only reused if the transform is exactly the same.
+ */
+static s32 update_cached_transform(Mat4 dest, Mat4 src) {
+    u32 *d = (u32 *) dest;
+    u32 *s = (u32 *) src;
+    s32 changed = FALSE;
+    s32 i;
+
+    for (i = 0; i < 16; i++) {
+        if (d[i] != s[i]) {
+            d[i] = s[i];
+            changed = TRUE;
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * Load the gCurrentObject's surfaces, copying them from last frame if it loaded
+ * the same collision model with the same transform then. Otherwise transform
+ * and load them from the collision data as usual.
+ */
+static void load_object_surfaces_cached(s16 *collisionData, s16 *vertexData) {
+    struct DynamicSurfaceCacheEntry *entry;
+    struct Surface *surface;
+    s32 surfaceStart = gSurfacesAllocated;
+    s32 reusable;
+    s32 i;
+    Mat4 m;
+
+    if (gCurrentObject < gObjectPool || gCurrentObject >= &gObjectPool[OBJECT_POOL_CAPACITY]) {
+        collisionData++;
+        transform_object_vertices(&collisionData, vertexData);
+        while (*collisionData != TERRAIN_LOAD_CONTINUE) {
+            load_object_surfaces(&collisionData, vertexData);
+        }
+        return;
+    }
+
+    entry = &sDynamicSurfaceCache[gCurrentObject - gObjectPool];
+
+    // Build the same matrix that transform_object_vertices will use.
+    if (gCurrentObject->header.gfx.throwMatrix == NULL) {
+        gCurrentObject->header.gfx.throwMatrix = &gCurrentObject->transform;
+        obj_build_transform_from_pos_and_angle(gCurrentObject, O_POS_INDEX, O_FACE_ANGLE_INDEX);
+    }
+    obj_apply_scale_to_matrix(gCurrentObject, m, gCurrentObject->transform);
+
+    reusable = entry->frame == sDynamicSurfaceFrame - 1
+               && entry->collisionData == collisionData
+               && entry->behavior == gCurrentObject->behavior
+               && entry->surfaceStart + entry->numSurfaces <= sNumCachedDynamicSurfaces;
+
+    if (!update_cached_transform(entry->transform, m) && reusable) {
+        for (i = 0; i < entry->numSurfaces; i++) {
+            surface = alloc_surface();
+#if SURFACE_POOL_ARENAS
+            if (surface == NULL) {
+                break;
+            }
+#endif
+            *surface = sCachedDynamicSurfaces[entry->surfaceStart + i];
+            add_surface(surface, TRUE);
+        }
+
+        gDynamicSurfaceCacheStats.reused += entry->numSurfaces;
+    } else {
+        // The transform was already built above, so don't build it again.
+        collisionData++;
+        transform_vertices(&collisionData, vertexData, m);
+        while (*collisionData != TERRAIN_LOAD_CONTINUE) {
+            load_object_surfaces(&collisionData, vertexData);
+        }
+
+        gDynamicSurfaceCacheStats.rebuilt += gSurfacesAllocated - surfaceStart;
+    }
+
+    entry->collisionData = gCurrentObject->collisionData;
+    entry->behavior = gCurrentObject->behavior;
+    entry->frame = sDynamicSurfaceFrame;
+    entry->surfaceStart = surfaceStart - gNumStaticSurfaces;
+    entry->numSurfaces = gSurfacesAllocated - surfaceStart;
+}
+#endif
+
 /**
  * Transform an object's vertices, reload them, and render the object.
  */
@@ -778,6 +1469,9 @@ void load_object_collision_model(void) {
     // Update if no Time Stop, in range, and in the current room.
     if (!(gTimeStopState & TIME_STOP_ACTIVE) && marioDist < tangibleDist
         && !(gCurrentObject->activeFlags & ACTIVE_FLAG_IN_DIFFERENT_ROOM)) {
+#if DYNAMIC_SURFACE_CACHE
+        load_object_surfaces_cached(collisionData, vertexData);
+#else
         collisionData++;
         transform_object_vertices(&collisionData, vertexData);
 
@@ -785,6 +1479,7 @@ void load_object_collision_model(void) {
         while (*collisionData != TERRAIN_LOAD_CONTINUE) {
             load_object_surfaces(&collisionData, vertexData);
         }
+#endif
     }
 
     if (marioDist < gCurrentObject->oDrawingDistance) {
@@ -3,12 +3,16 @@
 
 #include <PR/ultratypes.h>
 
+#include "config.h"
 #include "surface_collision.h"
 #include "types.h"
 
 #define NUM_CELLS       (2 * LEVEL_BOUNDARY_MAX / CELL_SIZE)
 #define NUM_CELLS_INDEX (NUM_CELLS - 1)
 
+#define SURFACE_NODE_POOL_SIZE 7000
+#define SURFACE_POOL_SIZE      2300
+
 struct SurfaceNode
 {
     struct SurfaceNode *next;
@@ -24,20 +28,136 @@ enum
 
 typedef struct SurfaceNode SpatialPartitionCell[3];
 
+#if SURFACE_PACKED_LISTS
+/**
+ * A static surface list copied into consecutive slots of gStaticPackedSurfaces.
+ */
+struct PackedSurfaceList
+{
+    s32 start;
+    s32 count;
+};
+
+typedef struct PackedSurfaceList PackedPartitionCell[3];
+
+// Batched searches may read this many slots past the end of a list.
+#define SURFACE_PACKED_POOL_PADDING 8
+
+// Enough slots for every static surface node, plus the quadtree's copies.
+#if SURFACE_QUADTREE
+#define SURFACE_PACKED_POOL_SIZE \
+    (SURFACE_NODE_POOL_SIZE + SURFACE_QUADTREE_LIST_POOL_SIZE + SURFACE_PACKED_POOL_PADDING)
+#else
+#define SURFACE_PACKED_POOL_SIZE (SURFACE_NODE_POOL_SIZE + SURFACE_PACKED_POOL_PADDING)
+#endif
+
+/**
+ * The fields find_floor and find_ceil read for every candidate, split into
+ * separate arrays so that a list walk streams through memory instead of
+ * following SurfaceNode and Surface pointers, and so that several candidates
+ * can be loaded into vector registers at once.
+ */
+struct PackedSurfaces
+{
+    s16 *lowerY;
+    s16 *upperY;
+    s16 *vertexX[3];
+    s16 *vertexZ[3];
+    f32 (*plane)[4]; // normal.x, normal.y, normal.z, originOffset
+    struct Surface **surfaces;
+    s32 count;
+};
+#endif
+
+#if SURFACE_QUADTREE
+// Cells whose lists are longer than this are split into quadrants.
+#define SURFACE_QUADTREE_LEAF_SIZE 12
+// A cell is split at most this many times (0x400 -> 0x40 units).
+#define SURFACE_QUADTREE_MAX_DEPTH 4
+#define SURFACE_QUADTREE_NODE_POOL_SIZE 1024
+#define SURFACE_QUADTREE_LIST_POOL_SIZE 8000
+// Largest distance a wall can be from the queried point and still push it,
+// i.e. the 200 unit radius cap over the sine of the projection angle (0.707).
+#define SURFACE_QUADTREE_WALL_MARGIN 300
+
+/**
+ * A quadrant of a static partition cell. Each list holds the surfaces of the
+ * parent's list that overlap the quadrant, in the same order as the parent.
+ */
+struct SurfaceQuadNode
+{
+    struct SurfaceQuadNode *children; // 4 quadrants (-x-z, +x-z, -x+z, +x+z) or NULL
+    SpatialPartitionCell lists;
+#if SURFACE_PACKED_LISTS
+    PackedPartitionCell packedLists;
+#endif
+};
+#endif
+
+#if DYNAMIC_SURFACE_CACHE
+/**
+ * Number of dynamic surfaces that were transformed from collision data or
+ * copied from last frame, this frame.
+ */
+struct DynamicSurfaceCacheStats
+{
+    s32 rebuilt;
+    s32 reused;
+};
+#endif
+
+#if SURFACE_POOL_ARENAS
+// Surfaces and surface nodes are allocated in chunks of this many entries.
+#define SURFACE_ARENA_CHUNK_LENGTH 256
+#define SURFACE_ARENA_MAX_CHUNKS   128
+
+/**
+ * The most surface nodes and surfaces that were allocated at once while a
+ * level was loaded, and how many allocations failed because no memory was left.
+ */
+struct SurfacePoolUsage
+{
+    s32 peakSurfaceNodes;
+    s32 peakSurfaces;
+    s32 numDropped;
+};
+#endif
+
 // Needed for bs bss reordering memes.
 extern s32 unused8038BE90;
 
 extern SpatialPartitionCell gStaticSurfacePartition[NUM_CELLS][NUM_CELLS];
 extern SpatialPartitionCell gDynamicSurfacePartition[NUM_CELLS][NUM_CELLS];
+#if !SURFACE_POOL_ARENAS
 extern struct SurfaceNode *sSurfaceNodePool;
 extern struct Surface *sSurfacePool;
+#endif
 extern s16 sSurfacePoolSize;
+#if SURFACE_QUADTREE
+extern struct SurfaceQuadNode *gStaticSurfaceQuadtree[NUM_CELLS][NUM_CELLS];
+#endif
+#if DYNAMIC_SURFACE_CACHE
+extern struct DynamicSurfaceCacheStats gDynamicSurfaceCacheStats;
+#endif
+#if SURFACE_POOL_ARENAS
+extern struct SurfacePoolUsage gSurfacePoolUsage[];
+#endif
+#if SURFACE_PACKED_LISTS
+extern PackedPartitionCell gStaticPackedPartition[NUM_CELLS][NUM_CELLS];
+extern struct PackedSurfaces gStaticPackedSurfaces;
+#endif
 
 void alloc_surface_pools(void);
 #ifdef NO_SEGMENTED_MEMORY
 u32 get_area_terrain_size(s16 *data);
 #endif
 void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects);
+#if SURFACE_QUADTREE
+struct SurfaceNode *find_static_surface_list(s16 cellX, s16 cellZ, s16 x, s16 z, s32 listIndex);
+#endif
+#if SURFACE_PACKED_LISTS
+struct PackedSurfaceList *find_static_packed_list(s16 cellX, s16 cellZ, s16 x, s16 z, s32 listIndex);
+#endif
 void clear_dynamic_surfaces(void);
 void load_object_collision_model(void);
 
@@ -0,0 +1,151 @@
+#include <ultra64.h>
+
+#include "sm64.h"
+#include "decompress.h"
+
+#if MIO0_FAST_DECODER
+
+/**
+ * C replacement for the handwritten MIO0 decoder in asm/decompress.s.
+ *
+ * MIO0 data is a 16 byte header followed by three streams: layout bits, one
+ * per output step, then 16-bit lookback pairs, then literal bytes. A set bit
+ * copies the next literal, a clear one copies 3 to 18 bytes from up to 4096
+ * bytes back in the output. The layout bits are read a word at a time, like
+ * the original, but lookbacks whose distance is a multiple of 4 are copied a
+ * word at a time once the output is aligned, and every lookback copies its
+ * first three bytes without a loop.
+ *
+ * The decoder can also be run incrementally, producing at most a given number
+ * of bytes per call, so that a large segment can be spread over several
+ * frames. The compressed data must stay in place until the decode finishes.
+ */
+
+/**
+ * Copy a lookback of length bytes from offset bytes back. The copy runs
+ * forwards, so a lookback that overlaps its own output repeats a pattern.
+ */
+static void mio0_copy_lookback(u8 *dest, u32 offset, u32 length) {
+    u8 *src = dest - offset;
+
+    if (length >= 3) {
+        dest[0] = src[0];
+        dest[1] = src[1];
+        dest[2] = src[2];
+        dest += 3;
+        src += 3;
+        length -= 3;
+    }
+
+    // Each word read is at least 4 bytes back, so it has already been written
+    if (length >= 4 && (offset & 3) == 0) {
+        while (((uintptr_t) dest & 3) != 0) {
+            *dest++ = *src++;
+            length--;
+        }
+        while (length >= 4) {
+            *(u32 *) dest = *(u32 *) src;
+            dest += 4;
+            src += 4;
+            length -= 4;
+        }
+    }
+
+    while (length != 0) {
+        *dest++ = *src++;
+        length--;
+    }
+}
+
+/**
+ * Start decoding the MIO0 data at mio0 into dest, which must have room for
+ * the decompressed size from the header.
+ */
+void mio0_stream_init(struct Mio0Stream *stream, void *mio0, void *dest) {
+    u8 *header = mio0;
+
+    stream->layout = (u32 *) (header + 16);
+    stream->lookbacks = (u16 *) (header + ((u32 *) header)[2]);
+    stream->literals = header + ((u32 *) header)[3];
+    stream->dest = dest;
+    stream->destEnd = (u8 *) dest + ((u32 *) header)[1];
+    stream->layoutBits = 0;
+    stream->numLayoutBits = 0;
+    stream->pendingLength = 0;
+    stream->pendingOffset = 0;
+}
+
+/**
+ * Decode up to maxBytes more bytes. A lookback that does not fit is finished
+ * by the next call. Returns TRUE once all of the data has been decoded.
+ */
+s32 mio0_stream_decode(struct Mio0Stream *stream, u32 maxBytes) {
+    u8 *dest = stream->dest;
+    u8 *limit = stream->destEnd;
+    u32 *layout = stream->layout;
+    u16 *lookbacks = stream->lookbacks;
+    u8 *literals = stream->literals;
+    u32 bits = stream->layoutBits;
+    s32 numBits = stream->numLayoutBits;
+    u32 length;
+    u32 offset;
+
+    if (maxBytes < (u32) (limit - dest)) {
+        limit = dest + maxBytes;
+    }
+
+    if (stream->pendingLength != 0) {
+        length = stream->pendingLength;
+        if (length > (u32) (limit - dest)) {
+            length = limit - dest;
+        }
+        mio0_copy_lookback(dest, stream->pendingOffset, length);
+        dest += length;
+        stream->pendingLength -= length;
+    }
+
+    while (dest < limit) {
+        if (numBits == 0) {
+            bits = *layout++;
+            numBits = 32;
+        }
+
+        if ((s32) bits < 0) {
+            *dest++ = *literals++;
+        } else {
+            length = (*lookbacks >> 12) + 3;
+            offset = (*lookbacks & 0xFFF) + 1;
+            lookbacks++;
+            if (length > (u32) (limit - dest)) {
+                stream->pendingLength = length - (limit - dest);
+                stream->pendingOffset = offset;
+                length = limit - dest;
+            }
+            mio0_copy_lookback(dest, offset, length);
+            dest += length;
+        }
+
+        bits <<= 1;
+        numBits--;
+    }
+
+    stream->dest = dest;
+    stream->layout = layout;
+    stream->lookbacks = lookbacks;
+    stream->literals = literals;
+    stream->layoutBits = bits;
+    stream->numLayoutBits = numBits;
+    return dest == stream->destEnd;
+}
+
+/**
+ * Decode the MIO0 data at mio0 into dest in one go.
+ */
+void mio0_decompress(void *mio0, void *dest) {
+    struct Mio0Stream stream;
+
+    mio0_stream_init(&stream, mio0, dest);
+    mio0_stream_decode(&stream, ((u32 *) mio0)[1]);
+}
+
+#endif
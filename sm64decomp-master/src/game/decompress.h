@@ -1,6 +1,33 @@
 #ifndef DECOMPRESS_H
 #define DECOMPRESS_H
 
+#include <PR/ultratypes.h>
+
+#include "config.h"
+
+#if MIO0_FAST_DECODER
+/**
+ * State of an incremental MIO0 decode.
+ */
+struct Mio0Stream {
+    /*0x00*/ u32 *layout;
+    /*0x04*/ u16 *lookbacks;
+    /*0x08*/ u8 *literals;
+    /*0x0C*/ u8 *dest;
+    /*0x10*/ u8 *destEnd;
+    /*0x14*/ u32 layoutBits;
+    /*0x18*/ s32 numLayoutBits;
+    /*0x1C*/ u16 pendingLength;
+    /*0x1E*/ u16 pendingOffset;
+};
+
+void mio0_stream_init(struct Mio0Stream *stream, void *mio0, void *dest);
+s32 mio0_stream_decode(struct Mio0Stream *stream, u32 maxBytes);
+void mio0_decompress(void *mio0, void *dest);
+
+#define decompress mio0_decompress
+#else
 void decompress(void *mio0, void *dest);
+#endif
 
 #endif // DECOMPRESS_H
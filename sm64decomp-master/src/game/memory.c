@@ -6,6 +6,8 @@
 
 #include "buffers/buffers.h"
 #include "decompress.h"
+#include "engine/anim_cache.h"
+#include "area.h"
 #include "game_init.h"
 #include "main.h"
 #include "memory.h"
@@ -64,6 +66,17 @@ struct MainPoolBlock *sPoolListHeadR;
 
 static struct MainPoolState *gMainPoolState = NULL;
 
+#if MAIN_POOL_TRACKING
+struct MainPoolTracking gMainPoolTracking;
+u8 gMainPoolLevelCmd = MAIN_POOL_NO_LEVEL_CMD;
+
+// The segment being loaded, which new blocks are tagged with
+static u8 sTrackedSegment = MAIN_POOL_NO_SEGMENT;
+// Set while allocating the block of an alloc-only pool, whose header isn't
+// filled in yet
+static u8 sTrackingAllocOnlyPool = FALSE;
+#endif
+
 uintptr_t set_segment_base_addr(s32 segment, void *addr) {
     sSegmentTable[segment] = (uintptr_t) addr & 0x1FFFFFFF;
     return sSegmentTable[segment];
@@ -107,6 +120,88 @@ void move_segment_table_to_dmem(void) {
 }
 #endif
 
+#if MAIN_POOL_TRACKING
+/**
+ * Update the peak usage of the pool overall and of the current area. The
+ * unused part of alloc-only pools isn't counted, since the level pool and the
+ * display list heap take the rest of the pool before they are filled.
+ */
+static void main_pool_track_usage(void) {
+    struct MainPoolRecord *record;
+    struct AllocOnlyPool *pool;
+    u32 used = gMainPoolTracking.size - sPoolFreeSpace;
+    s32 i;
+
+    for (i = 0; i < gMainPoolTracking.numRecords; i++) {
+        record = &gMainPoolTracking.records[i];
+        if (record->isAllocOnlyPool) {
+            pool = (struct AllocOnlyPool *) (record->block + 16);
+            used -= pool->totalSpace - pool->usedSpace;
+        }
+    }
+
+    if (used > gMainPoolTracking.peakUsed) {
+        gMainPoolTracking.peakUsed = used;
+    }
+    if (gCurrLevelNum >= 0 && gCurrLevelNum < LEVEL_COUNT && gCurrAreaIndex >= 0
+        && gCurrAreaIndex < MAIN_POOL_TRACKED_AREAS
+        && used > gMainPoolTracking.peakUsedPerArea[gCurrLevelNum][gCurrAreaIndex]) {
+        gMainPoolTracking.peakUsedPerArea[gCurrLevelNum][gCurrAreaIndex] = used;
+    }
+}
+
+/**
+ * Forget the blocks of one side from 'block' inward, which have just been
+ * freed. Left blocks at or above it are freed, as are right blocks at or below
+ * it.
+ */
+static void main_pool_track_release(u32 side, u8 *block) {
+    struct MainPoolRecord *record;
+    s32 numKept = 0;
+    s32 i;
+
+    for (i = 0; i < gMainPoolTracking.numRecords; i++) {
+        record = &gMainPoolTracking.records[i];
+        if (record->side != side || (side == MEMORY_POOL_LEFT ? record->block < block : record->block > block)) {
+            gMainPoolTracking.records[numKept++] = *record;
+        }
+    }
+    gMainPoolTracking.numRecords = numKept;
+}
+
+static void main_pool_track_alloc(u8 *block, u32 size, u32 side, const void *site) {
+    struct MainPoolRecord *record;
+
+    if (gMainPoolTracking.numRecords < MAIN_POOL_MAX_RECORDS) {
+        record = &gMainPoolTracking.records[gMainPoolTracking.numRecords++];
+        record->block = block;
+        record->size = size;
+        record->side = side;
+        record->segment = sTrackedSegment;
+        record->levelCmd = gMainPoolLevelCmd;
+        record->isAllocOnlyPool = sTrackingAllocOnlyPool;
+        record->site = site;
+    } else {
+        gMainPoolTracking.numDroppedRecords++;
+    }
+    if (!sTrackingAllocOnlyPool) {
+        main_pool_track_usage();
+    }
+}
+
+static void main_pool_track_free(u8 *block, u32 side) {
+    // Blocks allocated before the last pushed state belong to whoever pushed
+    // it, and will be restored as allocated when the state is popped
+    if (gMainPoolState != NULL
+        && (side == MEMORY_POOL_LEFT ? block < (u8 *) gMainPoolState->listHeadL
+                                     : block >= (u8 *) gMainPoolState->listHeadR)) {
+        gMainPoolTracking.numCrossStateFrees++;
+    }
+    main_pool_track_usage();
+    main_pool_track_release(side, block);
+}
+#endif
+
 /**
  * Initialize the main memory pool. This pool is conceptually a pair of stacks
  * that grow inward from the left and right. It therefore only supports
@@ -123,6 +218,9 @@ void main_pool_init(void *start, void *end) {
     sPoolListHeadL->next = NULL;
     sPoolListHeadR->prev = NULL;
     sPoolListHeadR->next = NULL;
+#if MAIN_POOL_TRACKING
+    gMainPoolTracking.size = sPoolFreeSpace;
+#endif
 }
 
 /**
@@ -153,6 +251,15 @@ void *main_pool_alloc(u32 size, u32 side) {
             addr = (u8 *) sPoolListHeadR + 16;
         }
     }
+#if MAIN_POOL_TRACKING
+    if (addr != NULL) {
+#ifdef __GNUC__
+        main_pool_track_alloc((u8 *) addr - 16, size, side, __builtin_return_address(0));
+#else
+        main_pool_track_alloc((u8 *) addr - 16, size, side, NULL);
+#endif
+    }
+#endif
     return addr;
 }
 
@@ -166,6 +273,9 @@ u32 main_pool_free(void *addr) {
     struct MainPoolBlock *block = (struct MainPoolBlock *) ((u8 *) addr - 16);
     struct MainPoolBlock *oldListHead = (struct MainPoolBlock *) ((u8 *) addr - 16);
 
+#if MAIN_POOL_TRACKING
+    main_pool_track_free((u8 *) block, block < sPoolListHeadL ? MEMORY_POOL_LEFT : MEMORY_POOL_RIGHT);
+#endif
     if (oldListHead < sPoolListHeadL) {
         while (oldListHead->next != NULL) {
             oldListHead = oldListHead->next;
@@ -224,6 +334,11 @@ u32 main_pool_push_state(void) {
     gMainPoolState->listHeadL = lhead;
     gMainPoolState->listHeadR = rhead;
     gMainPoolState->prev = prevState;
+#if MAIN_POOL_TRACKING
+    if (++gMainPoolTracking.depth > gMainPoolTracking.maxDepth) {
+        gMainPoolTracking.maxDepth = gMainPoolTracking.depth;
+    }
+#endif
     return sPoolFreeSpace;
 }
 
@@ -232,6 +347,16 @@ u32 main_pool_push_state(void) {
  * amount of free space left in the pool.
  */
 u32 main_pool_pop_state(void) {
+#if MAIN_POOL_TRACKING
+    if (gMainPoolState == NULL) {
+        gMainPoolTracking.numUnmatchedPops++;
+        return 0;
+    }
+    main_pool_track_usage();
+    main_pool_track_release(MEMORY_POOL_LEFT, (u8 *) gMainPoolState->listHeadL);
+    main_pool_track_release(MEMORY_POOL_RIGHT, (u8 *) gMainPoolState->listHeadR - 1);
+    gMainPoolTracking.depth--;
+#endif
     sPoolFreeSpace = gMainPoolState->freeSpace;
     sPoolListHeadL = gMainPoolState->listHeadL;
     sPoolListHeadR = gMainPoolState->listHeadR;
@@ -281,7 +406,15 @@ static void *dynamic_dma_read(u8 *srcStart, u8 *srcEnd, u32 side) {
  * address to this block.
  */
 void *load_segment(s32 segment, u8 *srcStart, u8 *srcEnd, u32 side) {
-    void *addr = dynamic_dma_read(srcStart, srcEnd, side);
+    void *addr;
+
+#if MAIN_POOL_TRACKING
+    sTrackedSegment = segment;
+#endif
+    addr = dynamic_dma_read(srcStart, srcEnd, side);
+#if MAIN_POOL_TRACKING
+    sTrackedSegment = MAIN_POOL_NO_SEGMENT;
+#endif
 
     if (addr != NULL) {
         set_segment_base_addr(segment, addr);
@@ -330,7 +463,13 @@ void *load_segment_decompress(s32 segment, u8 *srcStart, u8 *srcEnd) {
 
     if (compressed != NULL) {
         dma_read(compressed, srcStart, srcEnd);
+#if MAIN_POOL_TRACKING
+        sTrackedSegment = segment;
         dest = main_pool_alloc(*size, MEMORY_POOL_LEFT);
+        sTrackedSegment = MAIN_POOL_NO_SEGMENT;
+#else
+        dest = main_pool_alloc(*size, MEMORY_POOL_LEFT);
+#endif
         if (dest != NULL) {
             decompress(compressed, dest);
             set_segment_base_addr(segment, dest);
@@ -358,6 +497,242 @@ void *load_segment_decompress_heap(u32 segment, u8 *srcStart, u8 *srcEnd) {
     return gDecompressionHeap;
 }
 
+#if SEGMENT_LOAD_PIPELINE
+/**
+ * Segment loads queued by the level script run together when the script
+ * reaches a command other than a load. All their destinations are allocated
+ * first, in queue order, so the pool ends up laid out exactly as if they had
+ * run one at a time. Their ROM data is then streamed in by DMA, compressed
+ * segments into one staging block on the right of the pool, and each segment
+ * is decompressed as soon as its data has arrived while the following ones
+ * are still being read.
+ */
+
+#define SEGMENT_LOAD_QUEUE_SIZE 32
+// DMA transfers are split into chunks like dma_read's, and up to this many
+// chunks are queued with the PI manager at a time
+#define SEGMENT_LOAD_MAX_CHUNKS 16
+#define SEGMENT_LOAD_CHUNK_SIZE 0x1000
+
+struct SegmentLoad {
+    u8 type;
+    u8 segment;
+    u8 *srcStart;
+    u8 *srcEnd;
+    u8 *dest;
+    u8 *dmaDest; // dest for raw segments, the staging block otherwise
+    u32 dmaSize; // 0 if the destination couldn't be allocated
+    u32 dmaEnd;  // stream position at which the segment's data has arrived
+};
+
+static struct SegmentLoad sSegmentLoads[SEGMENT_LOAD_QUEUE_SIZE];
+static s32 sNumSegmentLoads = 0;
+static u8 sSegmentLoadHeader[16] ALIGNED16;
+
+static OSMesgQueue sSegmentDmaMesgQueue;
+static OSMesg sSegmentDmaMesgBuf[SEGMENT_LOAD_MAX_CHUNKS];
+static OSIoMesg sSegmentDmaIoMesgs[SEGMENT_LOAD_MAX_CHUNKS];
+static u32 sSegmentDmaChunkSizes[SEGMENT_LOAD_MAX_CHUNKS];
+static u8 sSegmentDmaMesgQueueCreated = FALSE;
+
+static s32 sStreamLoad;      // load whose data is being requested
+static u32 sStreamLoadOffset; // bytes of that load's data requested so far
+static u32 sStreamDone;      // bytes of all loads' data that have arrived
+static s32 sStreamFirstChunk;
+static s32 sStreamNumChunks;
+
+/**
+ * Request chunks of the queued loads' data until the PI manager has as many
+ * as it's allowed.
+ */
+static void segment_stream_issue(void) {
+    struct SegmentLoad *load;
+    u32 size;
+    s32 slot;
+
+    while (sStreamNumChunks < SEGMENT_LOAD_MAX_CHUNKS && sStreamLoad < sNumSegmentLoads) {
+        load = &sSegmentLoads[sStreamLoad];
+        if (sStreamLoadOffset >= load->dmaSize) {
+            sStreamLoad++;
+            sStreamLoadOffset = 0;
+            continue;
+        }
+
+        if (sStreamLoadOffset == 0) {
+            osInvalDCache(load->dmaDest, load->dmaSize);
+        }
+        size = load->dmaSize - sStreamLoadOffset;
+        if (size > SEGMENT_LOAD_CHUNK_SIZE) {
+            size = SEGMENT_LOAD_CHUNK_SIZE;
+        }
+
+        slot = (sStreamFirstChunk + sStreamNumChunks) % SEGMENT_LOAD_MAX_CHUNKS;
+        sSegmentDmaChunkSizes[slot] = size;
+        osPiStartDma(&sSegmentDmaIoMesgs[slot], OS_MESG_PRI_NORMAL, OS_READ,
+                     (uintptr_t) load->srcStart + sStreamLoadOffset, load->dmaDest + sStreamLoadOffset,
+                     size, &sSegmentDmaMesgQueue);
+        sStreamLoadOffset += size;
+        sStreamNumChunks++;
+    }
+}
+
+/**
+ * Wait until the stream has reached 'position', keeping the PI manager busy
+ * meanwhile. Chunks complete in the order they were requested.
+ */
+static void segment_stream_wait(u32 position) {
+    OSMesg msg;
+
+    while (sStreamDone < position) {
+        osRecvMesg(&sSegmentDmaMesgQueue, &msg, OS_MESG_BLOCK);
+        sStreamDone += sSegmentDmaChunkSizes[sStreamFirstChunk];
+        sStreamFirstChunk = (sStreamFirstChunk + 1) % SEGMENT_LOAD_MAX_CHUNKS;
+        sStreamNumChunks--;
+        segment_stream_issue();
+    }
+}
+
+/**
+ * Load the segments one at a time into their allocated destinations, for
+ * when there isn't room to stage all of the compressed ones together.
+ */
+static void load_queued_segments_serially(void) {
+    struct SegmentLoad *load;
+    u8 *compressed;
+    s32 i;
+
+    for (i = 0; i < sNumSegmentLoads; i++) {
+        load = &sSegmentLoads[i];
+        if (load->dmaSize == 0) {
+            continue;
+        }
+
+        if (load->type == SEGMENT_LOAD_RAW) {
+            dma_read(load->dest, load->srcStart, load->srcEnd);
+        } else {
+            compressed = main_pool_alloc(load->dmaSize, MEMORY_POOL_RIGHT);
+            if (compressed == NULL) {
+                continue;
+            }
+            dma_read(compressed, load->srcStart, load->srcEnd);
+            decompress(compressed, load->dest);
+            main_pool_free(compressed);
+        }
+        set_segment_base_addr(load->segment, load->dest);
+    }
+}
+
+/**
+ * Queue a segment to be loaded by the next flush_segment_loads.
+ */
+void queue_segment_load(u32 type, s32 segment, u8 *srcStart, u8 *srcEnd) {
+    struct SegmentLoad *load;
+
+    if (sNumSegmentLoads == SEGMENT_LOAD_QUEUE_SIZE) {
+        flush_segment_loads();
+    }
+
+    load = &sSegmentLoads[sNumSegmentLoads++];
+    load->type = type;
+    load->segment = segment;
+    load->srcStart = srcStart;
+    load->srcEnd = srcEnd;
+}
+
+/**
+ * Run every queued segment load and wait for them to finish.
+ */
+void flush_segment_loads(void) {
+    struct SegmentLoad *load;
+    u32 stagingSize = 0;
+    u32 streamEnd = 0;
+    u8 *staging = NULL;
+    u8 *stagingPos;
+    s32 i;
+
+    if (sNumSegmentLoads == 0) {
+        return;
+    }
+
+    for (i = 0; i < sNumSegmentLoads; i++) {
+        load = &sSegmentLoads[i];
+        load->dmaSize = ALIGN16(load->srcEnd - load->srcStart);
+#if MAIN_POOL_TRACKING
+        sTrackedSegment = load->segment;
+#endif
+        if (load->type == SEGMENT_LOAD_RAW) {
+            load->dest = main_pool_alloc(load->dmaSize, MEMORY_POOL_LEFT);
+        } else if (load->type == SEGMENT_LOAD_MIO0) {
+            // Decompressed size from mio0 header
+            dma_read(sSegmentLoadHeader, load->srcStart, load->srcStart + sizeof(sSegmentLoadHeader));
+            load->dest = main_pool_alloc(*(u32 *) (sSegmentLoadHeader + 4), MEMORY_POOL_LEFT);
+        } else {
+            load->dest = gDecompressionHeap;
+        }
+#if MAIN_POOL_TRACKING
+        sTrackedSegment = MAIN_POOL_NO_SEGMENT;
+#endif
+
+        if (load->dest == NULL) {
+            load->dmaSize = 0;
+        } else if (load->type != SEGMENT_LOAD_RAW) {
+            stagingSize += load->dmaSize;
+        }
+    }
+
+    if (stagingSize != 0) {
+        staging = main_pool_alloc(stagingSize, MEMORY_POOL_RIGHT);
+        if (staging == NULL) {
+            load_queued_segments_serially();
+            sNumSegmentLoads = 0;
+            return;
+        }
+    }
+
+    stagingPos = staging;
+    for (i = 0; i < sNumSegmentLoads; i++) {
+        load = &sSegmentLoads[i];
+        if (load->type == SEGMENT_LOAD_RAW) {
+            load->dmaDest = load->dest;
+        } else {
+            load->dmaDest = stagingPos;
+            stagingPos += load->dmaSize;
+        }
+        streamEnd += load->dmaSize;
+        load->dmaEnd = streamEnd;
+    }
+
+    if (!sSegmentDmaMesgQueueCreated) {
+        osCreateMesgQueue(&sSegmentDmaMesgQueue, sSegmentDmaMesgBuf, SEGMENT_LOAD_MAX_CHUNKS);
+        sSegmentDmaMesgQueueCreated = TRUE;
+    }
+    sStreamLoad = 0;
+    sStreamLoadOffset = 0;
+    sStreamDone = 0;
+    sStreamFirstChunk = 0;
+    sStreamNumChunks = 0;
+    segment_stream_issue();
+
+    for (i = 0; i < sNumSegmentLoads; i++) {
+        load = &sSegmentLoads[i];
+        if (load->dmaSize == 0) {
+            continue;
+        }
+
+        segment_stream_wait(load->dmaEnd);
+        if (load->type != SEGMENT_LOAD_RAW) {
+            decompress(load->dmaDest, load->dest);
+        }
+        set_segment_base_addr(load->segment, load->dest);
+    }
+
+    if (staging != NULL) {
+        main_pool_free(staging);
+    }
+    sNumSegmentLoads = 0;
+}
+#endif
+
 void load_engine_code_segment(void) {
     void *startAddr = (void *) SEG_ENGINE;
     u32 totalSize = SEG_FRAMEBUFFERS - SEG_ENGINE;
@@ -381,7 +756,13 @@ struct AllocOnlyPool *alloc_only_pool_init(u32 size, u32 side) {
     struct AllocOnlyPool *subPool = NULL;
 
     size = ALIGN4(size);
+#if MAIN_POOL_TRACKING
+    sTrackingAllocOnlyPool = TRUE;
     addr = main_pool_alloc(size + sizeof(struct AllocOnlyPool), side);
+    sTrackingAllocOnlyPool = FALSE;
+#else
+    addr = main_pool_alloc(size + sizeof(struct AllocOnlyPool), side);
+#endif
     if (addr != NULL) {
         subPool = (struct AllocOnlyPool *) addr;
         subPool->totalSpace = size;
@@ -418,7 +799,13 @@ struct AllocOnlyPool *alloc_only_pool_resize(struct AllocOnlyPool *pool, u32 siz
     struct AllocOnlyPool *newPool;
 
     size = ALIGN4(size);
+#if MAIN_POOL_TRACKING
+    sTrackingAllocOnlyPool = TRUE;
+    newPool = main_pool_realloc(pool, size + sizeof(struct AllocOnlyPool));
+    sTrackingAllocOnlyPool = FALSE;
+#else
     newPool = main_pool_realloc(pool, size + sizeof(struct AllocOnlyPool));
+#endif
     if (newPool != NULL) {
         pool->totalSpace = size;
     }
@@ -572,3 +959,32 @@ s32 load_patchable_table(struct MarioAnimation *a, u32 index) {
     }
     return ret;
 }
+
+#if ANIMATION_CACHE
+/**
+ * Version of load_patchable_table for Mario's animations. An animation that is
+ * still in the animation cache is copied from there instead of being read from
+ * ROM again, and the cache is told which animation the buffer now holds.
+ */
+s32 load_patchable_animation(struct MarioAnimation *a, u32 index) {
+    s32 ret = FALSE;
+    struct MarioAnimDmaRelatedThing *table = a->animDmaTable;
+    u8 *addr;
+    u32 size;
+
+    if (index < table->count) {
+        addr = table->srcAddr + table->anim[index].offset;
+        size = table->anim[index].size;
+        if (a->currentAnimAddr != addr) {
+            if (!anim_cache_load(a->targetAnim, addr, size)) {
+                dma_read((u8 *) a->targetAnim, addr, addr + size);
+                anim_cache_store(addr, a->targetAnim, size);
+            }
+            anim_cache_set_source(a->targetAnim, addr);
+            a->currentAnimAddr = addr;
+            ret = TRUE;
+        }
+    }
+    return ret;
+}
+#endif
@@ -4,10 +4,19 @@
 #include <PR/ultratypes.h>
 
 #include "types.h"
+#if MAIN_POOL_TRACKING
+#include "level_table.h"
+#endif
 
 #define MEMORY_POOL_LEFT  0
 #define MEMORY_POOL_RIGHT 1
 
+#if SEGMENT_LOAD_PIPELINE
+#define SEGMENT_LOAD_RAW       0 // copied to the left of the pool
+#define SEGMENT_LOAD_MIO0      1 // decompressed to the left of the pool
+#define SEGMENT_LOAD_MIO0_HEAP 2 // decompressed into gDecompressionHeap
+#endif
+
 
 struct AllocOnlyPool
 {
@@ -19,6 +28,45 @@ struct AllocOnlyPool
 
 struct MemoryPool;
 
+#if MAIN_POOL_TRACKING
+#define MAIN_POOL_MAX_RECORDS 256
+#define MAIN_POOL_TRACKED_AREAS 8
+
+// MainPoolRecord.levelCmd for allocations made outside the level script
+#define MAIN_POOL_NO_LEVEL_CMD 0xFF
+// MainPoolRecord.segment for allocations that don't hold a segment
+#define MAIN_POOL_NO_SEGMENT 0xFF
+
+/**
+ * A block currently allocated from the main pool.
+ */
+struct MainPoolRecord {
+    u8 *block;        // start of the block, including its header
+    u32 size;         // size of the block, including its header
+    u8 side;
+    u8 segment;       // segment loaded into the block
+    u8 levelCmd;      // level script command that allocated the block
+    u8 isAllocOnlyPool;
+    const void *site; // return address of the main_pool_alloc call, where the compiler provides it
+};
+
+struct MainPoolTracking {
+    u32 size;     // usable size of the pool
+    u32 peakUsed; // highest usage seen, counting only the used part of alloc-only pools
+    u32 peakUsedPerArea[LEVEL_COUNT][MAIN_POOL_TRACKED_AREAS];
+    s32 depth;    // pool states currently pushed
+    s32 maxDepth;
+    u32 numCrossStateFrees; // frees of blocks allocated before the last pushed state
+    u32 numUnmatchedPops;   // pops with no state pushed
+    u32 numDroppedRecords;  // allocations not recorded because the table was full
+    s32 numRecords;
+    struct MainPoolRecord records[MAIN_POOL_MAX_RECORDS];
+};
+
+extern struct MainPoolTracking gMainPoolTracking;
+extern u8 gMainPoolLevelCmd;
+#endif
+
 #ifndef INCLUDED_FROM_MEMORY_C
 // Declaring this variable extern puts it in the wrong place in the bss order
 // when this file is included from memory.c (first instead of last). Hence,
@@ -46,12 +94,18 @@ void *load_to_fixed_pool_addr(u8 *destAddr, u8 *srcStart, u8 *srcEnd);
 void *load_segment_decompress(s32 segment, u8 *srcStart, u8 *srcEnd);
 void *load_segment_decompress_heap(u32 segment, u8 *srcStart, u8 *srcEnd);
 void load_engine_code_segment(void);
+#if SEGMENT_LOAD_PIPELINE
+void queue_segment_load(u32 type, s32 segment, u8 *srcStart, u8 *srcEnd);
+void flush_segment_loads(void);
+#endif
 #else
 #define load_segment(...)
 #define load_to_fixed_pool_addr(...)
 #define load_segment_decompress(...)
 #define load_segment_decompress_heap(...)
 #define load_engine_code_segment(...)
+#define queue_segment_load(...)
+#define flush_segment_loads(...)
 #endif
 
 struct AllocOnlyPool *alloc_only_pool_init(u32 size, u32 side);
@@ -65,5 +119,8 @@ void mem_pool_free(struct MemoryPool *pool, void *addr);
 void *alloc_display_list(u32 size);
 void func_80278A78(struct MarioAnimation *a, void *b, struct Animation *target);
 s32 load_patchable_table(struct MarioAnimation *a, u32 b);
+#if ANIMATION_CACHE
+s32 load_patchable_animation(struct MarioAnimation *a, u32 index);
+#endif
 
 #endif // MEMORY_H
@@ -5,7 +5,12 @@
 #include "interaction.h"
 #include "mario.h"
 #include "object_list_processor.h"
+#include "profiler.h"
 #include "spawn_object.h"
+#if OBJECT_COLLISION_GRID
+#include <PR/os_libc.h>
+#include "engine/surface_collision.h"
+#endif
 
 struct Object *debug_print_obj_collision(struct Object *a) {
     struct Object *sp24;
@@ -91,6 +96,302 @@ s32 detect_object_hurtbox_overlap(struct Object *a, struct Object *b) {
     //! no return value
 }
 
+#if OBJECT_COLLISION_GRID
+/**
+ * The collision grid is a uniform grid over the XZ plane that every tangible
+ * object is added to after clear_object_collision, covering the square around
+ * its hitbox radius. Objects whose hitboxes could overlap always share a cell,
+ * so only objects in the cells around an object need to be tested against it.
+ * Objects covering too many cells are kept in a separate list that every query
+ * includes.
+ *
+ * Each object has a key of (rank of its object list << 8) | index in the list.
+ * A query marks the keys of the objects in the cells it covers in a bitmap,
+ * then walks the bitmap in key order, so that neighbors are tested in the same
+ * order as the pairwise loops would test them and the order of each object's
+ * collidedObjs is unchanged.
+ *
+ * Mario always uses the pairwise loops. When his hitbox misses an object's,
+ * detect_object_hitbox_overlap returns no value, and if that value is nonzero
+ * detect_object_hurtbox_overlap sets INT_SUBTYPE_DELAY_INVINCIBILITY on the
+ * object. Skipping those objects through the grid could change that flag, so
+ * only objects other than Mario, for which the hurtbox test has no effect,
+ * use the grid.
+ */
+#define COLLISION_GRID_CELL_SIZE 256
+#define COLLISION_GRID_SIZE (2 * LEVEL_BOUNDARY_MAX / COLLISION_GRID_CELL_SIZE)
+#define COLLISION_GRID_MAX_CELLS_PER_OBJECT 16
+#define COLLISION_GRID_MAX_ENTRIES 1024
+// past this many objects in one cell, the pairwise loops are faster.
+#define COLLISION_GRID_MAX_CELL_DEPTH 48
+// below this many pairwise tests, building the grid costs more than it saves.
+#define COLLISION_GRID_MIN_PAIRS 2048
+
+#define COLLISION_GRID_NUM_RANKS 7
+#define COLLISION_GRID_KEYS_PER_RANK 256
+
+struct CollisionGridEntry {
+    struct CollisionGridEntry *next;
+    u16 key;
+    u16 depth; // the number of entries from this one to the end of the cell
+};
+
+static struct CollisionGridEntry *sCollisionGridCells[COLLISION_GRID_SIZE][COLLISION_GRID_SIZE];
+// the cells that have entries, so that only those need to be cleared.
+static struct CollisionGridEntry **sCollisionGridUsedCells[COLLISION_GRID_MAX_ENTRIES];
+static s32 sNumCollisionGridUsedCells;
+static struct CollisionGridEntry *sCollisionGridLargeObjects;
+static struct CollisionGridEntry sCollisionGridEntries[COLLISION_GRID_MAX_ENTRIES];
+static s32 sNumCollisionGridEntries;
+static s32 sCollisionGridValid;
+
+// the key of each object in the pool, and the object with each key.
+static u16 sCollisionGridKeys[OBJECT_POOL_CAPACITY];
+static struct Object *sCollisionGridObjects[COLLISION_GRID_NUM_RANKS * COLLISION_GRID_KEYS_PER_RANK];
+// the keys of the objects near the object being tested, one bit per key.
+static u32 sCollisionGridMarked[COLLISION_GRID_NUM_RANKS * COLLISION_GRID_KEYS_PER_RANK / 32];
+
+/**
+ * The object lists in the grid, ordered by rank. This is the order that
+ * check_player_object_collision tests them in.
+ */
+static s8 sCollisionGridLists[COLLISION_GRID_NUM_RANKS] = {
+    OBJ_LIST_PLAYER,   OBJ_LIST_POLELIKE, OBJ_LIST_LEVEL,       OBJ_LIST_GENACTOR,
+    OBJ_LIST_PUSHABLE, OBJ_LIST_SURFACE,  OBJ_LIST_DESTRUCTIVE,
+};
+
+#define COLLISION_GRID_RANK_PLAYER      (1 << 0)
+#define COLLISION_GRID_RANK_POLELIKE    (1 << 1)
+#define COLLISION_GRID_RANK_LEVEL       (1 << 2)
+#define COLLISION_GRID_RANK_GENACTOR    (1 << 3)
+#define COLLISION_GRID_RANK_PUSHABLE    (1 << 4)
+#define COLLISION_GRID_RANK_SURFACE     (1 << 5)
+#define COLLISION_GRID_RANK_DESTRUCTIVE (1 << 6)
+
+// the lists that each kind of object is tested against.
+#define COLLISION_GRID_PLAYER_TARGETS                                                               \
+    (COLLISION_GRID_RANK_PLAYER | COLLISION_GRID_RANK_POLELIKE | COLLISION_GRID_RANK_LEVEL             \
+     | COLLISION_GRID_RANK_GENACTOR | COLLISION_GRID_RANK_PUSHABLE | COLLISION_GRID_RANK_SURFACE       \
+     | COLLISION_GRID_RANK_DESTRUCTIVE)
+#define COLLISION_GRID_DESTRUCTIVE_TARGETS                                                          \
+    (COLLISION_GRID_RANK_DESTRUCTIVE | COLLISION_GRID_RANK_GENACTOR | COLLISION_GRID_RANK_PUSHABLE     \
+     | COLLISION_GRID_RANK_SURFACE)
+#define COLLISION_GRID_PUSHABLE_TARGETS COLLISION_GRID_RANK_PUSHABLE
+
+/**
+ * Return the grid cell containing the given coordinate. Coordinates outside
+ * the level boundary are clamped to the edge cells.
+ */
+static s32 collision_grid_cell(f32 coord) {
+    if (coord < -LEVEL_BOUNDARY_MAX) {
+        return 0;
+    }
+    if (coord >= LEVEL_BOUNDARY_MAX) {
+        return COLLISION_GRID_SIZE - 1;
+    }
+    return (s32)(coord + LEVEL_BOUNDARY_MAX) / COLLISION_GRID_CELL_SIZE;
+}
+
+/**
+ * Get the range of cells covered by an object's hitbox.
+ */
+static void collision_grid_get_bounds(struct Object *obj, s32 *minX, s32 *minZ, s32 *maxX, s32 *maxZ) {
+    f32 radius = obj->hitboxRadius > 0.0f ? obj->hitboxRadius : 0.0f;
+
+    *minX = collision_grid_cell(obj->oPosX - radius);
+    *minZ = collision_grid_cell(obj->oPosZ - radius);
+    *maxX = collision_grid_cell(obj->oPosX + radius);
+    *maxZ = collision_grid_cell(obj->oPosZ + radius);
+}
+
+/**
+ * Push an entry for the given key onto the front of a cell's list.
+ */
+static void push_collision_grid_entry(struct CollisionGridEntry **cell, u16 key) {
+    struct CollisionGridEntry *entry;
+
+    if (sNumCollisionGridEntries >= COLLISION_GRID_MAX_ENTRIES) {
+        sCollisionGridValid = FALSE;
+        return;
+    }
+
+    if (*cell == NULL) {
+        sCollisionGridUsedCells[sNumCollisionGridUsedCells++] = cell;
+    }
+
+    entry = &sCollisionGridEntries[sNumCollisionGridEntries++];
+    entry->key = key;
+    entry->next = *cell;
+    entry->depth = *cell != NULL ? (*cell)->depth + 1 : 1;
+    *cell = entry;
+
+    if (entry->depth > COLLISION_GRID_MAX_CELL_DEPTH) {
+        sCollisionGridValid = FALSE;
+    }
+}
+
+static s32 count_objects_in_list(s32 listIndex) {
+    struct ObjectNode *head = &gObjectLists[listIndex];
+    struct ObjectNode *node = head->next;
+    s32 count = 0;
+
+    while (node != head) {
+        count++;
+        node = node->next;
+    }
+
+    return count;
+}
+
+/**
+ * Return roughly how many pairs the pairwise loops would test this frame that
+ * the grid could skip. Mario's tests always run, so they aren't counted.
+ */
+static s32 count_pairwise_collision_tests(void) {
+    s32 numDestructive = count_objects_in_list(OBJ_LIST_DESTRUCTIVE);
+    s32 numGenActors = count_objects_in_list(OBJ_LIST_GENACTOR);
+    s32 numPushable = count_objects_in_list(OBJ_LIST_PUSHABLE);
+    s32 numSurface = count_objects_in_list(OBJ_LIST_SURFACE);
+
+    return numDestructive * (numDestructive / 2 + numGenActors + numPushable + numSurface)
+           + numPushable * numPushable / 2;
+}
+
+/**
+ * Add every tangible object in the grid's lists to the grid. If there are too
+ * few objects for the grid to pay off, an object isn't from the object pool,
+ * the grid runs out of entries, or a cell gets too crowded, the grid is marked
+ * invalid and the pairwise loops are used for this frame.
+ */
+static void build_collision_grid(void) {
+    struct Object *head;
+    struct Object *obj;
+    s32 rank;
+    s32 index;
+    s32 minX, minZ, maxX, maxZ;
+    s32 x, z;
+    u16 key;
+
+    while (sNumCollisionGridUsedCells > 0) {
+        *sCollisionGridUsedCells[--sNumCollisionGridUsedCells] = NULL;
+    }
+    sCollisionGridLargeObjects = NULL;
+    sNumCollisionGridEntries = 0;
+    sCollisionGridValid = count_pairwise_collision_tests() >= COLLISION_GRID_MIN_PAIRS;
+
+    for (rank = 0; rank < COLLISION_GRID_NUM_RANKS && sCollisionGridValid; rank++) {
+        head = (struct Object *) &gObjectLists[sCollisionGridLists[rank]];
+        obj = (struct Object *) head->header.next;
+        index = 0;
+
+        while (obj != head) {
+            if (obj < gObjectPool || obj >= gObjectPool + OBJECT_POOL_CAPACITY
+                || index >= COLLISION_GRID_KEYS_PER_RANK) {
+                sCollisionGridValid = FALSE;
+                return;
+            }
+
+            key = rank * COLLISION_GRID_KEYS_PER_RANK + index;
+            sCollisionGridKeys[obj - gObjectPool] = key;
+            sCollisionGridObjects[key] = obj;
+
+            if (obj->oIntangibleTimer == 0) {
+                collision_grid_get_bounds(obj, &minX, &minZ, &maxX, &maxZ);
+
+                if ((maxX - minX + 1) * (maxZ - minZ + 1) > COLLISION_GRID_MAX_CELLS_PER_OBJECT) {
+                    push_collision_grid_entry(&sCollisionGridLargeObjects, key);
+                } else {
+                    for (z = minZ; z <= maxZ; z++) {
+                        for (x = minX; x <= maxX; x++) {
+                            push_collision_grid_entry(&sCollisionGridCells[z][x], key);
+                        }
+                    }
+                }
+            }
+
+            obj = (struct Object *) obj->header.next;
+            index++;
+        }
+    }
+}
+
+/**
+ * Test a against every marked object with a key in [start, end), in key order.
+ */
+static void check_collision_in_grid_keys(struct Object *a, s32 start, s32 end) {
+    struct Object *b;
+    s32 key;
+
+    for (key = start; key < end; key++) {
+        // skip 32 keys at a time when none are marked.
+        if (sCollisionGridMarked[key >> 5] == 0) {
+            key |= 31;
+        } else if (sCollisionGridMarked[key >> 5] & ((u32) 1 << (key & 31))) {
+            b = sCollisionGridObjects[key];
+            if (detect_object_hitbox_overlap(a, b) && b->hurtboxRadius != 0.0f) {
+                detect_object_hurtbox_overlap(a, b);
+            }
+        }
+    }
+}
+
+/**
+ * Test a against every tangible object near it in the lists whose rank bits
+ * are set in rankMask, in the order that check_collision_in_list would: first
+ * the objects after a in its own list, then the other lists by rank. Return
+ * FALSE if the grid can't be used, in which case the caller should fall back
+ * to check_collision_in_list.
+ */
+static s32 check_collision_in_grid(struct Object *a, s32 rankMask) {
+    struct CollisionGridEntry *entry;
+    s32 minX, minZ, maxX, maxZ;
+    s32 x, z;
+    s32 rank;
+    s32 selfKey;
+    s32 selfRank;
+
+    if (!sCollisionGridValid) {
+        return FALSE;
+    }
+    if (a->oIntangibleTimer != 0) {
+        return TRUE;
+    }
+
+    collision_grid_get_bounds(a, &minX, &minZ, &maxX, &maxZ);
+    if ((maxX - minX + 1) * (maxZ - minZ + 1) > COLLISION_GRID_MAX_CELLS_PER_OBJECT) {
+        return FALSE;
+    }
+
+    bzero(sCollisionGridMarked, sizeof(sCollisionGridMarked));
+
+    for (entry = sCollisionGridLargeObjects; entry != NULL; entry = entry->next) {
+        sCollisionGridMarked[entry->key >> 5] |= (u32) 1 << (entry->key & 31);
+    }
+    for (z = minZ; z <= maxZ; z++) {
+        for (x = minX; x <= maxX; x++) {
+            for (entry = sCollisionGridCells[z][x]; entry != NULL; entry = entry->next) {
+                sCollisionGridMarked[entry->key >> 5] |= (u32) 1 << (entry->key & 31);
+            }
+        }
+    }
+
+    // a's own list comes first, starting after a, then the rest in rank order.
+    selfKey = sCollisionGridKeys[a - gObjectPool];
+    selfRank = selfKey / COLLISION_GRID_KEYS_PER_RANK;
+
+    check_collision_in_grid_keys(a, selfKey + 1, (selfRank + 1) * COLLISION_GRID_KEYS_PER_RANK);
+
+    for (rank = 0; rank < COLLISION_GRID_NUM_RANKS; rank++) {
+        if (rank != selfRank && (rankMask & (1 << rank))) {
+            check_collision_in_grid_keys(a, rank * COLLISION_GRID_KEYS_PER_RANK,
+                                         (rank + 1) * COLLISION_GRID_KEYS_PER_RANK);
+        }
+    }
+
+    return TRUE;
+}
+#endif
+
 void clear_object_collision(struct Object *a) {
     struct Object *sp4 = (struct Object *) a->header.next;
 
@@ -122,6 +423,12 @@ void check_player_object_collision(void) {
     struct Object *sp18 = (struct Object *) sp1C->header.next;
 
     while (sp18 != sp1C) {
+#if OBJECT_COLLISION_GRID
+        if (sp18 != gMarioObject && check_collision_in_grid(sp18, COLLISION_GRID_PLAYER_TARGETS)) {
+            sp18 = (struct Object *) sp18->header.next;
+            continue;
+        }
+#endif
         check_collision_in_list(sp18, (struct Object *) sp18->header.next, sp1C);
         check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_POLELIKE].next,
                       (struct Object *) &gObjectLists[OBJ_LIST_POLELIKE]);
@@ -144,6 +451,12 @@ void check_pushable_object_collision(void) {
     struct Object *sp18 = (struct Object *) sp1C->header.next;
 
     while (sp18 != sp1C) {
+#if OBJECT_COLLISION_GRID
+        if (check_collision_in_grid(sp18, COLLISION_GRID_PUSHABLE_TARGETS)) {
+            sp18 = (struct Object *) sp18->header.next;
+            continue;
+        }
+#endif
         check_collision_in_list(sp18, (struct Object *) sp18->header.next, sp1C);
         sp18 = (struct Object *) sp18->header.next;
     }
@@ -155,6 +468,12 @@ void check_destructive_object_collision(void) {
 
     while (sp18 != sp1C) {
         if (sp18->oDistanceToMario < 2000.0f && !(sp18->activeFlags & ACTIVE_FLAG_UNK9)) {
+#if OBJECT_COLLISION_GRID
+            if (check_collision_in_grid(sp18, COLLISION_GRID_DESTRUCTIVE_TARGETS)) {
+                sp18 = (struct Object *) sp18->header.next;
+                continue;
+            }
+#endif
             check_collision_in_list(sp18, (struct Object *) sp18->header.next, sp1C);
             check_collision_in_list(sp18, (struct Object *) gObjectLists[OBJ_LIST_GENACTOR].next,
                           (struct Object *) &gObjectLists[OBJ_LIST_GENACTOR]);
@@ -168,6 +487,10 @@ void check_destructive_object_collision(void) {
 }
 
 void detect_object_collisions(void) {
+#if OBJECT_PROFILER
+    OSTime start = osGetTime();
+#endif
+
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_POLELIKE]);
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_PLAYER]);
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_PUSHABLE]);
@@ -175,7 +498,25 @@ void detect_object_collisions(void) {
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_LEVEL]);
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_SURFACE]);
     clear_object_collision((struct Object *) &gObjectLists[OBJ_LIST_DESTRUCTIVE]);
+#if OBJECT_COLLISION_GRID
+    build_collision_grid();
+#endif
+#if OBJECT_PROFILER
+    object_profiler_log_collision(OBJECT_PROFILER_COLLISION_CLEAR, start);
+    start = osGetTime();
+#endif
     check_player_object_collision();
+#if OBJECT_PROFILER
+    object_profiler_log_collision(OBJECT_PROFILER_COLLISION_PLAYER, start);
+    start = osGetTime();
+#endif
     check_destructive_object_collision();
+#if OBJECT_PROFILER
+    object_profiler_log_collision(OBJECT_PROFILER_COLLISION_DESTRUCTIVE, start);
+    start = osGetTime();
+#endif
     check_pushable_object_collision();
+#if OBJECT_PROFILER
+    object_profiler_log_collision(OBJECT_PROFILER_COLLISION_PUSHABLE, start);
+#endif
 }
@@ -5,6 +5,7 @@
 #include "behavior_data.h"
 #include "camera.h"
 #include "debug.h"
+#include "engine/anim_cache.h"
 #include "engine/behavior_script.h"
 #include "engine/graph_node.h"
 #include "engine/surface_collision.h"
@@ -292,13 +293,30 @@ void bhv_mario_update(void) {
  */
 s32 update_objects_starting_at(struct ObjectNode *objList, struct ObjectNode *firstObj) {
     s32 count = 0;
+#if OBJECT_PROFILER
+    OSTime start;
+#endif
 
     while (objList != firstObj) {
         gCurrentObject = (struct Object *) firstObj;
 
+#if OBJECT_PROFILER
+        start = osGetTime();
+#endif
+
+#if OBJECT_POOL_TELEMETRY
+        if (obj_pool_parent_is_stale(gCurrentObject)) {
+            gObjectPoolStats.numStaleParents++;
+        }
+#endif
+
         gCurrentObject->header.gfx.node.flags |= GRAPH_RENDER_HAS_ANIMATION;
         cur_obj_update();
 
+#if OBJECT_PROFILER
+        object_profiler_log_behavior(gCurrentObject->behavior, start);
+#endif
+
         firstObj = firstObj->next;
         count += 1;
     }
@@ -343,8 +361,16 @@ s32 update_objects_during_time_stop(struct ObjectNode *objList, struct ObjectNod
 
         // Only update if unfrozen
         if (unfrozen) {
+#if OBJECT_PROFILER
+            OSTime start = osGetTime();
+#endif
+
             gCurrentObject->header.gfx.node.flags |= GRAPH_RENDER_HAS_ANIMATION;
             cur_obj_update();
+
+#if OBJECT_PROFILER
+            object_profiler_log_behavior(gCurrentObject->behavior, start);
+#endif
         } else {
             gCurrentObject->header.gfx.node.flags &= ~GRAPH_RENDER_HAS_ANIMATION;
         }
@@ -363,6 +389,9 @@ s32 update_objects_during_time_stop(struct ObjectNode *objList, struct ObjectNod
 s32 update_objects_in_list(struct ObjectNode *objList) {
     s32 count;
     struct ObjectNode *firstObj = objList->next;
+#if OBJECT_PROFILER
+    OSTime start = osGetTime();
+#endif
 
     if (!(gTimeStopState & TIME_STOP_ACTIVE)) {
         count = update_objects_starting_at(objList, firstObj);
@@ -370,6 +399,10 @@ s32 update_objects_in_list(struct ObjectNode *objList) {
         count = update_objects_during_time_stop(objList, firstObj);
     }
 
+#if OBJECT_PROFILER
+    object_profiler_log_list(objList - gObjectLists, start, count);
+#endif
+
     return count;
 }
 
@@ -552,6 +585,9 @@ void clear_objects(void) {
     }
 
     gObjectMemoryPool = mem_pool_init(0x800, MEMORY_POOL_LEFT);
+#if ANIMATION_CACHE
+    anim_cache_init();
+#endif
     gObjectLists = gObjectListArray;
 
     clear_dynamic_surfaces();
@@ -628,6 +664,10 @@ void update_objects(UNUSED s32 unused) {
 
     cycleCounts[0] = get_current_clock();
 
+#if OBJECT_PROFILER
+    object_profiler_begin_frame();
+#endif
+
     gTimeStopState &= ~TIME_STOP_MARIO_OPENED_DOOR;
 
     gNumRoomedObjectsInMarioRoom = 0;
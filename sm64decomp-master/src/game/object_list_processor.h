@@ -20,11 +20,6 @@
 #define TIME_STOP_ACTIVE            (1 << 6)
 
 
-/**
- * The maximum number of objects that can be loaded at once.
- */
-#define OBJECT_POOL_CAPACITY 240
-
 /**
  * Every object is categorized into an object list, which controls the order
  * they are processed and which objects they can collide with.
@@ -5,6 +5,13 @@
 #include "sm64.h"
 #include "profiler.h"
 #include "game_init.h"
+#if OBJECT_PROFILER
+#include <PR/os_libc.h>
+#include "print.h"
+#endif
+#ifdef HEADLESS
+#include "headless/headless.h"
+#endif
 
 s16 gProfilerMode = 0;
 
@@ -25,6 +32,9 @@ void profiler_log_thread5_time(enum ProfilerGameEvent eventID) {
     // event ID 4 is the last profiler event for after swapping
     // buffers: switch the Info after updating.
     if (eventID == THREAD5_END) {
+#ifdef HEADLESS
+        headless_end_frame(&gProfilerFrameData[gCurrentFrameIndex1]);
+#endif
         gCurrentFrameIndex1 ^= 1;
         gProfilerFrameData[gCurrentFrameIndex1].numSoundTimes = 0;
     }
@@ -58,6 +68,82 @@ void profiler_log_vblank_time(void) {
     }
 }
 
+#if OBJECT_PROFILER
+u32 gObjectProfilerFrameCount = 0;
+struct ObjectProfilerFrame gObjectProfilerFrames[OBJECT_PROFILER_FRAMES];
+
+static struct ObjectProfilerFrame *sObjectProfilerFrame = NULL;
+
+// start a new object profiler record, overwriting the oldest one.
+void object_profiler_begin_frame(void) {
+    sObjectProfilerFrame = &gObjectProfilerFrames[gObjectProfilerFrameCount % OBJECT_PROFILER_FRAMES];
+    gObjectProfilerFrameCount++;
+
+    bzero(sObjectProfilerFrame, sizeof(struct ObjectProfilerFrame));
+    sObjectProfilerFrame->globalTimer = gGlobalTimer;
+}
+
+// add the time since start to the given object list.
+void object_profiler_log_list(s32 listIndex, OSTime start, s32 count) {
+    if (sObjectProfilerFrame != NULL) {
+        sObjectProfilerFrame->listTimes[listIndex] += (u32)(osGetTime() - start);
+        sObjectProfilerFrame->listCounts[listIndex] += count;
+    }
+}
+
+// add the time since start to the given behavior's slot, claiming a new slot
+// if the behavior hasn't been seen yet this frame.
+void object_profiler_log_behavior(const BehaviorScript *behavior, OSTime start) {
+    struct ObjectProfilerBehavior *entry;
+    u32 time;
+    s32 i;
+    s32 slot;
+
+    if (sObjectProfilerFrame == NULL) {
+        return;
+    }
+
+    time = (u32)(osGetTime() - start);
+    slot = ((uintptr_t) behavior >> 2) & (OBJECT_PROFILER_BEHAVIORS - 1);
+
+    for (i = 0; i < OBJECT_PROFILER_BEHAVIORS; i++) {
+        entry = &sObjectProfilerFrame->behaviors[slot];
+
+        if (entry->behavior == NULL) {
+            entry->behavior = behavior;
+            sObjectProfilerFrame->numBehaviors++;
+        }
+        if (entry->behavior == behavior) {
+            entry->count++;
+            entry->time += time;
+            return;
+        }
+
+        slot = (slot + 1) & (OBJECT_PROFILER_BEHAVIORS - 1);
+    }
+
+    sObjectProfilerFrame->numDroppedObjects++;
+    sObjectProfilerFrame->otherTime += time;
+}
+
+// add the time since start to the given detect_object_collisions phase.
+void object_profiler_log_collision(enum ObjectProfilerCollisionPhase phase, OSTime start) {
+    if (sObjectProfilerFrame != NULL) {
+        sObjectProfilerFrame->collisionTimes[phase] += (u32)(osGetTime() - start);
+    }
+}
+
+// get the frame recorded age frames before the most recent one, or NULL if it
+// has been overwritten or was never recorded.
+struct ObjectProfilerFrame *object_profiler_get_frame(u32 age) {
+    if (age >= gObjectProfilerFrameCount || age >= OBJECT_PROFILER_FRAMES) {
+        return NULL;
+    }
+
+    return &gObjectProfilerFrames[(gObjectProfilerFrameCount - 1 - age) % OBJECT_PROFILER_FRAMES];
+}
+#endif
+
 // draw the specified profiler given the information passed.
 void draw_profiler_bar(OSTime clockBase, OSTime clockStart, OSTime clockEnd, s16 posY, u16 color) {
     s64 durationStart, durationEnd;
@@ -293,15 +379,92 @@ void draw_profiler_mode_0(void) {
     draw_reference_profiler_bars();
 }
 
+#if OBJECT_PROFILER
+/*
+  Draw Profiler Mode 2. This mode draws the object profiler's most recent frame:
+  one bar per object list in list order, then one per collision phase. These bars
+  are drawn at 8 times the scale of the other modes, so each reference bar is an
+  eighth of a frame. The three behaviors that took the longest are printed above,
+  as the low bits of their address followed by their time in microseconds.
+
+  Information:
+
+  (yellow): Object List Update
+  (orange): Collision Phase
+  (red): Total Object Update
+*/
+void draw_profiler_mode_2(void) {
+    struct ObjectProfilerFrame *frame = object_profiler_get_frame(0);
+    struct ObjectProfilerBehavior *top[3];
+    u32 total = 0;
+    s32 i;
+    s32 j;
+    s32 k;
+
+    if (frame == NULL) {
+        return;
+    }
+
+    for (i = 0; i < NUM_OBJ_LISTS; i++) {
+        draw_profiler_bar(0, 0, (OSTime) frame->listTimes[i] * 8, 120 + i * 6,
+                          GPACK_RGBA5551(255, 255, 40, 1));
+        total += frame->listTimes[i];
+    }
+
+    for (i = 0; i < OBJECT_PROFILER_COLLISION_COUNT; i++) {
+        draw_profiler_bar(0, 0, (OSTime) frame->collisionTimes[i] * 8, 120 + (NUM_OBJ_LISTS + i) * 6,
+                          GPACK_RGBA5551(255, 120, 40, 1));
+        total += frame->collisionTimes[i];
+    }
+
+    draw_profiler_bar(0, 0, (OSTime) total * 8, 212, GPACK_RGBA5551(255, 40, 40, 1));
+    draw_reference_profiler_bars();
+
+    // insertion sort the slowest behaviors into top.
+    top[0] = top[1] = top[2] = NULL;
+    for (i = 0; i < OBJECT_PROFILER_BEHAVIORS; i++) {
+        struct ObjectProfilerBehavior *entry = &frame->behaviors[i];
+
+        if (entry->behavior == NULL) {
+            continue;
+        }
+
+        for (j = 0; j < 3; j++) {
+            if (top[j] == NULL || entry->time > top[j]->time) {
+                for (k = 2; k > j; k--) {
+                    top[k] = top[k - 1];
+                }
+                top[j] = entry;
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < 3 && top[i] != NULL; i++) {
+        print_text_fmt_int(22, 200 - i * 18, "%06x", (uintptr_t) top[i]->behavior & 0xFFFFFF);
+        print_text_fmt_int(150, 200 - i * 18, "%d",
+                           (s32)((u64) top[i]->time * 1000000 / (osClockRate * 3 / 4)));
+    }
+}
+#endif
+
 // Draw the Profiler per frame. Toggle the mode if the player presses L while this
 // renderer is active.
 void draw_profiler(void) {
     if (gPlayer1Controller->buttonPressed & L_TRIG) {
+#if OBJECT_PROFILER
+        gProfilerMode = (gProfilerMode + 1) % 3;
+#else
         gProfilerMode ^= 1;
+#endif
     }
 
     if (gProfilerMode == 0) {
         draw_profiler_mode_0();
+#if OBJECT_PROFILER
+    } else if (gProfilerMode == 2) {
+        draw_profiler_mode_2();
+#endif
     } else {
         draw_profiler_mode_1();
     }
@@ -4,7 +4,11 @@
 #include <PR/ultratypes.h>
 #include <PR/os_time.h>
 
+#include "config.h"
 #include "types.h"
+#if OBJECT_PROFILER
+#include "object_list_processor.h"
+#endif
 
 extern u64 osClockRate;
 
@@ -48,4 +52,53 @@ void profiler_log_gfx_time(enum ProfilerGfxEvent eventID);
 void profiler_log_vblank_time(void);
 void draw_profiler(void);
 
+#if OBJECT_PROFILER
+// the number of update_objects calls kept in the object profiler's ring buffer.
+#define OBJECT_PROFILER_FRAMES 16
+// the number of distinct behaviors timed per frame. must be a power of two.
+#define OBJECT_PROFILER_BEHAVIORS 64
+
+enum ObjectProfilerCollisionPhase {
+    OBJECT_PROFILER_COLLISION_CLEAR,
+    OBJECT_PROFILER_COLLISION_PLAYER,
+    OBJECT_PROFILER_COLLISION_DESTRUCTIVE,
+    OBJECT_PROFILER_COLLISION_PUSHABLE,
+    OBJECT_PROFILER_COLLISION_COUNT
+};
+
+struct ObjectProfilerBehavior {
+    const BehaviorScript *behavior;
+    u32 count;
+    u32 time;
+};
+
+/**
+ * The times recorded during one call to update_objects, in CPU counter ticks.
+ * Behaviors are stored in an open addressed table keyed by obj->behavior;
+ * unused slots have a NULL behavior. Objects whose behavior didn't fit are
+ * added to numDroppedObjects and otherTime instead.
+ */
+struct ObjectProfilerFrame {
+    u32 globalTimer;
+    u32 listTimes[NUM_OBJ_LISTS];
+    u16 listCounts[NUM_OBJ_LISTS];
+    u32 collisionTimes[OBJECT_PROFILER_COLLISION_COUNT];
+    u16 numBehaviors;
+    u16 numDroppedObjects;
+    u32 otherTime;
+    struct ObjectProfilerBehavior behaviors[OBJECT_PROFILER_BEHAVIORS];
+};
+
+// the total number of frames recorded. the frame being recorded is
+// gObjectProfilerFrames[(gObjectProfilerFrameCount - 1) % OBJECT_PROFILER_FRAMES].
+extern u32 gObjectProfilerFrameCount;
+extern struct ObjectProfilerFrame gObjectProfilerFrames[OBJECT_PROFILER_FRAMES];
+
+void object_profiler_begin_frame(void);
+void object_profiler_log_list(s32 listIndex, OSTime start, s32 count);
+void object_profiler_log_behavior(const BehaviorScript *behavior, OSTime start);
+void object_profiler_log_collision(enum ObjectProfilerCollisionPhase phase, OSTime start);
+struct ObjectProfilerFrame *object_profiler_get_frame(u32 age);
+#endif
+
 #endif // PROFILER_H
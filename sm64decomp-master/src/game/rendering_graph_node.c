@@ -1,6 +1,9 @@
 #include <PR/ultratypes.h>
 
 #include "area.h"
+#include "buffers/buffers.h"
+#include "engine/anim_cache.h"
+#include "engine/anim_pose.h"
 #include "engine/math_util.h"
 #include "game_init.h"
 #include "gfx_dimensions.h"
@@ -52,6 +55,19 @@ struct GeoAnimState {
     /*0x04*/ f32 translationMultiplier;
     /*0x08*/ u16 *attribute;
     /*0x0C*/ s16 *data;
+#if ANIMATION_CACHE || ANIMATION_POSES
+    u16 *index;
+#endif
+#if ANIMATION_CACHE
+    s16 *frameValues;
+    s32 numChannels;
+#endif
+#if ANIMATION_POSES
+    struct Animation *anim;
+    s32 position;
+    u8 poseState;
+    struct AnimPose pose;
+#endif
 };
 
 // For some reason, this is a GeoAnimState struct, but the current state consists
@@ -64,6 +80,23 @@ s16 gCurrAnimFrame;
 f32 gCurAnimTranslationMultiplier;
 u16 *gCurrAnimAttribute;
 s16 *gCurAnimData;
+#if ANIMATION_CACHE || ANIMATION_POSES
+u16 *gCurAnimIndex;        // start of the current animation's index
+#endif
+#if ANIMATION_CACHE
+s16 *gCurAnimFrameValues;  // the current frame's row in the animation cache, or NULL
+s32 gCurAnimNumChannels;
+#endif
+#if ANIMATION_POSES
+#define POSE_NONE    0 // the current animation is read channel by channel
+#define POSE_PENDING 1 // the current pose is evaluated when first needed
+#define POSE_READY   2
+
+struct Animation *gCurAnim;
+s32 gCurAnimPosition;      // frame in 16.16 fixed point
+u8 gCurAnimPoseState;
+struct AnimPose gCurAnimPose;
+#endif
 
 struct AllocOnlyPool *gDisplayListHeap;
 
@@ -129,6 +162,154 @@ u16 gAreaUpdateCounter = 0;
 LookAt lookAt;
 #endif
 
+#if GEO_FRUSTUM_CULLING
+// The x and z components of the unit normals of the left and right planes of
+// the current perspective's frustum, and the y and z of the top and bottom.
+static f32 sFrustumSideNormal[2];
+static f32 sFrustumTopNormal[2];
+#endif
+
+#if GEO_STATIC_MATRIX_CACHE
+struct GeoMatrixStats gGeoMatrixStats;
+#endif
+
+#if MASTER_LIST_SORTING
+// The layers whose display lists can be drawn in any order, given a z-buffer.
+// Decal and translucent layers depend on the order they are drawn in.
+#define MASTER_LIST_SORTED_LAYERS                                                                  \
+    ((1 << LAYER_FORCE) | (1 << LAYER_OPAQUE) | (1 << LAYER_OPAQUE_INTER) | (1 << LAYER_ALPHA))
+
+// Display lists are read this far looking for vertices. Lists that don't load
+// any by then are kept in place like state setters, which only costs sorting.
+#define MASTER_LIST_SCAN_COMMANDS 64
+#define MASTER_LIST_SCAN_DEPTH 4
+
+struct MasterListStats gMasterListStats;
+
+/**
+ * Return whether a display list loads any vertices within its first commands,
+ * following its calls and branches. Lists that don't, such as the ones that
+ * switch the cull mode around a mesh, only set state for the lists after them.
+ */
+static s32 display_list_loads_vertices(void *displayList, s32 depth, s32 *numCommands) {
+    Gfx *cmd = segmented_to_virtual(displayList);
+    u32 opcode;
+
+    while (++*numCommands <= MASTER_LIST_SCAN_COMMANDS) {
+        opcode = (cmd->words.w0 >> 24) & 0xFF;
+
+        if (opcode == (u8) G_VTX) {
+            return TRUE;
+        } else if (opcode == (u8) G_DL) {
+            if (depth < MASTER_LIST_SCAN_DEPTH
+                && display_list_loads_vertices((void *) cmd->words.w1, depth + 1, numCommands)) {
+                return TRUE;
+            }
+            if (((cmd->words.w0 >> 16) & 0xFF) == G_DL_NOPUSH) {
+                return FALSE;
+            }
+        } else if (opcode == (u8) G_ENDDL) {
+            return FALSE;
+        }
+
+        cmd++;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Return whether a display list node sorts before another, by display list
+ * so that repeated models are drawn together, then by transform so that
+ * display lists drawn with the same matrix share its load.
+ */
+static s32 display_list_node_precedes(struct DisplayListNode *a, struct DisplayListNode *b) {
+    if (a->displayList != b->displayList) {
+        return (uintptr_t) a->displayList < (uintptr_t) b->displayList;
+    }
+    return (uintptr_t) a->transform < (uintptr_t) b->transform;
+}
+
+/**
+ * Merge sort a NULL terminated list of count display list nodes, keeping
+ * equal nodes in the order they were appended.
+ */
+static struct DisplayListNode *sort_display_list_nodes(struct DisplayListNode *head, s32 count) {
+    struct DisplayListNode *left;
+    struct DisplayListNode *right;
+    struct DisplayListNode *sorted = NULL;
+    struct DisplayListNode **tail = &sorted;
+    s32 half = count / 2;
+    s32 i;
+
+    if (count < 2) {
+        return head;
+    }
+
+    right = head;
+    for (i = 1; i < half; i++) {
+        right = right->next;
+    }
+    left = right;
+    right = right->next;
+    left->next = NULL;
+
+    left = sort_display_list_nodes(head, half);
+    right = sort_display_list_nodes(right, count - half);
+
+    while (left != NULL && right != NULL) {
+        if (display_list_node_precedes(right, left)) {
+            *tail = right;
+            right = right->next;
+        } else {
+            *tail = left;
+            left = left->next;
+        }
+        tail = &(*tail)->next;
+    }
+    *tail = left != NULL ? left : right;
+
+    return sorted;
+}
+
+/**
+ * Sort one layer of a master list. Generated display lists and ones without
+ * vertices stay where they are, and only the runs of display lists between
+ * them are sorted, since those lists may set state for the lists that follow.
+ */
+static void sort_master_list_layer(struct GraphNodeMasterList *node, s32 layer) {
+    struct DisplayListNode **link = &node->listHeads[layer];
+    struct DisplayListNode *tail = NULL;
+    struct DisplayListNode *runEnd;
+    struct DisplayListNode *next;
+    s32 count;
+
+    while (*link != NULL) {
+        if ((*link)->isBarrier) {
+            tail = *link;
+            link = &tail->next;
+            continue;
+        }
+
+        count = 1;
+        for (runEnd = *link; runEnd->next != NULL && !runEnd->next->isBarrier; runEnd = runEnd->next) {
+            count++;
+        }
+        next = runEnd->next;
+        runEnd->next = NULL;
+
+        *link = sort_display_list_nodes(*link, count);
+        while (*link != NULL) {
+            tail = *link;
+            link = &tail->next;
+        }
+        *link = next;
+    }
+
+    node->listTails[layer] = tail;
+}
+#endif
+
 /**
  * Process a master list node.
  */
@@ -138,6 +319,12 @@ static void geo_process_master_list_sub(struct GraphNodeMasterList *node) {
     s32 enableZBuffer = (node->node.flags & GRAPH_RENDER_Z_BUFFER) != 0;
     struct RenderModeContainer *modeList = &renderModeTable_1Cycle[enableZBuffer];
     struct RenderModeContainer *mode2List = &renderModeTable_2Cycle[enableZBuffer];
+#if MASTER_LIST_SORTING
+    Gfx *start = gDisplayListHead;
+    Mtx *curTransform = NULL;
+    s32 numLists = 0;
+    s32 numSkippedMatrices = 0;
+#endif
 
     // @bug This is where the LookAt values should be calculated but aren't.
     // As a result, environment mapping is broken on Fast3DEX2 without the
@@ -153,12 +340,38 @@ static void geo_process_master_list_sub(struct GraphNodeMasterList *node) {
     }
 
     for (i = 0; i < GFX_NUM_MASTER_LISTS; i++) {
+#if MASTER_LIST_SORTING
+        if (enableZBuffer != 0 && (MASTER_LIST_SORTED_LAYERS & (1 << i))) {
+            sort_master_list_layer(node, i);
+        }
+#endif
         if ((currList = node->listHeads[i]) != NULL) {
             gDPSetRenderMode(gDisplayListHead++, modeList->modes[i], mode2List->modes[i]);
             while (currList != NULL) {
+#if MASTER_LIST_SORTING
+#ifdef F3DEX_GBI_2
+                // The LookAt never changes during a frame, so it only needs loading once.
+                if (numLists == 0) {
+                    gSPLookAt(gDisplayListHead++, &lookAt);
+                }
+#endif
+                if (currList->transform != curTransform) {
+                    gSPMatrix(gDisplayListHead++, VIRTUAL_TO_PHYSICAL(currList->transform),
+                              G_MTX_MODELVIEW | G_MTX_LOAD | G_MTX_NOPUSH);
+                    curTransform = currList->transform;
+                } else {
+                    numSkippedMatrices++;
+                }
+                gSPDisplayList(gDisplayListHead++, currList->displayList);
+                if (currList->isGenerated) {
+                    curTransform = NULL;
+                }
+                numLists++;
+#else
                 gSPMatrix(gDisplayListHead++, VIRTUAL_TO_PHYSICAL(currList->transform),
                           G_MTX_MODELVIEW | G_MTX_LOAD | G_MTX_NOPUSH);
                 gSPDisplayList(gDisplayListHead++, currList->displayList);
+#endif
                 currList = currList->next;
             }
         }
@@ -167,6 +380,17 @@ static void geo_process_master_list_sub(struct GraphNodeMasterList *node) {
         gDPPipeSync(gDisplayListHead++);
         gSPClearGeometryMode(gDisplayListHead++, G_ZBUFFER);
     }
+#if MASTER_LIST_SORTING
+    gMasterListStats.numCommands += gDisplayListHead - start;
+    gMasterListStats.numUnsortedCommands += gDisplayListHead - start + numSkippedMatrices;
+#ifdef F3DEX_GBI_2
+    // Unsorted, every appended display list also loads the LookAt, which takes
+    // two commands.
+    if (numLists > 0) {
+        gMasterListStats.numUnsortedCommands += 2 * (numLists - 1);
+    }
+#endif
+#endif
 }
 
 /**
@@ -175,8 +399,11 @@ static void geo_process_master_list_sub(struct GraphNodeMasterList *node) {
  * render modes of layers.
  */
 static void geo_append_display_list(void *displayList, s16 layer) {
+#if MASTER_LIST_SORTING
+    s32 numCommands = 0;
+#endif
 
-#ifdef F3DEX_GBI_2
+#if defined(F3DEX_GBI_2) && !MASTER_LIST_SORTING
     gSPLookAt(gDisplayListHead++, &lookAt);
 #endif
     if (gCurGraphNodeMasterList != 0) {
@@ -186,6 +413,12 @@ static void geo_append_display_list(void *displayList, s16 layer) {
         listNode->transform = gMatStackFixed[gMatStackIndex];
         listNode->displayList = displayList;
         listNode->next = 0;
+#if MASTER_LIST_SORTING
+        // Only the sorted layers need to know which lists set state.
+        listNode->isGenerated = FALSE;
+        listNode->isBarrier = !(MASTER_LIST_SORTED_LAYERS & (1 << layer))
+                              || !display_list_loads_vertices(displayList, 0, &numCommands);
+#endif
         if (gCurGraphNodeMasterList->listHeads[layer] == 0) {
             gCurGraphNodeMasterList->listHeads[layer] = listNode;
         } else {
@@ -195,6 +428,18 @@ static void geo_append_display_list(void *displayList, s16 layer) {
     }
 }
 
+#if MASTER_LIST_SORTING
+/**
+ * Mark the display list just appended to a layer as made by a geo function.
+ */
+static void mark_last_display_list_generated(s16 layer) {
+    if (gCurGraphNodeMasterList != NULL) {
+        gCurGraphNodeMasterList->listTails[layer]->isGenerated = TRUE;
+        gCurGraphNodeMasterList->listTails[layer]->isBarrier = TRUE;
+    }
+}
+#endif
+
 /**
  * Process the master list node.
  */
@@ -232,6 +477,88 @@ static void geo_process_ortho_projection(struct GraphNodeOrthoProjection *node)
     }
 }
 
+#if GEO_FRUSTUM_CULLING
+/**
+ * Find the side planes of the frustum of a perspective with the given vertical
+ * fov and aspect ratio. A degree is added to the fov for some leeway, as
+ * obj_is_in_view does.
+ */
+static void set_frustum_planes(f32 fov, f32 aspect) {
+    s16 halfFov = (fov / 2.0f + 1.0f) * 32768.0f / 180.0f + 0.5f;
+    f32 tanY = sins(halfFov) / coss(halfFov);
+    f32 tanX = tanY * aspect;
+
+    sFrustumTopNormal[0] = 1.0f / sqrtf(1.0f + tanY * tanY);
+    sFrustumTopNormal[1] = tanY * sFrustumTopNormal[0];
+    sFrustumSideNormal[0] = 1.0f / sqrtf(1.0f + tanX * tanX);
+    sFrustumSideNormal[1] = tanX * sFrustumSideNormal[0];
+}
+
+/**
+ * Return whether a static subtree's bounding sphere, in the space of the top
+ * of the matrix stack, is at least partly inside the camera's frustum. The
+ * six planes are tested in view space, after the screen roll.
+ */
+static s32 bounds_are_in_view(struct GraphNodeBounds *bounds) {
+    Mat4 *mtx = &gMatStack[gMatStackIndex];
+    f32 x;
+    f32 y;
+    f32 depth;
+    f32 radius;
+    f32 scale;
+    f32 rowScale;
+    s32 i;
+
+    if (gCurGraphNodeCamera == NULL || gCurGraphNodeCamFrustum == NULL) {
+        return TRUE;
+    }
+
+    x = (*mtx)[3][0];
+    y = (*mtx)[3][1];
+    depth = -(*mtx)[3][2];
+    scale = 0.0f;
+    for (i = 0; i < 3; i++) {
+        x += bounds->center[i] * (*mtx)[i][0];
+        y += bounds->center[i] * (*mtx)[i][1];
+        depth -= bounds->center[i] * (*mtx)[i][2];
+
+        rowScale = (*mtx)[i][0] * (*mtx)[i][0] + (*mtx)[i][1] * (*mtx)[i][1] + (*mtx)[i][2] * (*mtx)[i][2];
+        if (rowScale > scale) {
+            scale = rowScale;
+        }
+    }
+    radius = bounds->radius * sqrtf(scale);
+
+    if (gCurGraphNodeCamera->rollScreen != 0) {
+        f32 sr = sins(gCurGraphNodeCamera->rollScreen);
+        f32 cr = coss(gCurGraphNodeCamera->rollScreen);
+        f32 rolledX = x * cr - y * sr;
+
+        y = x * sr + y * cr;
+        x = rolledX;
+    }
+
+    if (depth < gCurGraphNodeCamFrustum->near - radius || depth > gCurGraphNodeCamFrustum->far + radius) {
+        return FALSE;
+    }
+
+    // The frustum is symmetric, so only the planes on the sphere's side need testing.
+    if (x < 0.0f) {
+        x = -x;
+    }
+    if (y < 0.0f) {
+        y = -y;
+    }
+    if (x * sFrustumSideNormal[0] - depth * sFrustumSideNormal[1] > radius) {
+        return FALSE;
+    }
+    if (y * sFrustumTopNormal[0] - depth * sFrustumTopNormal[1] > radius) {
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif
+
 /**
  * Process a perspective projection node.
  */
@@ -251,6 +578,9 @@ static void geo_process_perspective(struct GraphNodePerspective *node) {
 
         guPerspective(mtx, &perspNorm, node->fov, aspect, node->near, node->far, 1.0f);
         gSPPerspNormalize(gDisplayListHead++, perspNorm);
+#if GEO_FRUSTUM_CULLING
+        set_frustum_planes(node->fov, aspect);
+#endif
 
         gSPMatrix(gDisplayListHead++, VIRTUAL_TO_PHYSICAL(mtx), G_MTX_PROJECTION | G_MTX_LOAD | G_MTX_NOPUSH);
 
@@ -431,6 +761,68 @@ static void geo_process_scale(struct GraphNodeScale *node) {
     gMatStackIndex--;
 }
 
+#if GEO_STATIC_MATRIX_CACHE
+/**
+ * Process a translation, rotation or scale node that was marked static when
+ * its area loaded. Its matrix is only rebuilt when the matrix of the node
+ * above it has changed, which for level geometry means when the camera has
+ * moved. The fixed point matrix for this frame's gfx pool is likewise only
+ * converted again when it is older than the float matrix.
+ */
+static void geo_process_static_transform(struct GraphNode *node) {
+    struct GraphNodeMatrixCache *cache = node->matrixCache;
+    s32 poolIndex = gGfxPool - gGfxPools;
+    f32 *parent = (f32 *) gMatStack[gMatStackIndex];
+    f32 *cachedParent = (f32 *) cache->parent;
+    void *displayList = NULL;
+    s32 i;
+
+    for (i = 0; i < 16; i++) {
+        if (parent[i] != cachedParent[i]) {
+            break;
+        }
+    }
+    if (i != 16 || cache->version == 0) {
+        mtxf_copy(cache->parent, gMatStack[gMatStackIndex]);
+        mtxf_mul(cache->matrix, cache->local, gMatStack[gMatStackIndex]);
+        cache->version++;
+    }
+
+    gMatStackIndex++;
+    mtxf_copy(gMatStack[gMatStackIndex], cache->matrix);
+    if (cache->mtxVersions[poolIndex] != cache->version) {
+        mtxf_to_mtx(&cache->mtx[poolIndex], cache->matrix);
+        cache->mtxVersions[poolIndex] = cache->version;
+        gGeoMatrixStats.numBuilt++;
+    } else {
+        gGeoMatrixStats.numReused++;
+    }
+    gMatStackFixed[gMatStackIndex] = &cache->mtx[poolIndex];
+
+    switch (node->type) {
+        case GRAPH_NODE_TYPE_TRANSLATION_ROTATION:
+            displayList = ((struct GraphNodeTranslationRotation *) node)->displayList;
+            break;
+        case GRAPH_NODE_TYPE_TRANSLATION:
+            displayList = ((struct GraphNodeTranslation *) node)->displayList;
+            break;
+        case GRAPH_NODE_TYPE_ROTATION:
+            displayList = ((struct GraphNodeRotation *) node)->displayList;
+            break;
+        case GRAPH_NODE_TYPE_SCALE:
+            displayList = ((struct GraphNodeScale *) node)->displayList;
+            break;
+    }
+    if (displayList != NULL) {
+        geo_append_display_list(displayList, node->flags >> 8);
+    }
+    if (node->children != NULL) {
+        geo_process_node_and_siblings(node->children);
+    }
+    gMatStackIndex--;
+}
+#endif
+
 /**
  * Process a billboard node. A transformation matrix is created that makes its
  * children face the camera, and it is pushed on the floating point and fixed
@@ -489,6 +881,9 @@ static void geo_process_generated_list(struct GraphNodeGenerated *node) {
 
         if (list != NULL) {
             geo_append_display_list((void *) VIRTUAL_TO_PHYSICAL(list), node->fnNode.node.flags >> 8);
+#if MASTER_LIST_SORTING
+            mark_last_display_list_generated(node->fnNode.node.flags >> 8);
+#endif
         }
     }
     if (node->fnNode.node.children != NULL) {
@@ -510,6 +905,9 @@ static void geo_process_background(struct GraphNodeBackground *node) {
     }
     if (list != NULL) {
         geo_append_display_list((void *) VIRTUAL_TO_PHYSICAL(list), node->fnNode.node.flags >> 8);
+#if MASTER_LIST_SORTING
+        mark_last_display_list_generated(node->fnNode.node.flags >> 8);
+#endif
     } else if (gCurGraphNodeMasterList != NULL) {
 #ifndef F3DEX_GBI_2E
         Gfx *gfxStart = alloc_display_list(sizeof(Gfx) * 7);
@@ -534,6 +932,86 @@ static void geo_process_background(struct GraphNodeBackground *node) {
     }
 }
 
+#if ANIMATION_POSES
+/**
+ * Return the current object's pose, evaluating it the first time it's needed,
+ * or NULL if the animation has to be read channel by channel.
+ */
+static struct AnimPose *geo_get_current_pose(void) {
+    struct AnimPose *pose;
+
+    if (gCurAnimPoseState == POSE_PENDING) {
+        pose = anim_pose_get(gCurAnim, gCurAnimPosition);
+        if (pose != NULL) {
+            gCurAnimPose = *pose;
+            gCurAnimPoseState = POSE_READY;
+        } else {
+            gCurAnimPoseState = POSE_NONE;
+        }
+    }
+    return gCurAnimPoseState == POSE_READY ? &gCurAnimPose : NULL;
+}
+
+/**
+ * Build the matrix of the next animated part from the current pose, with
+ * 'translation' in its last row. Return FALSE if the part has no pose matrix,
+ * in which case it is read channel by channel.
+ */
+static s32 geo_get_posed_part_matrix(Mat4 matrix, Vec3f translation) {
+    struct AnimPose *pose;
+    s32 channel;
+    s32 part;
+
+    if (gCurAnimType != ANIM_TYPE_ROTATION || (pose = geo_get_current_pose()) == NULL) {
+        return FALSE;
+    }
+
+    channel = (gCurrAnimAttribute - gCurAnimIndex) / 2 - 3;
+    part = channel / 3;
+    if (channel < 0 || channel % 3 != 0 || part >= pose->numParts) {
+        return FALSE;
+    }
+
+    mtxf_copy(matrix, pose->partMatrices[part]);
+    matrix[3][0] = translation[0];
+    matrix[3][1] = translation[1];
+    matrix[3][2] = translation[2];
+    gCurrAnimAttribute += 6;
+    return TRUE;
+}
+#endif
+
+#if ANIMATION_CACHE || ANIMATION_POSES
+/**
+ * Read the value of the next animation channel. The root translation comes
+ * from the current pose when there is one, and channels are otherwise taken
+ * from the current frame's row in the animation cache when it has one, which
+ * spares decoding the index.
+ */
+static f32 geo_next_animation_value(void) {
+    s32 channel = (gCurrAnimAttribute - gCurAnimIndex) / 2;
+#if ANIMATION_POSES
+    struct AnimPose *pose = geo_get_current_pose();
+
+    if (pose != NULL && channel < 3) {
+        gCurrAnimAttribute += 2;
+        return pose->translation[channel];
+    }
+#endif
+#if ANIMATION_CACHE
+    if (gCurAnimFrameValues != NULL && channel < gCurAnimNumChannels) {
+        gCurrAnimAttribute += 2;
+        return gCurAnimFrameValues[channel];
+    }
+#endif
+    return gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
+}
+
+#define NEXT_ANIMATION_VALUE() geo_next_animation_value()
+#else
+#define NEXT_ANIMATION_VALUE() gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)]
+#endif
+
 /**
  * Render an animated part. The current animation state is not part of the node
  * but set in global variables. If an animated part is skipped, everything afterwards desyncs.
@@ -547,29 +1025,20 @@ static void geo_process_animated_part(struct GraphNodeAnimatedPart *node) {
     vec3s_copy(rotation, gVec3sZero);
     vec3f_set(translation, node->translation[0], node->translation[1], node->translation[2]);
     if (gCurAnimType == ANIM_TYPE_TRANSLATION) {
-        translation[0] += gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)]
-                          * gCurAnimTranslationMultiplier;
-        translation[1] += gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)]
-                          * gCurAnimTranslationMultiplier;
-        translation[2] += gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)]
-                          * gCurAnimTranslationMultiplier;
+        translation[0] += NEXT_ANIMATION_VALUE() * gCurAnimTranslationMultiplier;
+        translation[1] += NEXT_ANIMATION_VALUE() * gCurAnimTranslationMultiplier;
+        translation[2] += NEXT_ANIMATION_VALUE() * gCurAnimTranslationMultiplier;
         gCurAnimType = ANIM_TYPE_ROTATION;
     } else {
         if (gCurAnimType == ANIM_TYPE_LATERAL_TRANSLATION) {
-            translation[0] +=
-                gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)]
-                * gCurAnimTranslationMultiplier;
+            translation[0] += NEXT_ANIMATION_VALUE() * gCurAnimTranslationMultiplier;
             gCurrAnimAttribute += 2;
-            translation[2] +=
-                gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)]
-                * gCurAnimTranslationMultiplier;
+            translation[2] += NEXT_ANIMATION_VALUE() * gCurAnimTranslationMultiplier;
             gCurAnimType = ANIM_TYPE_ROTATION;
         } else {
             if (gCurAnimType == ANIM_TYPE_VERTICAL_TRANSLATION) {
                 gCurrAnimAttribute += 2;
-                translation[1] +=
-                    gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)]
-                    * gCurAnimTranslationMultiplier;
+                translation[1] += NEXT_ANIMATION_VALUE() * gCurAnimTranslationMultiplier;
                 gCurrAnimAttribute += 2;
                 gCurAnimType = ANIM_TYPE_ROTATION;
             } else if (gCurAnimType == ANIM_TYPE_NO_TRANSLATION) {
@@ -579,12 +1048,18 @@ static void geo_process_animated_part(struct GraphNodeAnimatedPart *node) {
         }
     }
 
+#if ANIMATION_POSES
+    if (!geo_get_posed_part_matrix(matrix, translation)) {
+#endif
     if (gCurAnimType == ANIM_TYPE_ROTATION) {
-        rotation[0] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
-        rotation[1] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
-        rotation[2] = gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)];
+        rotation[0] = NEXT_ANIMATION_VALUE();
+        rotation[1] = NEXT_ANIMATION_VALUE();
+        rotation[2] = NEXT_ANIMATION_VALUE();
     }
     mtxf_rotate_xyz_and_translate(matrix, translation, rotation);
+#if ANIMATION_POSES
+    }
+#endif
     mtxf_mul(gMatStack[gMatStackIndex + 1], matrix, gMatStack[gMatStackIndex]);
     gMatStackIndex++;
     mtxf_to_mtx(matrixPtr, gMatStack[gMatStackIndex]);
@@ -623,6 +1098,23 @@ void geo_set_animation_globals(struct AnimInfo *node, s32 hasAnimation) {
     gCurAnimEnabled = (anim->flags & ANIM_FLAG_5) == 0;
     gCurrAnimAttribute = segmented_to_virtual((void *) anim->index);
     gCurAnimData = segmented_to_virtual((void *) anim->values);
+#if ANIMATION_CACHE || ANIMATION_POSES
+    gCurAnimIndex = gCurrAnimAttribute;
+#endif
+#if ANIMATION_CACHE
+    gCurAnimFrameValues = anim_cache_get_frame(anim, gCurrAnimFrame, &gCurAnimNumChannels);
+#endif
+#if ANIMATION_POSES
+    // Accelerated animations keep the fraction of their frame, which poses
+    // may blend by
+    gCurAnim = anim;
+    gCurAnimPoseState = POSE_PENDING;
+    if (node->animAccel != 0 && (node->animFrameAccelAssist >> 16) == node->animFrame) {
+        gCurAnimPosition = node->animFrameAccelAssist;
+    } else {
+        gCurAnimPosition = node->animFrame << 16;
+    }
+#endif
 
     if (anim->animYTransDivisor == 0) {
         gCurAnimTranslationMultiplier = 1.0f;
@@ -666,14 +1158,10 @@ static void geo_process_shadow(struct GraphNodeShadow *node) {
                 if (geo != NULL && geo->type == GRAPH_NODE_TYPE_SCALE) {
                     objScale = ((struct GraphNodeScale *) geo)->scale;
                 }
-                animOffset[0] =
-                    gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)]
-                    * gCurAnimTranslationMultiplier * objScale;
+                animOffset[0] = NEXT_ANIMATION_VALUE() * gCurAnimTranslationMultiplier * objScale;
                 animOffset[1] = 0.0f;
                 gCurrAnimAttribute += 2;
-                animOffset[2] =
-                    gCurAnimData[retrieve_animation_index(gCurrAnimFrame, &gCurrAnimAttribute)]
-                    * gCurAnimTranslationMultiplier * objScale;
+                animOffset[2] = NEXT_ANIMATION_VALUE() * gCurAnimTranslationMultiplier * objScale;
                 gCurrAnimAttribute -= 6;
 
                 // simple matrix rotation so the shadow offset rotates along with the object
@@ -910,6 +1398,19 @@ void geo_process_held_object(struct GraphNodeHeldObject *node) {
         gGeoTempState.translationMultiplier = gCurAnimTranslationMultiplier;
         gGeoTempState.attribute = gCurrAnimAttribute;
         gGeoTempState.data = gCurAnimData;
+#if ANIMATION_CACHE || ANIMATION_POSES
+        gGeoTempState.index = gCurAnimIndex;
+#endif
+#if ANIMATION_CACHE
+        gGeoTempState.frameValues = gCurAnimFrameValues;
+        gGeoTempState.numChannels = gCurAnimNumChannels;
+#endif
+#if ANIMATION_POSES
+        gGeoTempState.anim = gCurAnim;
+        gGeoTempState.position = gCurAnimPosition;
+        gGeoTempState.poseState = gCurAnimPoseState;
+        gGeoTempState.pose = gCurAnimPose;
+#endif
         gCurAnimType = 0;
         gCurGraphNodeHeldObject = (void *) node;
         if (node->objNode->header.gfx.animInfo.curAnim != NULL) {
@@ -924,6 +1425,19 @@ void geo_process_held_object(struct GraphNodeHeldObject *node) {
         gCurAnimTranslationMultiplier = gGeoTempState.translationMultiplier;
         gCurrAnimAttribute = gGeoTempState.attribute;
         gCurAnimData = gGeoTempState.data;
+#if ANIMATION_CACHE || ANIMATION_POSES
+        gCurAnimIndex = gGeoTempState.index;
+#endif
+#if ANIMATION_CACHE
+        gCurAnimFrameValues = gGeoTempState.frameValues;
+        gCurAnimNumChannels = gGeoTempState.numChannels;
+#endif
+#if ANIMATION_POSES
+        gCurAnim = gGeoTempState.anim;
+        gCurAnimPosition = gGeoTempState.position;
+        gCurAnimPoseState = gGeoTempState.poseState;
+        gCurAnimPose = gGeoTempState.pose;
+#endif
         gMatStackIndex--;
     }
 
@@ -958,9 +1472,19 @@ void geo_process_node_and_siblings(struct GraphNode *firstNode) {
     }
 
     do {
+#if GEO_FRUSTUM_CULLING
+        // Skip static level geometry that is entirely out of view.
+        if (curGraphNode->bounds != NULL && !bounds_are_in_view(curGraphNode->bounds)) {
+            continue;
+        }
+#endif
         if (curGraphNode->flags & GRAPH_RENDER_ACTIVE) {
             if (curGraphNode->flags & GRAPH_RENDER_CHILDREN_FIRST) {
                 geo_try_process_children(curGraphNode);
+#if GEO_STATIC_MATRIX_CACHE
+            } else if (curGraphNode->flags & GRAPH_RENDER_STATIC) {
+                geo_process_static_transform(curGraphNode);
+#endif
             } else {
                 switch (curGraphNode->type) {
                     case GRAPH_NODE_TYPE_ORTHO_PROJECTION:
@@ -1051,6 +1575,17 @@ void geo_process_root(struct GraphNodeRoot *node, Vp *b, Vp *c, s32 clearColor)
         initialMatrix = alloc_display_list(sizeof(*initialMatrix));
         gMatStackIndex = 0;
         gCurAnimType = 0;
+#if MASTER_LIST_SORTING
+        gMasterListStats.numCommands = 0;
+        gMasterListStats.numUnsortedCommands = 0;
+#endif
+#if ANIMATION_POSES
+        anim_pose_reset();
+#endif
+#if GEO_STATIC_MATRIX_CACHE
+        gGeoMatrixStats.numBuilt = 0;
+        gGeoMatrixStats.numReused = 0;
+#endif
         vec3s_set(viewport->vp.vtrans, node->x * 4, node->y * 4, 511);
         vec3s_set(viewport->vp.vscale, node->width * 4, node->height * 4, 511);
         if (b != NULL) {
@@ -1078,6 +1613,9 @@ void geo_process_root(struct GraphNodeRoot *node, Vp *b, Vp *c, s32 clearColor)
         if (gShowDebugText) {
             print_text_fmt_int(180, 36, "MEM %d",
                                gDisplayListHeap->totalSpace - gDisplayListHeap->usedSpace);
+#if MASTER_LIST_SORTING
+            print_text_fmt_int(180, 52, "GFX %d", gMasterListStats.numCommands);
+#endif
         }
         main_pool_free(gDisplayListHeap);
     }
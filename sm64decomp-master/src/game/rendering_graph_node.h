@@ -27,6 +27,24 @@ extern u16 gAreaUpdateCounter;
 // translation types the type is set to this
 #define ANIM_TYPE_ROTATION              5
 
+#if MASTER_LIST_SORTING
+struct MasterListStats {
+    u32 numCommands;         // commands emitted to draw the master lists this frame
+    u32 numUnsortedCommands; // commands that would have been emitted without sorting
+};
+
+extern struct MasterListStats gMasterListStats;
+#endif
+
+#if GEO_STATIC_MATRIX_CACHE
+struct GeoMatrixStats {
+    u32 numBuilt;  // matrices of static nodes rebuilt this frame
+    u32 numReused; // matrices of static nodes reused from an earlier frame
+};
+
+extern struct GeoMatrixStats gGeoMatrixStats;
+#endif
+
 void geo_process_node_and_siblings(struct GraphNode *firstNode);
 void geo_process_root(struct GraphNodeRoot *node, Vp *b, Vp *c, s32 clearColor);
 
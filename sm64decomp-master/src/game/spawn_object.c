@@ -13,6 +13,22 @@
 #include "spawn_object.h"
 #include "types.h"
 
+#if OBJECT_POOL_TELEMETRY
+// sObjectBehaviorStats value for a slot with no loaded object
+#define OBJECT_SLOT_FREE -2
+
+#define OBJECT_SLOT(obj) ((struct Object *) (obj) - gObjectPool)
+
+struct ObjectPoolStats gObjectPoolStats;
+
+// Bumped whenever the object in a slot is unloaded, which invalidates its handles
+static u16 sObjectGenerations[OBJECT_POOL_CAPACITY];
+// The parent each object was spawned by
+static ObjectHandle sObjectParents[OBJECT_POOL_CAPACITY];
+// Each object's entry in gObjectPoolStats.behaviors, -1 if it has none
+static s16 sObjectBehaviorStats[OBJECT_POOL_CAPACITY];
+#endif
+
 /**
  * An unused linked list struct that seems to have been replaced by ObjectNode.
  */
@@ -126,6 +142,143 @@ static void deallocate_object(struct ObjectNode *freeList, struct ObjectNode *ob
     freeList->next = obj;
 }
 
+#if OBJECT_POOL_TELEMETRY
+/**
+ * Return the handle of an object in the pool, or 0 for any other object, such
+ * as the default parent of macro objects.
+ */
+ObjectHandle obj_to_handle(struct Object *obj) {
+    s32 slot;
+
+    if (obj < gObjectPool || obj >= gObjectPool + OBJECT_POOL_CAPACITY) {
+        return 0;
+    }
+
+    slot = OBJECT_SLOT(obj);
+    return ((slot + 1) << 16) | sObjectGenerations[slot];
+}
+
+/**
+ * Return the object a handle refers to, or NULL if it has been unloaded since
+ * the handle was made.
+ */
+struct Object *obj_from_handle(ObjectHandle handle) {
+    s32 slot = (s32)(handle >> 16) - 1;
+
+    if (slot < 0 || slot >= OBJECT_POOL_CAPACITY || (handle & 0xFFFF) != sObjectGenerations[slot]) {
+        return NULL;
+    }
+    return &gObjectPool[slot];
+}
+
+/**
+ * Remember the parent an object was spawned by.
+ */
+void obj_pool_set_parent(struct Object *obj, struct Object *parent) {
+    sObjectParents[OBJECT_SLOT(obj)] = obj_to_handle(parent);
+}
+
+/**
+ * Return whether the object's parent has been unloaded while parentObj still
+ * points at its slot. Objects whose parentObj was changed after spawning
+ * aren't checked.
+ */
+s32 obj_pool_parent_is_stale(struct Object *obj) {
+    ObjectHandle parent = sObjectParents[OBJECT_SLOT(obj)];
+
+    if (parent == 0 || obj->parentObj != &gObjectPool[(parent >> 16) - 1]) {
+        return FALSE;
+    }
+    return obj_from_handle(parent) == NULL;
+}
+
+/**
+ * Find the stats entry for a behavior, adding it if it's new. Return -1 if the
+ * table is full.
+ */
+static s32 obj_pool_find_behavior_stats(const BehaviorScript *behavior) {
+    s32 index = ((uintptr_t) behavior >> 2) % OBJECT_POOL_NUM_BEHAVIORS;
+    struct ObjectPoolBehaviorStats *entry;
+    s32 i;
+
+    for (i = 0; i < OBJECT_POOL_NUM_BEHAVIORS; i++) {
+        entry = &gObjectPoolStats.behaviors[index];
+        if (entry->behavior == behavior) {
+            return index;
+        }
+        if (entry->behavior == NULL) {
+            entry->behavior = behavior;
+            return index;
+        }
+        index = (index + 1) % OBJECT_POOL_NUM_BEHAVIORS;
+    }
+    return -1;
+}
+
+/**
+ * Count a newly spawned object against the pool and its behavior.
+ */
+static void obj_pool_track_spawn(struct Object *obj) {
+    s32 index = obj_pool_find_behavior_stats(obj->behavior);
+    struct ObjectPoolBehaviorStats *entry;
+
+    gObjectPoolStats.numSpawned++;
+    if (++gObjectPoolStats.numLive > gObjectPoolStats.highWater) {
+        gObjectPoolStats.highWater = gObjectPoolStats.numLive;
+    }
+
+    sObjectBehaviorStats[OBJECT_SLOT(obj)] = index;
+    if (index < 0) {
+        gObjectPoolStats.numUntrackedSpawns++;
+        return;
+    }
+
+    entry = &gObjectPoolStats.behaviors[index];
+    entry->numSpawned++;
+    if (++entry->numLive > entry->highWater) {
+        entry->highWater = entry->numLive;
+    }
+}
+
+/**
+ * Release an unloaded object's slot, invalidating its handles.
+ */
+static void obj_pool_track_unload(struct Object *obj) {
+    s32 slot = OBJECT_SLOT(obj);
+    s32 index = sObjectBehaviorStats[slot];
+
+    if (index == OBJECT_SLOT_FREE) {
+        return;
+    }
+
+    sObjectGenerations[slot]++;
+    sObjectParents[slot] = 0;
+    sObjectBehaviorStats[slot] = OBJECT_SLOT_FREE;
+    gObjectPoolStats.numLive--;
+    if (index >= 0) {
+        gObjectPoolStats.behaviors[index].numLive--;
+    }
+}
+
+/**
+ * Release every slot when the object pool is cleared. Spawn counts and high
+ * water marks are kept.
+ */
+static void obj_pool_reset_slots(void) {
+    s32 i;
+
+    for (i = 0; i < OBJECT_POOL_CAPACITY; i++) {
+        sObjectGenerations[i]++;
+        sObjectParents[i] = 0;
+        sObjectBehaviorStats[i] = OBJECT_SLOT_FREE;
+    }
+    for (i = 0; i < OBJECT_POOL_NUM_BEHAVIORS; i++) {
+        gObjectPoolStats.behaviors[i].numLive = 0;
+    }
+    gObjectPoolStats.numLive = 0;
+}
+#endif
+
 /**
  * Add every object in the pool to the free object list.
  */
@@ -145,6 +298,10 @@ void init_free_object_list(void) {
 
     // End the list
     obj->header.next = NULL;
+
+#if OBJECT_POOL_TELEMETRY
+    obj_pool_reset_slots();
+#endif
 }
 
 /**
@@ -198,6 +355,9 @@ void unload_object(struct Object *obj) {
     obj->header.gfx.node.flags &= ~GRAPH_RENDER_ACTIVE;
 
     deallocate_object(&gFreeObjectList, &obj->header);
+#if OBJECT_POOL_TELEMETRY
+    obj_pool_track_unload(obj);
+#endif
 }
 
 /**
@@ -206,7 +366,9 @@ void unload_object(struct Object *obj) {
  * infinite loop.
  */
 struct Object *allocate_object(struct ObjectNode *objList) {
+#if !OBJECT_POOL_TELEMETRY
     s32 i;
+#endif
     struct Object *obj = try_allocate_object(objList, &gFreeObjectList);
 
     // The object list is full if the newly created pointer is NULL.
@@ -224,6 +386,9 @@ struct Object *allocate_object(struct ObjectNode *objList) {
         } else {
             // If an unimportant object does exist, unload it and take its slot.
             unload_object(unimportantObj);
+#if OBJECT_POOL_TELEMETRY
+            gObjectPoolStats.numEvicted++;
+#endif
             obj = try_allocate_object(objList, &gFreeObjectList);
             if (gCurrentObject == obj) {
                 //! Uh oh, the unimportant object was in the middle of
@@ -242,7 +407,12 @@ struct Object *allocate_object(struct ObjectNode *objList) {
     obj->collidedObjInteractTypes = 0;
     obj->numCollidedObjs = 0;
 
+#if OBJECT_POOL_TELEMETRY
+    bzero(&obj->rawData, sizeof(obj->rawData));
 #if IS_64_BIT
+    bzero(&obj->ptrData, sizeof(obj->ptrData));
+#endif
+#elif IS_64_BIT
     for (i = 0; i < 0x50; i++) {
         obj->rawData.asS32[i] = 0;
         obj->ptrData.asVoidPtr[i] = NULL;
@@ -329,6 +499,9 @@ struct Object *create_object(const BehaviorScript *bhvScript) {
 
     obj->curBhvCommand = bhvScript;
     obj->behavior = behavior;
+#if OBJECT_POOL_TELEMETRY
+    obj_pool_track_spawn(obj);
+#endif
 
     if (objListIndex == OBJ_LIST_UNIMPORTANT) {
         obj->activeFlags |= ACTIVE_FLAG_UNIMPORTANT;
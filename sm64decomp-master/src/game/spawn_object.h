@@ -3,10 +3,48 @@
 
 #include "types.h"
 
+#if OBJECT_POOL_TELEMETRY
+// Behaviors whose live objects are counted separately
+#define OBJECT_POOL_NUM_BEHAVIORS 128
+
+/**
+ * A reference to an object that stops resolving once the object is unloaded.
+ * A pointer would silently start pointing at whichever object takes its slot
+ * next. The slot index plus one is in the upper half and the slot's generation
+ * in the lower half, so 0 is never a valid handle.
+ */
+typedef u32 ObjectHandle;
+
+struct ObjectPoolBehaviorStats {
+    const BehaviorScript *behavior;
+    u16 numLive;
+    u16 highWater;
+    u32 numSpawned;
+};
+
+struct ObjectPoolStats {
+    s32 numLive;
+    s32 highWater;
+    u32 numSpawned;
+    u32 numEvicted;         // unimportant objects unloaded to make room for a new one
+    u32 numStaleParents;    // object updates whose parent had been unloaded
+    u32 numUntrackedSpawns; // spawns of behaviors that didn't fit in the table
+    struct ObjectPoolBehaviorStats behaviors[OBJECT_POOL_NUM_BEHAVIORS];
+};
+
+extern struct ObjectPoolStats gObjectPoolStats;
+#endif
+
 void init_free_object_list(void);
 void clear_object_lists(struct ObjectNode *objLists);
 void unload_object(struct Object *obj);
 struct Object *create_object(const BehaviorScript *bhvScript);
 void mark_obj_for_deletion(struct Object *obj);
+#if OBJECT_POOL_TELEMETRY
+ObjectHandle obj_to_handle(struct Object *obj);
+struct Object *obj_from_handle(ObjectHandle handle);
+void obj_pool_set_parent(struct Object *obj, struct Object *parent);
+s32 obj_pool_parent_is_stale(struct Object *obj);
+#endif
 
 #endif // SPAWN_OBJECT_H
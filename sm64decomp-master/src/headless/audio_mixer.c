@@ -0,0 +1,756 @@
+#include <ultra64.h>
+#include <string.h>
+
+#include "headless.h"
+
+#ifdef HEADLESS_AUDIO_MIXER
+
+#ifdef __SSE2__
+#define AUDIO_MIXER_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+ * Host stand-in for the audio microcode. The headless build has no RSP, so
+ * without this the command lists built by synthesis_execute are thrown away
+ * and only the CPU side of audio is timed. The mixer runs each list against a
+ * copy of the RSP's 4 KB of DMEM, the way aspMain does, and its SAVEBUFF
+ * commands write the mixed samples straight into gAiBuffers.
+ *
+ * ADPCM decoding, resampling, envelope mixing and mixing do nearly all of the
+ * work, and on hosts with SSE2 they use SIMD versions of the C kernels. Both
+ * do the same integer arithmetic, so the output doesn't depend on which ran,
+ * and with gAudioMixerCheck set every such command is run both ways and the
+ * results compared.
+ *
+ * The kernels follow the arithmetic of the microcode in rsp/audio.s as far as
+ * it is understood. State that the microcode saves in RDRAM, such as the
+ * envelope mixer's ramps, is saved in the host's own layout, since only the
+ * mixer reads it back.
+ */
+
+#define DMEM_SIZE 0x1000
+
+#define ROUND_UP(value, alignment) (((value) + ((alignment) - 1)) & ~((alignment) - 1))
+
+// Bytes of RDRAM state that each stateful command reads and writes
+#define ADPCM_STATE_SIZE (16 * sizeof(s16))
+#define RESAMPLE_STATE_SIZE (5 * sizeof(s16))
+#define MAX_STATE_SIZE sizeof(struct EnvMixerState)
+
+struct EnvMixerState {
+    s32 value[2];
+    s32 target[2];
+    s32 rate[2];
+    s32 expSequence[2];
+    s16 dry;
+    s16 wet;
+};
+
+struct AudioMixerState {
+    s16 dmem[DMEM_SIZE / sizeof(s16)] ALIGNED16;
+    u16 in;
+    u16 out;
+    u16 count;
+    u16 dryRight;
+    u16 wetLeft;
+    u16 wetRight;
+    s16 vol[2];
+    s16 target[2];
+    s32 rate[2];
+    s16 dry;
+    s16 wet;
+    s16 *loopState;
+    s16 adpcmBooks[8][2][8];
+#ifdef AUDIO_MIXER_SSE2
+    // For each predictor, the coefficients of the inputs (prev2, prev1),
+    // (ins[0], ins[1]), ... (ins[6], ins[7]) for outputs 0-3 and 4-7
+    __m128i adpcmCoefs[8][5][2];
+#endif
+};
+
+struct AudioMixerStats gAudioMixerStats;
+s32 gAudioMixerCheck = FALSE;
+
+static struct AudioMixerState sMixer;
+static struct AudioMixerState sCheckMixer;
+
+/**
+ * Four tap resampling filter, indexed by the top 6 bits of the position
+ * between two input samples. Copied from aspMain's data.
+ */
+static const u16 sResampleTable[64][4] = {
+    { 0x0c39, 0x66ad, 0x0d46, 0xffdf }, { 0x0b39, 0x6696, 0x0e5f, 0xffd8 },
+    { 0x0a44, 0x6669, 0x0f83, 0xffd0 }, { 0x095a, 0x6626, 0x10b4, 0xffc8 },
+    { 0x087d, 0x65cd, 0x11f0, 0xffbf }, { 0x07ab, 0x655e, 0x1338, 0xffb6 },
+    { 0x06e4, 0x64d9, 0x148c, 0xffac }, { 0x0628, 0x643f, 0x15eb, 0xffa1 },
+    { 0x0577, 0x638f, 0x1756, 0xff96 }, { 0x04d1, 0x62cb, 0x18cb, 0xff8a },
+    { 0x0435, 0x61f3, 0x1a4c, 0xff7e }, { 0x03a4, 0x6106, 0x1bd7, 0xff71 },
+    { 0x031c, 0x6007, 0x1d6c, 0xff64 }, { 0x029f, 0x5ef5, 0x1f0b, 0xff56 },
+    { 0x022a, 0x5dd0, 0x20b3, 0xff48 }, { 0x01be, 0x5c9a, 0x2264, 0xff3a },
+    { 0x015b, 0x5b53, 0x241e, 0xff2c }, { 0x0101, 0x59fc, 0x25e0, 0xff1e },
+    { 0x00ae, 0x5896, 0x27a9, 0xff10 }, { 0x0063, 0x5720, 0x297a, 0xff02 },
+    { 0x001f, 0x559d, 0x2b50, 0xfef4 }, { 0xffe2, 0x540d, 0x2d2c, 0xfee8 },
+    { 0xffac, 0x5270, 0x2f0d, 0xfedb }, { 0xff7c, 0x50c7, 0x30f3, 0xfed0 },
+    { 0xff53, 0x4f14, 0x32dc, 0xfec6 }, { 0xff2e, 0x4d57, 0x34c8, 0xfebd },
+    { 0xff0f, 0x4b91, 0x36b6, 0xfeb6 }, { 0xfef5, 0x49c2, 0x38a5, 0xfeb0 },
+    { 0xfedf, 0x47ed, 0x3a95, 0xfeac }, { 0xfece, 0x4611, 0x3c85, 0xfeab },
+    { 0xfec0, 0x4430, 0x3e74, 0xfeac }, { 0xfeb6, 0x424a, 0x4060, 0xfeaf },
+    { 0xfeaf, 0x4060, 0x424a, 0xfeb6 }, { 0xfeac, 0x3e74, 0x4430, 0xfec0 },
+    { 0xfeab, 0x3c85, 0x4611, 0xfece }, { 0xfeac, 0x3a95, 0x47ed, 0xfedf },
+    { 0xfeb0, 0x38a5, 0x49c2, 0xfef5 }, { 0xfeb6, 0x36b6, 0x4b91, 0xff0f },
+    { 0xfebd, 0x34c8, 0x4d57, 0xff2e }, { 0xfec6, 0x32dc, 0x4f14, 0xff53 },
+    { 0xfed0, 0x30f3, 0x50c7, 0xff7c }, { 0xfedb, 0x2f0d, 0x5270, 0xffac },
+    { 0xfee8, 0x2d2c, 0x540d, 0xffe2 }, { 0xfef4, 0x2b50, 0x559d, 0x001f },
+    { 0xff02, 0x297a, 0x5720, 0x0063 }, { 0xff10, 0x27a9, 0x5896, 0x00ae },
+    { 0xff1e, 0x25e0, 0x59fc, 0x0101 }, { 0xff2c, 0x241e, 0x5b53, 0x015b },
+    { 0xff3a, 0x2264, 0x5c9a, 0x01be }, { 0xff48, 0x20b3, 0x5dd0, 0x022a },
+    { 0xff56, 0x1f0b, 0x5ef5, 0x029f }, { 0xff64, 0x1d6c, 0x6007, 0x031c },
+    { 0xff71, 0x1bd7, 0x6106, 0x03a4 }, { 0xff7e, 0x1a4c, 0x61f3, 0x0435 },
+    { 0xff8a, 0x18cb, 0x62cb, 0x04d1 }, { 0xff96, 0x1756, 0x638f, 0x0577 },
+    { 0xffa1, 0x15eb, 0x643f, 0x0628 }, { 0xffac, 0x148c, 0x64d9, 0x06e4 },
+    { 0xffb6, 0x1338, 0x655e, 0x07ab }, { 0xffbf, 0x11f0, 0x65cd, 0x087d },
+    { 0xffc8, 0x10b4, 0x6626, 0x095a }, { 0xffd0, 0x0f83, 0x6669, 0x0a44 },
+    { 0xffd8, 0x0e5f, 0x6696, 0x0b39 }, { 0xffdf, 0x0d46, 0x66ad, 0x0c39 },
+};
+
+static s16 clamp16(s32 value) {
+    if (value > 0x7FFF) {
+        return 0x7FFF;
+    }
+    if (value < -0x8000) {
+        return -0x8000;
+    }
+    return value;
+}
+
+static s32 dmem_range_ok(u32 addr, u32 size) {
+    return (addr & 1) == 0 && addr + size <= DMEM_SIZE;
+}
+
+static s16 *dmem_s16(struct AudioMixerState *m, u32 addr) {
+    return m->dmem + addr / sizeof(s16);
+}
+
+/**
+ * Decode 8 samples from their scaled residuals, predicting from the two
+ * samples before out.
+ */
+static void adpcm_decode_c(s16 *out, const s16 *ins, s16 book[2][8]) {
+    s16 prev2 = out[-2];
+    s16 prev1 = out[-1];
+    s32 acc;
+    s32 j;
+    s32 k;
+
+    for (j = 0; j < 8; j++) {
+        acc = book[0][j] * prev2 + book[1][j] * prev1 + ins[j] * 2048;
+        for (k = 0; k < j; k++) {
+            acc += book[1][j - k - 1] * ins[k];
+        }
+        out[j] = clamp16(acc >> 11);
+    }
+}
+
+#ifdef AUDIO_MIXER_SSE2
+/**
+ * Each output of adpcm_decode_c is a sum of products of the 10 inputs, so
+ * multiply them by the predictor's coefficients two inputs at a time.
+ */
+static void adpcm_decode_sse2(s16 *out, const s16 *ins, __m128i coefs[5][2]) {
+    __m128i pair = _mm_set1_epi32((u16) out[-2] | ((u32)(u16) out[-1] << 16));
+    __m128i lo = _mm_madd_epi16(pair, coefs[0][0]);
+    __m128i hi = _mm_madd_epi16(pair, coefs[0][1]);
+    s32 i;
+
+    for (i = 1; i < 5; i++) {
+        pair = _mm_set1_epi32((u16) ins[i * 2 - 2] | ((u32)(u16) ins[i * 2 - 1] << 16));
+        lo = _mm_add_epi32(lo, _mm_madd_epi16(pair, coefs[i][0]));
+        hi = _mm_add_epi32(hi, _mm_madd_epi16(pair, coefs[i][1]));
+    }
+
+    _mm_storeu_si128((__m128i *) out,
+                     _mm_packs_epi32(_mm_srai_epi32(lo, 11), _mm_srai_epi32(hi, 11)));
+}
+
+static void adpcm_build_coefs(struct AudioMixerState *m) {
+    s16 columns[10][8];
+    s16 (*book)[8];
+    s32 p;
+    s32 i;
+    s32 j;
+
+    for (p = 0; p < 8; p++) {
+        book = m->adpcmBooks[p];
+        for (j = 0; j < 8; j++) {
+            columns[0][j] = book[0][j];
+            columns[1][j] = book[1][j];
+            for (i = 0; i < 8; i++) {
+                columns[i + 2][j] = i == j ? 2048 : i < j ? book[1][j - i - 1] : 0;
+            }
+        }
+
+        for (i = 0; i < 5; i++) {
+            for (j = 0; j < 2; j++) {
+                m->adpcmCoefs[p][i][j] = _mm_setr_epi16(
+                    columns[i * 2][j * 4 + 0], columns[i * 2 + 1][j * 4 + 0],
+                    columns[i * 2][j * 4 + 1], columns[i * 2 + 1][j * 4 + 1],
+                    columns[i * 2][j * 4 + 2], columns[i * 2 + 1][j * 4 + 2],
+                    columns[i * 2][j * 4 + 3], columns[i * 2 + 1][j * 4 + 3]);
+            }
+        }
+    }
+}
+#endif
+
+/**
+ * Decode count bytes of samples from the ADPCM frames at in, after the last
+ * 16 samples of the previous call, which are kept in state.
+ */
+static s32 cmd_adpcm(struct AudioMixerState *m, u32 flags, s16 *state, s32 simd) {
+    u32 count = ROUND_UP(m->count, 32);
+    u8 *in = (u8 *) m->dmem + m->in;
+    s16 *out;
+    s16 ins[8];
+    s32 nibble;
+    s32 shift;
+    s32 predictor;
+    s32 half;
+    s32 n;
+    s32 i;
+
+    if (!dmem_range_ok(m->out, 16 * sizeof(s16) + count) || m->in + count / 32 * 9 > DMEM_SIZE) {
+        return FALSE;
+    }
+
+    out = dmem_s16(m, m->out);
+    if (flags & A_INIT) {
+        memset(out, 0, 16 * sizeof(s16));
+    } else if ((flags & A_LOOP) && m->loopState != NULL) {
+        memcpy(out, m->loopState, 16 * sizeof(s16));
+    } else {
+        memcpy(out, state, 16 * sizeof(s16));
+    }
+    out += 16;
+
+    for (n = count; n > 0; n -= 16 * sizeof(s16)) {
+        shift = *in >> 4;
+        predictor = *in & 7;
+        in++;
+
+        for (half = 0; half < 2; half++) {
+            for (i = 0; i < 8; i++) {
+                nibble = (i & 1) ? (in[i / 2] & 0xF) : (in[i / 2] >> 4);
+                if (nibble >= 8) {
+                    nibble -= 16;
+                }
+                ins[i] = (s16)(nibble * (1 << shift));
+            }
+            in += 4;
+
+#ifdef AUDIO_MIXER_SSE2
+            if (simd) {
+                adpcm_decode_sse2(out, ins, m->adpcmCoefs[predictor]);
+            } else {
+                adpcm_decode_c(out, ins, m->adpcmBooks[predictor]);
+            }
+#else
+            adpcm_decode_c(out, ins, m->adpcmBooks[predictor]);
+#endif
+            out += 8;
+        }
+    }
+
+    memcpy(state, out - 16, 16 * sizeof(s16));
+    return TRUE;
+}
+
+static s16 ramp_step(s32 *value, s32 *step, s32 target) {
+    *value += *step;
+    if (*step <= 0 ? *value <= target : *value >= target) {
+        *value = target;
+        *step = 0;
+    }
+    return *value >> 16;
+}
+
+static void mix_gains_c(s16 *dst, const s16 *src, const s16 *gains) {
+    s32 i;
+
+    for (i = 0; i < 8; i++) {
+        dst[i] = clamp16(dst[i] + ((src[i] * gains[i]) >> 15));
+    }
+}
+
+#ifdef AUDIO_MIXER_SSE2
+static void mix_gains_sse2(s16 *dst, const s16 *src, const s16 *gains) {
+    __m128i s = _mm_loadu_si128((const __m128i *) src);
+    __m128i g = _mm_loadu_si128((const __m128i *) gains);
+    __m128i d = _mm_loadu_si128((const __m128i *) dst);
+    __m128i productLo = _mm_mullo_epi16(s, g);
+    __m128i productHi = _mm_mulhi_epi16(s, g);
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(productLo, productHi), 15);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(productLo, productHi), 15);
+
+    lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(d, d), 16));
+    hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(d, d), 16));
+    _mm_storeu_si128((__m128i *) dst, _mm_packs_epi32(lo, hi));
+}
+#endif
+
+/**
+ * Mix the samples at in into the dry left and right buffers, and with A_AUX
+ * also the wet ones, while ramping the left and right volumes towards their
+ * targets.
+ */
+static s32 cmd_envmixer(struct AudioMixerState *m, u32 flags, struct EnvMixerState *saved, s32 simd) {
+    struct EnvMixerState env;
+    u32 count = ROUND_UP(m->count, 16);
+    s32 numOutputs = (flags & A_AUX) ? 4 : 2;
+    u16 outputs[4];
+    s16 *buffers[4];
+    s16 gains[4][8];
+    s16 *in;
+    s32 step[2];
+    s16 volLeft;
+    s16 volRight;
+    u32 pos;
+    s32 i;
+
+    outputs[0] = m->out;
+    outputs[1] = m->dryRight;
+    outputs[2] = m->wetLeft;
+    outputs[3] = m->wetRight;
+    if (!dmem_range_ok(m->in, count)) {
+        return FALSE;
+    }
+    for (i = 0; i < numOutputs; i++) {
+        if (!dmem_range_ok(outputs[i], count)) {
+            return FALSE;
+        }
+        buffers[i] = dmem_s16(m, outputs[i]);
+    }
+    in = dmem_s16(m, m->in);
+
+    if (flags & A_INIT) {
+        for (i = 0; i < 2; i++) {
+            env.value[i] = m->vol[i] * 0x10000;
+            env.target[i] = m->target[i] * 0x10000;
+            env.rate[i] = m->rate[i];
+            env.expSequence[i] = (s32)((u32) m->vol[i] * (u32) m->rate[i]);
+        }
+        env.dry = m->dry;
+        env.wet = m->wet;
+    } else {
+        memcpy(&env, saved, sizeof(env));
+    }
+
+    for (i = 0; i < 2; i++) {
+        step[i] = (s32)((u32) env.target[i] - (u32) env.value[i]);
+    }
+
+    for (pos = 0; pos < count / sizeof(s16); pos += 8) {
+        // The ramps approach their targets exponentially, a step per 8 samples
+        for (i = 0; i < 2; i++) {
+            if (step[i] != 0) {
+                env.expSequence[i] = ((s64) env.expSequence[i] * env.rate[i]) >> 16;
+                step[i] = (env.expSequence[i] - env.value[i]) >> 3;
+            }
+        }
+
+        for (i = 0; i < 8; i++) {
+            volLeft = ramp_step(&env.value[0], &step[0], env.target[0]);
+            volRight = ramp_step(&env.value[1], &step[1], env.target[1]);
+            gains[0][i] = clamp16((volLeft * env.dry + 0x4000) >> 15);
+            gains[1][i] = clamp16((volRight * env.dry + 0x4000) >> 15);
+            gains[2][i] = clamp16((volLeft * env.wet + 0x4000) >> 15);
+            gains[3][i] = clamp16((volRight * env.wet + 0x4000) >> 15);
+        }
+
+        for (i = 0; i < numOutputs; i++) {
+#ifdef AUDIO_MIXER_SSE2
+            if (simd) {
+                mix_gains_sse2(buffers[i] + pos, in + pos, gains[i]);
+            } else {
+                mix_gains_c(buffers[i] + pos, in + pos, gains[i]);
+            }
+#else
+            mix_gains_c(buffers[i] + pos, in + pos, gains[i]);
+#endif
+        }
+    }
+
+    memcpy(saved, &env, sizeof(env));
+    return TRUE;
+}
+
+/**
+ * Resample numOut samples from in, which starts at the 4 taps of the first
+ * output. Returns where the taps of the next output start.
+ */
+static s16 *resample_c(s16 *out, s16 *in, u32 numOut, u32 *accumulator, u32 step) {
+    const u16 *taps;
+    u32 acc = *accumulator;
+    s32 sample;
+    u32 i;
+
+    for (i = 0; i < numOut; i++) {
+        taps = sResampleTable[acc >> 10];
+        sample = in[0] * (s16) taps[0] + in[1] * (s16) taps[1] + in[2] * (s16) taps[2]
+                 + in[3] * (s16) taps[3];
+        out[i] = clamp16((sample + 0x4000) >> 15);
+        acc += step;
+        in += acc >> 16;
+        acc &= 0xFFFF;
+    }
+
+    *accumulator = acc;
+    return in;
+}
+
+#ifdef AUDIO_MIXER_SSE2
+/**
+ * Resample four outputs at a time, pairing each output's taps with its
+ * filter so that two multiply-adds and a horizontal add give all four sums.
+ */
+static s16 *resample_sse2(s16 *out, s16 *in, u32 numOut, u32 *accumulator, u32 step) {
+    const u16 *taps[4];
+    s16 *src[4];
+    u32 acc = *accumulator;
+    __m128i a;
+    __m128i b;
+    __m128 sumsA;
+    __m128 sumsB;
+    __m128i sums;
+    u32 i;
+    s32 j;
+
+    for (i = 0; i < numOut; i += 4) {
+        for (j = 0; j < 4; j++) {
+            src[j] = in;
+            taps[j] = sResampleTable[acc >> 10];
+            acc += step;
+            in += acc >> 16;
+            acc &= 0xFFFF;
+        }
+
+        a = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *) src[0]),
+                               _mm_loadl_epi64((const __m128i *) src[1]));
+        b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *) src[2]),
+                               _mm_loadl_epi64((const __m128i *) src[3]));
+        a = _mm_madd_epi16(a, _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *) taps[0]),
+                                                 _mm_loadl_epi64((const __m128i *) taps[1])));
+        b = _mm_madd_epi16(b, _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *) taps[2]),
+                                                 _mm_loadl_epi64((const __m128i *) taps[3])));
+
+        sumsA = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+        sumsB = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1));
+        sums = _mm_add_epi32(_mm_castps_si128(sumsA), _mm_castps_si128(sumsB));
+        sums = _mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(0x4000)), 15);
+        _mm_storel_epi64((__m128i *) (out + i), _mm_packs_epi32(sums, sums));
+    }
+
+    *accumulator = acc;
+    return in;
+}
+#endif
+
+/**
+ * Resample the samples at in by pitch, a 1.15 fixed point step, carrying
+ * the filter's last 4 taps and position over from the previous call in state.
+ */
+static s32 cmd_resample(struct AudioMixerState *m, u32 flags, u32 pitch, s16 *state, s32 simd) {
+    u32 count = ROUND_UP(m->count, 16);
+    u32 numOut = count / sizeof(s16);
+    u32 step = pitch << 1;
+    u32 acc = (flags & A_INIT) ? 0 : (u16) state[4];
+    u32 numIn = (acc + numOut * step) >> 16;
+    s16 *in;
+
+    if (m->in < 4 * sizeof(s16) || !dmem_range_ok(m->in - 4 * sizeof(s16), (numIn + 4) * sizeof(s16))
+        || !dmem_range_ok(m->out, count)) {
+        return FALSE;
+    }
+
+    in = dmem_s16(m, m->in) - 4;
+    if (flags & A_INIT) {
+        memset(in, 0, 4 * sizeof(s16));
+    } else {
+        memcpy(in, state, 4 * sizeof(s16));
+    }
+
+#ifdef AUDIO_MIXER_SSE2
+    if (simd) {
+        in = resample_sse2(dmem_s16(m, m->out), in, numOut, &acc, step);
+    } else {
+        in = resample_c(dmem_s16(m, m->out), in, numOut, &acc, step);
+    }
+#else
+    in = resample_c(dmem_s16(m, m->out), in, numOut, &acc, step);
+#endif
+
+    memcpy(state, in, 4 * sizeof(s16));
+    state[4] = acc;
+    return TRUE;
+}
+
+/**
+ * Mix count bytes of samples at in into out, scaled by gain.
+ */
+static s32 cmd_mixer(struct AudioMixerState *m, s16 gain, u32 inAddr, u32 outAddr, s32 simd) {
+    u32 count = ROUND_UP(m->count, 32);
+    s16 *in;
+    s16 *out;
+    u32 i;
+#ifdef AUDIO_MIXER_SSE2
+    __m128i gains;
+    __m128i x;
+    __m128i y;
+    __m128i lo;
+    __m128i hi;
+#endif
+
+    if (!dmem_range_ok(inAddr, count) || !dmem_range_ok(outAddr, count)) {
+        return FALSE;
+    }
+    in = dmem_s16(m, inAddr);
+    out = dmem_s16(m, outAddr);
+
+#ifdef AUDIO_MIXER_SSE2
+    if (simd) {
+        gains = _mm_set1_epi32(0x7FFF | ((u32)(u16) gain << 16));
+        for (i = 0; i < count / sizeof(s16); i += 8) {
+            x = _mm_loadu_si128((__m128i *) (out + i));
+            y = _mm_loadu_si128((__m128i *) (in + i));
+            if (gain == -0x8000) {
+                _mm_storeu_si128((__m128i *) (out + i), _mm_subs_epi16(x, y));
+                continue;
+            }
+            lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(x, y), gains), _mm_set1_epi32(0x4000));
+            hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(x, y), gains), _mm_set1_epi32(0x4000));
+            _mm_storeu_si128((__m128i *) (out + i),
+                             _mm_packs_epi32(_mm_srai_epi32(lo, 15), _mm_srai_epi32(hi, 15)));
+        }
+        return TRUE;
+    }
+#endif
+
+    // A gain of -1 subtracts exactly, where 0x7FFF doesn't quite add
+    for (i = 0; i < count / sizeof(s16); i++) {
+        if (gain == -0x8000) {
+            out[i] = clamp16(out[i] - in[i]);
+        } else {
+            out[i] = clamp16((out[i] * 0x7FFF + in[i] * gain + 0x4000) >> 15);
+        }
+    }
+    return TRUE;
+}
+
+static s32 cmd_interleave(struct AudioMixerState *m, u32 leftAddr, u32 rightAddr) {
+    u32 count = ROUND_UP(m->count, 16);
+    s16 *left;
+    s16 *right;
+    s16 *out;
+    u32 i;
+
+    if (!dmem_range_ok(leftAddr, count) || !dmem_range_ok(rightAddr, count)
+        || !dmem_range_ok(m->out, count * 2)) {
+        return FALSE;
+    }
+    left = dmem_s16(m, leftAddr);
+    right = dmem_s16(m, rightAddr);
+    out = dmem_s16(m, m->out);
+
+    // Working back to front lets the output start at the left channel
+    for (i = count / sizeof(s16); i > 0; i--) {
+        s16 l = left[i - 1];
+        s16 r = right[i - 1];
+
+        out[i * 2 - 2] = l;
+        out[i * 2 - 1] = r;
+    }
+    return TRUE;
+}
+
+/**
+ * Run one command against m. Returns FALSE for commands that can't be run.
+ */
+static s32 run_command(struct AudioMixerState *m, Acmd *cmd, s32 simd) {
+    uintptr_t w0 = cmd->words.w0;
+    uintptr_t w1 = cmd->words.w1;
+    u32 flags = (w0 >> 16) & 0xFF;
+    u32 count;
+
+    switch ((w0 >> 24) & 0xFF) {
+        case A_SPNOOP:
+        case A_SEGMENT:
+            // Addresses are host pointers, so segments aren't needed
+            return TRUE;
+
+        case A_ADPCM:
+            return cmd_adpcm(m, flags, (s16 *) w1, simd);
+
+        case A_CLEARBUFF:
+            count = ROUND_UP(w1 & 0xFFFF, 16);
+            if (!dmem_range_ok(w0 & 0xFFFF, count)) {
+                return FALSE;
+            }
+            memset((u8 *) m->dmem + (w0 & 0xFFFF), 0, count);
+            return TRUE;
+
+        case A_ENVMIXER:
+            return cmd_envmixer(m, flags, (struct EnvMixerState *) w1, simd);
+
+        case A_LOADBUFF:
+            // DMA transfers ignore the low 3 bits of the RDRAM address
+            count = ROUND_UP(m->count, 8);
+            if (!dmem_range_ok(m->in, count)) {
+                return FALSE;
+            }
+            memcpy((u8 *) m->dmem + m->in, (u8 *) (w1 & ~(uintptr_t) 7), count);
+            return TRUE;
+
+        case A_RESAMPLE:
+            return cmd_resample(m, flags, w0 & 0xFFFF, (s16 *) w1, simd);
+
+        case A_SAVEBUFF:
+            count = ROUND_UP(m->count, 8);
+            if (!dmem_range_ok(m->out, count)) {
+                return FALSE;
+            }
+            memcpy((u8 *) (w1 & ~(uintptr_t) 7), (u8 *) m->dmem + m->out, count);
+            return TRUE;
+
+        case A_SETBUFF:
+            if (flags & A_AUX) {
+                m->dryRight = w0 & 0xFFFF;
+                m->wetLeft = (w1 >> 16) & 0xFFFF;
+                m->wetRight = w1 & 0xFFFF;
+            } else {
+                m->in = w0 & 0xFFFF;
+                m->out = (w1 >> 16) & 0xFFFF;
+                m->count = w1 & 0xFFFF;
+            }
+            return TRUE;
+
+        case A_SETVOL:
+            if (flags & A_AUX) {
+                m->dry = (s16) w0;
+                m->wet = (s16) w1;
+            } else if (flags & A_VOL) {
+                m->vol[(flags & A_LEFT) ? 0 : 1] = (s16) w0;
+            } else {
+                m->target[(flags & A_LEFT) ? 0 : 1] = (s16) w0;
+                m->rate[(flags & A_LEFT) ? 0 : 1] = (s32) w1;
+            }
+            return TRUE;
+
+        case A_DMEMMOVE:
+            count = ROUND_UP(w1 & 0xFFFF, 16);
+            if (!dmem_range_ok(w0 & 0xFFFF, count) || !dmem_range_ok((w1 >> 16) & 0xFFFF, count)) {
+                return FALSE;
+            }
+            memmove((u8 *) m->dmem + ((w1 >> 16) & 0xFFFF), (u8 *) m->dmem + (w0 & 0xFFFF), count);
+            return TRUE;
+
+        case A_LOADADPCM:
+            count = w0 & 0xFFFFFF;
+            if (count > sizeof(m->adpcmBooks)) {
+                count = sizeof(m->adpcmBooks);
+            }
+            memcpy(m->adpcmBooks, (void *) w1, count);
+#ifdef AUDIO_MIXER_SSE2
+            adpcm_build_coefs(m);
+#endif
+            return TRUE;
+
+        case A_MIXER:
+            return cmd_mixer(m, (s16) w0, (w1 >> 16) & 0xFFFF, w1 & 0xFFFF, simd);
+
+        case A_INTERLEAVE:
+            return cmd_interleave(m, (w1 >> 16) & 0xFFFF, w1 & 0xFFFF);
+
+        case A_SETLOOP:
+            m->loopState = (s16 *) w1;
+            return TRUE;
+    }
+
+    // A_POLEF is never used by the game
+    return FALSE;
+}
+
+/**
+ * Returns the number of bytes of RDRAM state that a command with a SIMD
+ * kernel updates, or -1 for commands without one.
+ */
+static s32 kernel_state_size(Acmd *cmd) {
+    switch ((cmd->words.w0 >> 24) & 0xFF) {
+        case A_ADPCM:
+            return ADPCM_STATE_SIZE;
+        case A_ENVMIXER:
+            return sizeof(struct EnvMixerState);
+        case A_RESAMPLE:
+            return RESAMPLE_STATE_SIZE;
+        case A_MIXER:
+            return 0;
+    }
+    return -1;
+}
+
+/**
+ * Run a command with a SIMD kernel on a copy of the mixer with the C kernels
+ * first, and count a mismatch if the two leave DMEM or the saved state
+ * different.
+ */
+static s32 run_checked_command(Acmd *cmd, s32 stateSize) {
+    u8 *state = (u8 *) cmd->words.w1;
+    u8 stateBefore[MAX_STATE_SIZE];
+    u8 stateAfter[MAX_STATE_SIZE];
+    s32 success;
+
+    sCheckMixer = sMixer;
+    if (stateSize != 0) {
+        memcpy(stateBefore, state, stateSize);
+    }
+    run_command(&sCheckMixer, cmd, FALSE);
+    if (stateSize != 0) {
+        memcpy(stateAfter, state, stateSize);
+        memcpy(state, stateBefore, stateSize);
+    }
+
+    success = run_command(&sMixer, cmd, TRUE);
+
+    gAudioMixerStats.numKernelsChecked++;
+    if (memcmp(sCheckMixer.dmem, sMixer.dmem, sizeof(sMixer.dmem)) != 0
+        || (stateSize != 0 && memcmp(stateAfter, state, stateSize) != 0)) {
+        gAudioMixerStats.numKernelMismatches++;
+    }
+    return success;
+}
+
+/**
+ * Run an audio task's command list, as the RSP would have.
+ */
+void audio_mixer_run(Acmd *cmds, s32 numCommands) {
+    s32 stateSize;
+    s32 success;
+    s32 i;
+
+    gAudioMixerStats.numTasks++;
+    gAudioMixerStats.numCommands += numCommands;
+
+    for (i = 0; i < numCommands; i++) {
+        stateSize = gAudioMixerCheck ? kernel_state_size(&cmds[i]) : -1;
+        if (stateSize >= 0) {
+            success = run_checked_command(&cmds[i], stateSize);
+        } else {
+            success = run_command(&sMixer, &cmds[i], TRUE);
+        }
+
+        if (!success) {
+            gAudioMixerStats.numBadCommands++;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,344 @@
+#include <ultra64.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sm64.h"
+#include "engine/level_script.h"
+#include "engine/surface_collision.h"
+#include "engine/surface_load.h"
+#include "game/area.h"
+#include "game/level_update.h"
+#include "game/object_list_processor.h"
+#include "headless.h"
+#include "level_table.h"
+
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+
+/**
+ * Collision benchmark and differential test for the static surface indexes:
+ * the quadtree, and the packed lists with their SIMD kernels. Every timed
+ * frame, Mario's position is replayed against the level's collision through
+ * the indexes and through the plain 16x16 cell lists, and each area's
+ * collision is searched at random points through both when it is first seen.
+ * The results must be identical, and the number of triangles each search
+ * tested is added up per level.
+ */
+
+// Times each position is searched when timing the two paths
+#define COLLISION_BENCH_REPEATS 16
+// Random points searched in each area
+#define COLLISION_BENCH_RANDOM_POINTS 20000
+
+enum CollisionBenchPath {
+    COLLISION_PATH_CELLS,
+    COLLISION_PATH_INDEX,
+    COLLISION_PATH_COUNT
+};
+
+enum CollisionBenchQuery {
+    COLLISION_QUERY_FLOOR,
+    COLLISION_QUERY_CEIL,
+    COLLISION_QUERY_WALL,
+    COLLISION_QUERY_COUNT
+};
+
+struct CollisionBenchResult {
+    struct Surface *floor;
+    struct Surface *ceil;
+    f32 floorHeight;
+    f32 ceilHeight;
+    struct WallCollisionData walls[2];
+    s32 numWallCollisions[2];
+};
+
+struct CollisionBenchLevel {
+    u32 numPositions;
+    u64 numTested[COLLISION_PATH_COUNT][COLLISION_QUERY_COUNT];
+    OSTime time[COLLISION_PATH_COUNT];
+};
+
+static struct CollisionBenchLevel sLevels[LEVEL_COUNT];
+static u32 sNumReplayMismatches = 0;
+static u32 sNumRandomMismatches = 0;
+static u32 sNumAreasSearched = 0;
+static u32 sLastLevelInit = 0;
+static s16 sLastArea = -1;
+static SpatialPartitionCell sSavedDynamicPartition[NUM_CELLS][NUM_CELLS];
+#if SURFACE_QUADTREE
+static struct SurfaceQuadNode *sSavedQuadtree[NUM_CELLS][NUM_CELLS];
+#endif
+#if SURFACE_PACKED_LISTS
+static s32 sSavedPackedCount;
+#endif
+
+/**
+ * Make the static searches use the plain cell lists, or restore the indexes.
+ */
+static void use_static_surface_index(s32 useIndex) {
+    if (useIndex) {
+#if SURFACE_QUADTREE
+        memcpy(gStaticSurfaceQuadtree, sSavedQuadtree, sizeof(gStaticSurfaceQuadtree));
+#endif
+#if SURFACE_PACKED_LISTS
+        gStaticPackedSurfaces.count = sSavedPackedCount;
+#endif
+    } else {
+#if SURFACE_QUADTREE
+        memcpy(sSavedQuadtree, gStaticSurfaceQuadtree, sizeof(gStaticSurfaceQuadtree));
+        memset(gStaticSurfaceQuadtree, 0, sizeof(gStaticSurfaceQuadtree));
+#endif
+#if SURFACE_PACKED_LISTS
+        sSavedPackedCount = gStaticPackedSurfaces.count;
+        gStaticPackedSurfaces.count = -1;
+#endif
+    }
+}
+
+/**
+ * Leave object surfaces out of the searches, or put them back.
+ */
+static void use_dynamic_surfaces(s32 useDynamic) {
+    if (useDynamic) {
+        memcpy(gDynamicSurfacePartition, sSavedDynamicPartition, sizeof(gDynamicSurfacePartition));
+    } else {
+        memcpy(sSavedDynamicPartition, gDynamicSurfacePartition, sizeof(gDynamicSurfacePartition));
+        memset(gDynamicSurfacePartition, 0, sizeof(gDynamicSurfacePartition));
+    }
+}
+
+/**
+ * Run the searches Mario's ground step makes at a position: the floor and
+ * ceiling, and the walls at his upper and lower wall check heights.
+ */
+static void search_position(Vec3f pos, struct CollisionBenchResult *result) {
+    struct WallCollisionData *walls;
+    s32 i;
+
+    result->floorHeight = find_floor(pos[0], pos[1], pos[2], &result->floor);
+    result->ceilHeight = find_ceil(pos[0], pos[1] + 80.0f, pos[2], &result->ceil);
+
+    for (i = 0; i < 2; i++) {
+        walls = &result->walls[i];
+        memset(walls, 0, sizeof(*walls));
+        walls->x = pos[0];
+        walls->y = pos[1];
+        walls->z = pos[2];
+        walls->offsetY = i == 0 ? 60.0f : 30.0f;
+        walls->radius = i == 0 ? 50.0f : 24.0f;
+        result->numWallCollisions[i] = find_wall_collisions(walls);
+    }
+}
+
+static s32 results_match(struct CollisionBenchResult *a, struct CollisionBenchResult *b) {
+    struct WallCollisionData *wallsA;
+    struct WallCollisionData *wallsB;
+    s32 i;
+
+    if (a->floor != b->floor || memcmp(&a->floorHeight, &b->floorHeight, sizeof(f32)) != 0
+        || a->ceil != b->ceil || memcmp(&a->ceilHeight, &b->ceilHeight, sizeof(f32)) != 0) {
+        return FALSE;
+    }
+
+    for (i = 0; i < 2; i++) {
+        wallsA = &a->walls[i];
+        wallsB = &b->walls[i];
+        if (a->numWallCollisions[i] != b->numWallCollisions[i] || wallsA->numWalls != wallsB->numWalls
+            || memcmp(wallsA->walls, wallsB->walls, wallsA->numWalls * sizeof(struct Surface *)) != 0
+            || memcmp(&wallsA->x, &wallsB->x, sizeof(f32)) != 0
+            || memcmp(&wallsA->z, &wallsB->z, sizeof(f32)) != 0) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Count the triangles a first-hit search walked in a list, up to and including
+ * the one it returned.
+ */
+static s32 count_tested(struct SurfaceNode *list, struct Surface *hit) {
+    s32 count = 0;
+
+    while (list != NULL) {
+        count++;
+        if (list->surface == hit) {
+            break;
+        }
+        list = list->next;
+    }
+    return count;
+}
+
+static struct SurfaceNode *static_list(UNUSED s32 path, Vec3f pos, s32 listIndex) {
+    s16 x = pos[0];
+    s16 z = pos[2];
+    s16 cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+    s16 cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+
+#if SURFACE_QUADTREE
+    if (path == COLLISION_PATH_INDEX) {
+        return find_static_surface_list(cellX, cellZ, x, z, listIndex);
+    }
+#endif
+    return gStaticSurfacePartition[cellZ][cellX][listIndex].next;
+}
+
+/**
+ * Time the static searches at a position through one path and add up the
+ * triangles they tested. Object surfaces are left out, so only the static
+ * lists, which the index replaces, are searched.
+ */
+static void time_position(s32 path, Vec3f pos, struct CollisionBenchLevel *level) {
+    struct CollisionBenchResult result;
+    OSTime start;
+    s32 i;
+
+    start = osGetTime();
+    for (i = 0; i < COLLISION_BENCH_REPEATS; i++) {
+        search_position(pos, &result);
+    }
+    level->time[path] += osGetTime() - start;
+
+    level->numTested[path][COLLISION_QUERY_FLOOR] +=
+        count_tested(static_list(path, pos, SPATIAL_PARTITION_FLOORS), result.floor);
+    level->numTested[path][COLLISION_QUERY_CEIL] +=
+        count_tested(static_list(path, pos, SPATIAL_PARTITION_CEILS), result.ceil);
+    level->numTested[path][COLLISION_QUERY_WALL] +=
+        2 * count_tested(static_list(path, pos, SPATIAL_PARTITION_WALLS), NULL);
+}
+
+/**
+ * Search a position through both paths. Returns whether they agreed.
+ */
+static s32 compare_position(Vec3f pos) {
+    struct CollisionBenchResult indexResult;
+    struct CollisionBenchResult cellResult;
+
+    search_position(pos, &indexResult);
+    use_static_surface_index(FALSE);
+    search_position(pos, &cellResult);
+    use_static_surface_index(TRUE);
+
+    return results_match(&indexResult, &cellResult);
+}
+
+/**
+ * Compare both paths on the static collision of the current area at random
+ * points across the level bounds, at heights in the range levels use.
+ */
+static void compare_random_points(void) {
+    struct Object *savedObject = gCurrentObject;
+    Vec3f pos;
+    s32 i;
+
+    srand(64);
+    gCurrentObject = NULL;
+    use_dynamic_surfaces(FALSE);
+
+    for (i = 0; i < COLLISION_BENCH_RANDOM_POINTS; i++) {
+        pos[0] = (f32)(rand() % (2 * LEVEL_BOUNDARY_MAX - 1) - (LEVEL_BOUNDARY_MAX - 1));
+        pos[1] = (f32)(rand() % (2 * -FLOOR_LOWER_LIMIT) + FLOOR_LOWER_LIMIT);
+        pos[2] = (f32)(rand() % (2 * LEVEL_BOUNDARY_MAX - 1) - (LEVEL_BOUNDARY_MAX - 1));
+
+        // Also use positions off the integer grid, as the wall searches do
+        if (i & 1) {
+            pos[0] += (f32) rand() / (f32) RAND_MAX - 0.5f;
+            pos[2] += (f32) rand() / (f32) RAND_MAX - 0.5f;
+        }
+
+        if (!compare_position(pos)) {
+            sNumRandomMismatches++;
+        }
+    }
+
+    use_dynamic_surfaces(TRUE);
+    gCurrentObject = savedObject;
+    sNumAreasSearched++;
+}
+
+/**
+ * Replay Mario's position for this frame through both paths, after searching
+ * the area's collision at random points if it was just loaded.
+ */
+void collision_bench_frame(void) {
+    struct CollisionBenchLevel *level;
+    struct Object *savedObject = gCurrentObject;
+    f32 *pos = gMarioStates[0].pos;
+
+    if (gMarioObject == NULL || gCurrLevelNum < 0 || gCurrLevelNum >= LEVEL_COUNT) {
+        return;
+    }
+    level = &sLevels[gCurrLevelNum];
+    level->numPositions++;
+
+    if (gNumLevelInits != sLastLevelInit || gCurrAreaIndex != sLastArea) {
+        sLastLevelInit = gNumLevelInits;
+        sLastArea = gCurrAreaIndex;
+        compare_random_points();
+    }
+
+    // Mario's own searches run with him as the current object, which matters
+    // for vanish cap walls.
+    gCurrentObject = gMarioObject;
+
+    if (!compare_position(pos)) {
+        sNumReplayMismatches++;
+    }
+
+    use_dynamic_surfaces(FALSE);
+    time_position(COLLISION_PATH_INDEX, pos, level);
+    use_static_surface_index(FALSE);
+    time_position(COLLISION_PATH_CELLS, pos, level);
+    use_static_surface_index(TRUE);
+    use_dynamic_surfaces(TRUE);
+
+    gCurrentObject = savedObject;
+}
+
+static f64 ns_per_position(OSTime time, u32 numPositions) {
+    return (f64) time * 1000000000.0 / (f64)(osClockRate * 3 / 4) / numPositions;
+}
+
+/**
+ * Print the mean triangles tested per position by each kind of search, and
+ * the time all of a position's searches took, for each level that was
+ * replayed. Returns the number of positions whose results differed, replayed
+ * or random.
+ */
+s32 collision_bench_report(void) {
+    static const char *queryNames[COLLISION_QUERY_COUNT] = { "floor", "ceil", "wall" };
+    struct CollisionBenchLevel *level;
+    s32 query;
+    s32 i;
+
+    printf("collision bench: %u replay mismatches, %u random point mismatches in %u areas\n",
+           sNumReplayMismatches, sNumRandomMismatches, sNumAreasSearched);
+    printf("  %-6s %-6s %10s %10s %10s %10s\n", "level", "search", "cells", "index", "cells ns",
+           "index ns");
+
+    for (i = 0; i < LEVEL_COUNT; i++) {
+        level = &sLevels[i];
+        if (level->numPositions == 0) {
+            continue;
+        }
+
+        for (query = 0; query < COLLISION_QUERY_COUNT; query++) {
+            printf("  %-6d %-6s %10.1f %10.1f", i, queryNames[query],
+                   (f64) level->numTested[COLLISION_PATH_CELLS][query] / level->numPositions,
+                   (f64) level->numTested[COLLISION_PATH_INDEX][query] / level->numPositions);
+            if (query == 0) {
+                printf(" %10.1f %10.1f",
+                       ns_per_position(level->time[COLLISION_PATH_CELLS],
+                                     level->numPositions * COLLISION_BENCH_REPEATS),
+                       ns_per_position(level->time[COLLISION_PATH_INDEX],
+                                     level->numPositions * COLLISION_BENCH_REPEATS));
+            }
+            printf("\n");
+        }
+    }
+
+    return sNumReplayMismatches + sNumRandomMismatches;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <PR/ultratypes.h>
+
+#include "game/profiler.h"
+
+// The Shindou audio microcode has its own command set, which the mixer doesn't run
+#if HOST_AUDIO_MIXER && !defined(VERSION_SH)
+#define HEADLESS_AUDIO_MIXER
+#endif
+
+void headless_end_frame(struct ProfilerFrameData *frame);
+#if SIMD_MATRIX_MATH
+s32 run_math_bench(s32 iterations);
+#endif
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+void collision_bench_frame(void);
+s32 collision_bench_report(void);
+#endif
+
+#ifdef HEADLESS_AUDIO_MIXER
+struct AudioMixerStats {
+    u32 numTasks;
+    u32 numCommands;
+    // commands the mixer doesn't know, or whose buffers run outside of DMEM
+    u32 numBadCommands;
+    u32 numKernelsChecked;
+    u32 numKernelMismatches;
+};
+
+extern struct AudioMixerStats gAudioMixerStats;
+extern s32 gAudioMixerCheck;
+
+void audio_mixer_run(Acmd *cmds, s32 numCommands);
+#endif
+
+#endif // HEADLESS_H
@@ -0,0 +1,762 @@
+#include <ultra64.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sm64.h"
+#include "audio/data.h"
+#include "audio/external.h"
+#include "audio/load.h"
+#include "behavior_data.h"
+#include "engine/anim_cache.h"
+#include "engine/anim_pose.h"
+#include "engine/level_script.h"
+#include "game/area.h"
+#include "game/game_init.h"
+#include "game/level_update.h"
+#include "game/main.h"
+#include "game/memory.h"
+#include "game/object_helpers.h"
+#include "game/object_list_processor.h"
+#include "game/profiler.h"
+#include "game/rendering_graph_node.h"
+#include "game/spawn_object.h"
+#include "headless.h"
+#include "level_table.h"
+#include "model_ids.h"
+#include "seq_ids.h"
+
+/**
+ * Entry point for the headless build. This runs the game loop on the main
+ * thread with no video or audio output, feeding it neutral controller inputs
+ * so that the title screen's demos play, and prints how long each part of the
+ * frame took once the requested number of frames has run.
+ */
+
+#define MAIN_POOL_SIZE 0x800000
+
+// behaviors listed in the object pool report
+#define REPORT_POOL_BEHAVIORS 8
+
+// object slots left free for the level's own objects when spawning a crowd.
+#define STRESS_RESERVED_OBJECTS 40
+#define STRESS_OBJECT_SPACING 120.0f
+
+enum HeadlessTimerID {
+    HEADLESS_TIMER_GAME,
+    HEADLESS_TIMER_RENDER,
+    HEADLESS_TIMER_DISPLAY_LISTS,
+    HEADLESS_TIMER_AUDIO,
+#ifdef HEADLESS_AUDIO_MIXER
+    HEADLESS_TIMER_AUDIO_MIXER,
+#endif
+    HEADLESS_TIMER_FRAME,
+    HEADLESS_TIMER_COUNT
+};
+
+struct HeadlessTimer {
+    const char *name;
+    OSTime total;
+    OSTime min;
+    OSTime max;
+};
+
+static struct HeadlessTimer sTimers[HEADLESS_TIMER_COUNT] = {
+    { "game logic", 0, 0, 0 },
+    { "render", 0, 0, 0 },
+    { "display lists", 0, 0, 0 },
+    { "audio", 0, 0, 0 },
+#ifdef HEADLESS_AUDIO_MIXER
+    { "audio mixer", 0, 0, 0 },
+#endif
+    { "frame", 0, 0, 0 },
+};
+
+static u8 sMainPool[MAIN_POOL_SIZE] ALIGNED16;
+
+static s32 sNumFrames = 1800;
+static s32 sNumWarmupFrames = 0;
+static s32 sFramesRun = 0;
+static s32 sNumStressObjects = 0;
+static s32 sStressObjectsSpawned = FALSE;
+
+// Time spent on the frames that loaded each level, warmup included
+static OSTime sLevelLoadTimes[LEVEL_COUNT];
+static u32 sNumLevelLoads[LEVEL_COUNT];
+static u32 sNumLevelInitsSeen = 0;
+
+#if OBJECT_PROFILER
+static const char *sCollisionPhaseNames[OBJECT_PROFILER_COLLISION_COUNT] = {
+    "clear", "player", "destructive", "pushable",
+};
+
+static FILE *sCsvFile = NULL;
+static u32 sNumFramesDumped = 0;
+#endif
+
+#if GEO_STATIC_MATRIX_CACHE
+static u64 sNumStaticMatricesBuilt = 0;
+static u64 sNumStaticMatricesReused = 0;
+#endif
+
+#if MASTER_LIST_SORTING
+static u64 sNumMasterListCommands = 0;
+static u64 sNumUnsortedMasterListCommands = 0;
+#endif
+
+#if ANIMATION_CACHE
+// the animation cache's totals when timing started
+static struct AnimCacheStats sAnimCacheStatsAtStart;
+#endif
+
+#if MAIN_POOL_TRACKING
+static FILE *sMemoryMapFile = NULL;
+#endif
+
+#ifdef HEADLESS_AUDIO_MIXER
+static FILE *sAudioOutFile = NULL;
+static u32 sNumAudioFramesOut = 0;
+static u32 sAudioChecksum = 2166136261U;
+
+// Audio time per frame by the level music playing, with a last entry for none
+static OSTime sSequenceSynthesisTimes[SEQ_COUNT + 1];
+static OSTime sSequenceMixerTimes[SEQ_COUNT + 1];
+static u32 sNumSequenceFrames[SEQ_COUNT + 1];
+#endif
+
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+static s32 sCollisionBench = FALSE;
+#endif
+
+#if ANIMATION_POSES
+static u64 sNumPosesEvaluated = 0;
+static u64 sNumPosesReused = 0;
+static s32 sCheckPoses = FALSE;
+static u32 sNumPosesChecked = 0;
+static u32 sNumPoseMismatches = 0;
+#endif
+
+static void add_time(enum HeadlessTimerID id, OSTime start, OSTime end) {
+    struct HeadlessTimer *timer = &sTimers[id];
+    OSTime time = end > start ? end - start : 0;
+
+    if (sFramesRun == sNumWarmupFrames + 1 || time < timer->min) {
+        timer->min = time;
+    }
+    if (time > timer->max) {
+        timer->max = time;
+    }
+    timer->total += time;
+}
+
+static f64 cycles_to_usec(OSTime cycles) {
+    return (f64) cycles * 1000000.0 / (f64)(osClockRate * 3 / 4);
+}
+
+#if MAIN_POOL_TRACKING
+/**
+ * Print the main pool's peak usage overall and in each area that was loaded.
+ */
+static void print_main_pool_report(void) {
+    s32 level;
+    s32 area;
+
+    printf("main pool: %u/%u bytes peak, %d states pushed (%d max), %u cross-state frees, "
+           "%u unmatched pops, %u unrecorded blocks\n",
+           gMainPoolTracking.peakUsed, gMainPoolTracking.size, gMainPoolTracking.depth,
+           gMainPoolTracking.maxDepth, gMainPoolTracking.numCrossStateFrees,
+           gMainPoolTracking.numUnmatchedPops, gMainPoolTracking.numDroppedRecords);
+
+    for (level = 0; level < LEVEL_COUNT; level++) {
+        for (area = 0; area < MAIN_POOL_TRACKED_AREAS; area++) {
+            if (gMainPoolTracking.peakUsedPerArea[level][area] != 0) {
+                printf("  level %d area %d: %u bytes peak\n", level, area,
+                       gMainPoolTracking.peakUsedPerArea[level][area]);
+            }
+        }
+    }
+}
+
+/**
+ * Write the blocks currently allocated from the main pool, one per line, as
+ * side, offset from that side's end, size, segment, and level command. The
+ * allocation site follows, but it's the only column that changes between
+ * builds when the layout doesn't, so it comes last for easy diffing.
+ */
+static void write_memory_map(FILE *file) {
+    struct MainPoolRecord *record;
+    s32 side;
+    s32 i;
+
+    for (side = MEMORY_POOL_LEFT; side <= MEMORY_POOL_RIGHT; side++) {
+        for (i = 0; i < gMainPoolTracking.numRecords; i++) {
+            record = &gMainPoolTracking.records[i];
+            if (record->side != side) {
+                continue;
+            }
+
+            fprintf(file, "%c %08X %08X seg %02X cmd %02X %p\n", side == MEMORY_POOL_LEFT ? 'L' : 'R',
+                    side == MEMORY_POOL_LEFT ? (u32)(record->block - sMainPool)
+                                             : (u32)(sMainPool + sizeof(sMainPool) - record->block),
+                    record->size, record->segment, record->levelCmd, record->site);
+        }
+    }
+}
+#endif
+
+#if OBJECT_POOL_TELEMETRY
+/**
+ * Print the object pool's totals since boot and the behaviors that held the
+ * most slots at once.
+ */
+static void print_object_pool_report(void) {
+    struct ObjectPoolBehaviorStats *top[REPORT_POOL_BEHAVIORS];
+    struct ObjectPoolBehaviorStats *entry;
+    s32 numTop = 0;
+    s32 i;
+    s32 j;
+
+    printf("object pool: %d/%d live, %d high water, %u spawned, %u evicted, %u stale parents\n",
+           gObjectPoolStats.numLive, OBJECT_POOL_CAPACITY, gObjectPoolStats.highWater,
+           gObjectPoolStats.numSpawned, gObjectPoolStats.numEvicted, gObjectPoolStats.numStaleParents);
+
+    for (i = 0; i < OBJECT_POOL_NUM_BEHAVIORS; i++) {
+        entry = &gObjectPoolStats.behaviors[i];
+        if (entry->behavior == NULL) {
+            continue;
+        }
+
+        // Insert into the list of behaviors with the highest high water marks
+        for (j = numTop; j > 0 && top[j - 1]->highWater < entry->highWater; j--) {
+            if (j < REPORT_POOL_BEHAVIORS) {
+                top[j] = top[j - 1];
+            }
+        }
+        if (j < REPORT_POOL_BEHAVIORS) {
+            top[j] = entry;
+            if (numTop < REPORT_POOL_BEHAVIORS) {
+                numTop++;
+            }
+        }
+    }
+
+    for (i = 0; i < numTop; i++) {
+        printf("  behavior %p: %u live, %u high water, %u spawned\n", (const void *) top[i]->behavior,
+               top[i]->numLive, top[i]->highWater, top[i]->numSpawned);
+    }
+    if (gObjectPoolStats.numUntrackedSpawns != 0) {
+        printf("  %u spawns of untracked behaviors\n", gObjectPoolStats.numUntrackedSpawns);
+    }
+}
+#endif
+
+#ifdef HEADLESS_AUDIO_MIXER
+/**
+ * Add the samples that the audio task just mixed into the AI buffer to the
+ * output checksum, and to the output file if there is one.
+ */
+static void write_audio_frame(void) {
+    s16 *samples = gAiBuffers[gCurrAiBufferIndex];
+    s32 numSamples = gAiBufferLengths[gCurrAiBufferIndex] * 2;
+    u8 bytes[2];
+    s32 i;
+
+    for (i = 0; i < numSamples; i++) {
+        bytes[0] = samples[i] & 0xFF;
+        bytes[1] = (samples[i] >> 8) & 0xFF;
+        sAudioChecksum = (sAudioChecksum ^ bytes[0]) * 16777619U;
+        sAudioChecksum = (sAudioChecksum ^ bytes[1]) * 16777619U;
+        if (sAudioOutFile != NULL) {
+            fwrite(bytes, 1, 2, sAudioOutFile);
+        }
+    }
+    sNumAudioFramesOut += numSamples / 2;
+}
+
+static void write_u16_le(u8 *dest, u32 value) {
+    dest[0] = value & 0xFF;
+    dest[1] = (value >> 8) & 0xFF;
+}
+
+static void write_u32_le(u8 *dest, u32 value) {
+    write_u16_le(dest, value & 0xFFFF);
+    write_u16_le(dest + 2, value >> 16);
+}
+
+/**
+ * Fill in the header of the WAV file, which was left blank until the number
+ * of samples was known.
+ */
+static void finish_audio_file(FILE *file) {
+    u8 header[44];
+    u32 dataSize = sNumAudioFramesOut * 4;
+
+    memcpy(header, "RIFF", 4);
+    write_u32_le(header + 4, 36 + dataSize);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    write_u32_le(header + 16, 16);
+    write_u16_le(header + 20, 1);
+    write_u16_le(header + 22, 2);
+    write_u32_le(header + 24, gAiFrequency);
+    write_u32_le(header + 28, gAiFrequency * 4);
+    write_u16_le(header + 32, 4);
+    write_u16_le(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    write_u32_le(header + 40, dataSize);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), file);
+}
+
+/**
+ * Print the mixer's totals, the output checksum, and the cost of audio per
+ * frame while each piece of level music was playing.
+ */
+static void print_audio_report(void) {
+    s32 i;
+
+    printf("audio mixer: %u tasks, %u commands, %u bad commands\n", gAudioMixerStats.numTasks,
+           gAudioMixerStats.numCommands, gAudioMixerStats.numBadCommands);
+    if (gAudioMixerCheck) {
+        printf("audio check: %u kernels checked, %u mismatches\n", gAudioMixerStats.numKernelsChecked,
+               gAudioMixerStats.numKernelMismatches);
+    }
+    printf("audio output: %u samples, checksum %08X\n", sNumAudioFramesOut, sAudioChecksum);
+
+    for (i = 0; i <= SEQ_COUNT; i++) {
+        if (sNumSequenceFrames[i] == 0) {
+            continue;
+        }
+        if (i < SEQ_COUNT) {
+            printf("  sequence %02X:", i);
+        } else {
+            printf("  no sequence:");
+        }
+        printf(" %u frames, %.2f us synthesis, %.2f us mixer mean\n", sNumSequenceFrames[i],
+               cycles_to_usec(sSequenceSynthesisTimes[i]) / sNumSequenceFrames[i],
+               cycles_to_usec(sSequenceMixerTimes[i]) / sNumSequenceFrames[i]);
+    }
+}
+#endif
+
+static void print_report(void) {
+    s32 i;
+
+    printf("%d frames (%d warmup), level %d area %d\n", sNumFrames, sNumWarmupFrames, gCurrLevelNum,
+           gCurrAreaIndex);
+    if (sStressObjectsSpawned) {
+        printf("%d stress objects\n", sNumStressObjects);
+    }
+    printf("mario %.3f %.3f %.3f\n", gMarioStates[0].pos[0], gMarioStates[0].pos[1],
+           gMarioStates[0].pos[2]);
+    printf("%-16s %12s %10s %10s %10s\n", "subsystem", "total ms", "mean us", "min us", "max us");
+
+    for (i = 0; i < HEADLESS_TIMER_COUNT; i++) {
+        struct HeadlessTimer *timer = &sTimers[i];
+
+        printf("%-16s %12.3f %10.2f %10.2f %10.2f\n", timer->name, cycles_to_usec(timer->total) / 1000.0,
+               cycles_to_usec(timer->total) / sNumFrames, cycles_to_usec(timer->min),
+               cycles_to_usec(timer->max));
+    }
+
+    for (i = 0; i < LEVEL_COUNT; i++) {
+        if (sNumLevelLoads[i] != 0) {
+            printf("level %d loads: %u, %.3f ms mean\n", i, sNumLevelLoads[i],
+                   cycles_to_usec(sLevelLoadTimes[i]) / 1000.0 / sNumLevelLoads[i]);
+        }
+    }
+
+#if MASTER_LIST_SORTING
+    printf("master list commands per frame: %.1f (%.1f unsorted)\n",
+           (f64) sNumMasterListCommands / sNumFrames, (f64) sNumUnsortedMasterListCommands / sNumFrames);
+#endif
+#if GEO_STATIC_MATRIX_CACHE
+    printf("static node matrices per frame: %.1f built, %.1f reused\n",
+           (f64) sNumStaticMatricesBuilt / sNumFrames, (f64) sNumStaticMatricesReused / sNumFrames);
+#endif
+#if ANIMATION_CACHE
+    printf("animation cache: %u hits, %u decodes, %u evictions, %u mario loads from ram\n",
+           gAnimCacheStats.numHits - sAnimCacheStatsAtStart.numHits,
+           gAnimCacheStats.numDecodes - sAnimCacheStatsAtStart.numDecodes,
+           gAnimCacheStats.numEvictions - sAnimCacheStatsAtStart.numEvictions,
+           gAnimCacheStats.numLoads - sAnimCacheStatsAtStart.numLoads);
+#endif
+#if ANIMATION_POSES
+    printf("poses per frame: %.1f evaluated, %.1f reused\n", (f64) sNumPosesEvaluated / sNumFrames,
+           (f64) sNumPosesReused / sNumFrames);
+    if (sCheckPoses) {
+        printf("pose check: %u poses checked, %u mismatches\n", sNumPosesChecked, sNumPoseMismatches);
+    }
+#endif
+#if OBJECT_POOL_TELEMETRY
+    print_object_pool_report();
+#endif
+#if MAIN_POOL_TRACKING
+    print_main_pool_report();
+#endif
+#ifdef HEADLESS_AUDIO_MIXER
+    print_audio_report();
+#endif
+}
+
+#if ANIMATION_POSES
+/**
+ * Check the pose of every animated object at its current frame against its
+ * animation read channel by channel.
+ */
+static void check_object_poses(void) {
+    struct Object *obj;
+    s32 numMismatches;
+    s32 i;
+
+    for (i = 0; i < OBJECT_POOL_CAPACITY; i++) {
+        obj = &gObjectPool[i];
+        if ((obj->activeFlags & ACTIVE_FLAG_ACTIVE) && obj->header.gfx.animInfo.curAnim != NULL) {
+            numMismatches = anim_pose_check(obj->header.gfx.animInfo.curAnim,
+                                            obj->header.gfx.animInfo.animFrame);
+            if (numMismatches >= 0) {
+                sNumPosesChecked++;
+                sNumPoseMismatches += numMismatches;
+            }
+        }
+    }
+}
+#endif
+
+#if OBJECT_PROFILER
+/**
+ * Write every object profiler record made since the last call as CSV rows of
+ * frame, kind, id, count, and microseconds. Behaviors are identified by the
+ * address of their script, which can be looked up in the executable's symbols.
+ */
+static void dump_object_profiler_csv(void) {
+    struct ObjectProfilerFrame *frame;
+    u32 age;
+    s32 i;
+
+    if (gObjectProfilerFrameCount - sNumFramesDumped > OBJECT_PROFILER_FRAMES) {
+        sNumFramesDumped = gObjectProfilerFrameCount - OBJECT_PROFILER_FRAMES;
+    }
+
+    while (sNumFramesDumped < gObjectProfilerFrameCount) {
+        age = gObjectProfilerFrameCount - 1 - sNumFramesDumped;
+        frame = object_profiler_get_frame(age);
+        sNumFramesDumped++;
+
+        for (i = 0; i < NUM_OBJ_LISTS; i++) {
+            if (frame->listCounts[i] != 0) {
+                fprintf(sCsvFile, "%u,list,%d,%u,%.2f\n", frame->globalTimer, i, frame->listCounts[i],
+                        cycles_to_usec(frame->listTimes[i]));
+            }
+        }
+
+        for (i = 0; i < OBJECT_PROFILER_BEHAVIORS; i++) {
+            struct ObjectProfilerBehavior *entry = &frame->behaviors[i];
+
+            if (entry->behavior != NULL) {
+                fprintf(sCsvFile, "%u,behavior,%p,%u,%.2f\n", frame->globalTimer,
+                        (const void *) entry->behavior, entry->count, cycles_to_usec(entry->time));
+            }
+        }
+
+        if (frame->numDroppedObjects != 0) {
+            fprintf(sCsvFile, "%u,behavior,other,%u,%.2f\n", frame->globalTimer,
+                    frame->numDroppedObjects, cycles_to_usec(frame->otherTime));
+        }
+
+        for (i = 0; i < OBJECT_PROFILER_COLLISION_COUNT; i++) {
+            fprintf(sCsvFile, "%u,collision,%s,1,%.2f\n", frame->globalTimer, sCollisionPhaseNames[i],
+                    cycles_to_usec(frame->collisionTimes[i]));
+        }
+    }
+}
+#endif
+
+/**
+ * Spawn a square of goombas centered on Mario to stress object collision and
+ * update. They have no model, so they add nothing to rendering. The count is
+ * limited by the free slots in the object pool.
+ */
+static void spawn_stress_objects(void) {
+    struct ObjectNode *node;
+    struct Object *obj;
+    s32 numFree = 0;
+    s32 side = 1;
+    s32 i;
+
+    for (node = gFreeObjectList.next; node != NULL; node = node->next) {
+        numFree++;
+    }
+    if (sNumStressObjects > numFree - STRESS_RESERVED_OBJECTS) {
+        sNumStressObjects = numFree - STRESS_RESERVED_OBJECTS;
+    }
+
+    while (side * side < sNumStressObjects) {
+        side++;
+    }
+
+    for (i = 0; i < sNumStressObjects; i++) {
+        obj = spawn_object(gMarioObject, MODEL_NONE, bhvGoomba);
+        obj->oPosX += (i % side - side / 2) * STRESS_OBJECT_SPACING;
+        obj->oPosZ += (i / side - side / 2) * STRESS_OBJECT_SPACING;
+    }
+
+    sStressObjectsSpawned = TRUE;
+}
+
+/**
+ * Called from the profiler at the end of each game frame. Runs the audio
+ * frame that the sound thread would have, then adds up the frame's times.
+ */
+void headless_end_frame(struct ProfilerFrameData *frame) {
+    OSTime audioTime = 0;
+#ifdef HEADLESS_AUDIO_MIXER
+    struct SPTask *audioTask = NULL;
+    OSTime mixerStart;
+    OSTime mixerTime = 0;
+    s32 seqId;
+#endif
+    s32 status;
+    s32 i;
+
+    if (gResetTimer < 25) {
+        profiler_log_thread4_time();
+#ifdef VERSION_SH
+        func_sh_802f5a80();
+#elif defined(HEADLESS_AUDIO_MIXER)
+        audioTask = create_next_audio_frame_task();
+#else
+        create_next_audio_frame_task();
+#endif
+        profiler_log_thread4_time();
+    }
+
+#ifdef HEADLESS_AUDIO_MIXER
+    // data_size counts commands as the N64's 8 byte ones
+    if (audioTask != NULL) {
+        mixerStart = osGetTime();
+        audio_mixer_run((Acmd *) audioTask->task.t.data_ptr, audioTask->task.t.data_size / sizeof(u64));
+        mixerTime = osGetTime() - mixerStart;
+        write_audio_frame();
+    }
+#endif
+
+    for (i = 0; i + 1 < frame->numSoundTimes; i += 2) {
+        audioTime += frame->soundTimes[i + 1] - frame->soundTimes[i];
+    }
+
+    if (sNumStressObjects > 0 && !sStressObjectsSpawned && gMarioObject != NULL) {
+        spawn_stress_objects();
+    }
+
+    // Level loads run in the level script, before rendering starts
+    if (gNumLevelInits != sNumLevelInitsSeen && gCurrLevelNum >= 0 && gCurrLevelNum < LEVEL_COUNT) {
+        sNumLevelInitsSeen = gNumLevelInits;
+        sLevelLoadTimes[gCurrLevelNum] +=
+            frame->gameTimes[LEVEL_SCRIPT_EXECUTE] - frame->gameTimes[THREAD5_START];
+        sNumLevelLoads[gCurrLevelNum]++;
+    }
+
+    sFramesRun++;
+    if (sFramesRun <= sNumWarmupFrames) {
+#if OBJECT_PROFILER
+        sNumFramesDumped = gObjectProfilerFrameCount;
+#endif
+#if ANIMATION_CACHE
+        sAnimCacheStatsAtStart = gAnimCacheStats;
+#endif
+        return;
+    }
+
+#if OBJECT_PROFILER
+    if (sCsvFile != NULL) {
+        dump_object_profiler_csv();
+    }
+#endif
+
+    add_time(HEADLESS_TIMER_GAME, frame->gameTimes[THREAD5_START], frame->gameTimes[LEVEL_SCRIPT_EXECUTE]);
+    add_time(HEADLESS_TIMER_RENDER, frame->gameTimes[LEVEL_SCRIPT_EXECUTE],
+             frame->gameTimes[BEFORE_DISPLAY_LISTS]);
+    add_time(HEADLESS_TIMER_DISPLAY_LISTS, frame->gameTimes[BEFORE_DISPLAY_LISTS],
+             frame->gameTimes[AFTER_DISPLAY_LISTS]);
+    add_time(HEADLESS_TIMER_AUDIO, 0, audioTime);
+#ifdef HEADLESS_AUDIO_MIXER
+    add_time(HEADLESS_TIMER_AUDIO_MIXER, 0, mixerTime);
+    add_time(HEADLESS_TIMER_FRAME, frame->gameTimes[THREAD5_START],
+             frame->gameTimes[THREAD5_END] + audioTime + mixerTime);
+
+    seqId = gSequencePlayers[0].enabled ? gSequencePlayers[0].seqId : SEQ_COUNT;
+    if (seqId > SEQ_COUNT) {
+        seqId = SEQ_COUNT;
+    }
+    sSequenceSynthesisTimes[seqId] += audioTime;
+    sSequenceMixerTimes[seqId] += mixerTime;
+    sNumSequenceFrames[seqId]++;
+#else
+    add_time(HEADLESS_TIMER_FRAME, frame->gameTimes[THREAD5_START],
+             frame->gameTimes[THREAD5_END] + audioTime);
+#endif
+#if GEO_STATIC_MATRIX_CACHE
+    sNumStaticMatricesBuilt += gGeoMatrixStats.numBuilt;
+    sNumStaticMatricesReused += gGeoMatrixStats.numReused;
+#endif
+#if MASTER_LIST_SORTING
+    sNumMasterListCommands += gMasterListStats.numCommands;
+    sNumUnsortedMasterListCommands += gMasterListStats.numUnsortedCommands;
+#endif
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+    if (sCollisionBench) {
+        collision_bench_frame();
+    }
+#endif
+#if ANIMATION_POSES
+    sNumPosesEvaluated += gAnimPoseStats.numEvaluated;
+    sNumPosesReused += gAnimPoseStats.numReused;
+    if (sCheckPoses) {
+        check_object_poses();
+    }
+#endif
+
+    if (sFramesRun == sNumWarmupFrames + sNumFrames) {
+        print_report();
+#if OBJECT_PROFILER
+        if (sCsvFile != NULL) {
+            fclose(sCsvFile);
+        }
+#endif
+#if MAIN_POOL_TRACKING
+        if (sMemoryMapFile != NULL) {
+            write_memory_map(sMemoryMapFile);
+            fclose(sMemoryMapFile);
+        }
+#endif
+#ifdef HEADLESS_AUDIO_MIXER
+        if (sAudioOutFile != NULL) {
+            finish_audio_file(sAudioOutFile);
+            fclose(sAudioOutFile);
+        }
+#endif
+
+        status = 0;
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+        if (sCollisionBench) {
+            status |= collision_bench_report() != 0;
+        }
+#endif
+#if ANIMATION_POSES
+        status |= sNumPoseMismatches != 0;
+#endif
+#ifdef HEADLESS_AUDIO_MIXER
+        status |= gAudioMixerStats.numKernelMismatches != 0;
+#endif
+        exit(status);
+    }
+}
+
+static void print_usage(const char *name) {
+#if OBJECT_PROFILER
+    fprintf(stderr, "Usage: %s [--frames N] [--warmup N] [--demo N] [--stress N] [--csv FILE]\n", name);
+#else
+    fprintf(stderr, "Usage: %s [--frames N] [--warmup N] [--demo N] [--stress N]\n", name);
+#endif
+    fprintf(stderr, "  --frames N  number of frames to time (default 1800)\n");
+    fprintf(stderr, "  --warmup N  number of frames to run before timing (default 0)\n");
+    fprintf(stderr, "  --demo N    index of the first demo played from the title screen (default 0)\n");
+    fprintf(stderr, "  --stress N  spawn N extra objects around Mario once he has loaded\n");
+#if OBJECT_PROFILER
+    fprintf(stderr, "  --csv FILE  write the object profiler's records to FILE\n");
+#endif
+#if SIMD_MATRIX_MATH
+    fprintf(stderr, "  --math-bench N  time the matrix kernels over N passes, check them, and exit\n");
+#endif
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+    fprintf(stderr, "  --collision-bench  compare the surface indexes with the cells and time them\n");
+#endif
+#if ANIMATION_POSES
+    fprintf(stderr, "  --pose-check    check each animated object's pose every frame\n");
+#endif
+#if MAIN_POOL_TRACKING
+    fprintf(stderr, "  --memory-map FILE  write the main pool's allocated blocks to FILE at exit\n");
+#endif
+#ifdef HEADLESS_AUDIO_MIXER
+    fprintf(stderr, "  --audio-out FILE   write the mixed audio to FILE as a WAV file\n");
+    fprintf(stderr, "  --audio-check      check the SIMD audio kernels against the C versions\n");
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    s32 i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--frames") == 0) {
+            sNumFrames = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--warmup") == 0) {
+            sNumWarmupFrames = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--demo") == 0) {
+            gDemoInputListID = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--stress") == 0) {
+            sNumStressObjects = atoi(argv[++i]);
+#if OBJECT_PROFILER
+        } else if (i + 1 < argc && strcmp(argv[i], "--csv") == 0) {
+            sCsvFile = fopen(argv[++i], "w");
+            if (sCsvFile == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+            fprintf(sCsvFile, "frame,kind,id,count,us\n");
+#endif
+#if SIMD_MATRIX_MATH
+        } else if (i + 1 < argc && strcmp(argv[i], "--math-bench") == 0) {
+            return run_math_bench(atoi(argv[++i])) != 0;
+#endif
+#if SURFACE_QUADTREE || SURFACE_PACKED_LISTS
+        } else if (strcmp(argv[i], "--collision-bench") == 0) {
+            sCollisionBench = TRUE;
+#endif
+#if ANIMATION_POSES
+        } else if (strcmp(argv[i], "--pose-check") == 0) {
+            sCheckPoses = TRUE;
+#endif
+#if MAIN_POOL_TRACKING
+        } else if (i + 1 < argc && strcmp(argv[i], "--memory-map") == 0) {
+            sMemoryMapFile = fopen(argv[++i], "w");
+            if (sMemoryMapFile == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+#endif
+#ifdef HEADLESS_AUDIO_MIXER
+        } else if (i + 1 < argc && strcmp(argv[i], "--audio-out") == 0) {
+            sAudioOutFile = fopen(argv[++i], "wb");
+            if (sAudioOutFile == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+            // The header is written once the length is known
+            fseek(sAudioOutFile, 44, SEEK_SET);
+        } else if (strcmp(argv[i], "--audio-check") == 0) {
+            gAudioMixerCheck = TRUE;
+#endif
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (sNumFrames <= 0 || sNumWarmupFrames < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // thread3_main
+    setup_mesg_queues();
+    main_pool_init(sMainPool, sMainPool + sizeof(sMainPool));
+    gEffectsMemoryPool = mem_pool_init(0x4000, MEMORY_POOL_LEFT);
+
+    // thread4_sound
+    audio_init();
+    sound_init();
+
+    thread5_game_loop(NULL);
+    return 0;
+}
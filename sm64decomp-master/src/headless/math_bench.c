@@ -0,0 +1,140 @@
+#include <ultra64.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine/math_util.h"
+#include "headless.h"
+
+#if SIMD_MATRIX_MATH
+
+/**
+ * Microbenchmark for the SIMD matrix kernels. Times them against the C
+ * versions they replace on the same inputs and counts the results that differ
+ * in any bit, so it doubles as the kernels' exactness test.
+ */
+
+#define MATH_BENCH_MATRICES 256
+
+static Mat4 sInputs[MATH_BENCH_MATRICES];
+static Mat4 sRefProducts[MATH_BENCH_MATRICES];
+static Mat4 sProducts[MATH_BENCH_MATRICES];
+static Mtx sRefFixed[MATH_BENCH_MATRICES];
+static Mtx sFixed[MATH_BENCH_MATRICES];
+
+static f32 random_f32(f32 min, f32 max) {
+    return min + (max - min) * (f32) rand() / (f32) RAND_MAX;
+}
+
+/**
+ * Fill the inputs with scaled and translated rotations like the ones objects
+ * and level geometry use, with translations small enough for Mtx.
+ */
+static void init_inputs(void) {
+    Vec3f translate;
+    Vec3s rotate;
+    Vec3f scale;
+    s32 i;
+
+    srand(64);
+    for (i = 0; i < MATH_BENCH_MATRICES; i++) {
+        vec3f_set(translate, random_f32(-8000.0f, 8000.0f), random_f32(-8000.0f, 8000.0f),
+                  random_f32(-8000.0f, 8000.0f));
+        vec3s_set(rotate, rand(), rand(), rand());
+        vec3f_set(scale, random_f32(0.1f, 4.0f), random_f32(0.1f, 4.0f), random_f32(0.1f, 4.0f));
+        mtxf_rotate_zxy_and_translate(sInputs[i], translate, rotate);
+        mtxf_scale_vec3f(sInputs[i], sInputs[i], scale);
+    }
+}
+
+static f64 ns_per_call(OSTime start, OSTime end, s32 numCalls) {
+    return (f64)(end - start) * 1000000000.0 / (f64)(osClockRate * 3 / 4) / numCalls;
+}
+
+#ifdef MATH_UTIL_SSE2
+static s32 count_mismatches(void *a, void *b, size_t size) {
+    s32 numMismatches = 0;
+    s32 i;
+
+    for (i = 0; i < MATH_BENCH_MATRICES; i++) {
+        if (memcmp((u8 *) a + i * size, (u8 *) b + i * size, size) != 0) {
+            numMismatches++;
+        }
+    }
+    return numMismatches;
+}
+#endif
+
+/**
+ * Run each kernel over the inputs 'iterations' times and print the time per
+ * call. Returns the number of results that differ from the C versions.
+ */
+s32 run_math_bench(s32 iterations) {
+    s32 numMismatches = 0;
+    OSTime start;
+    s32 numCalls = iterations * MATH_BENCH_MATRICES;
+    s32 n;
+    s32 i;
+
+    if (iterations <= 0) {
+        iterations = 1;
+        numCalls = MATH_BENCH_MATRICES;
+    }
+
+    init_inputs();
+    printf("%-16s %10s %10s %10s\n", "kernel", "ref ns", "simd ns", "mismatches");
+
+#ifdef MATH_UTIL_SSE2
+    start = osGetTime();
+    for (n = 0; n < iterations; n++) {
+        for (i = 0; i < MATH_BENCH_MATRICES; i++) {
+            mtxf_mul_ref(sRefProducts[i], sInputs[i], sInputs[(i + n) % MATH_BENCH_MATRICES]);
+        }
+    }
+    printf("%-16s %10.2f", "mtxf_mul", ns_per_call(start, osGetTime(), numCalls));
+    start = osGetTime();
+    for (n = 0; n < iterations; n++) {
+        for (i = 0; i < MATH_BENCH_MATRICES; i++) {
+            mtxf_mul(sProducts[i], sInputs[i], sInputs[(i + n) % MATH_BENCH_MATRICES]);
+        }
+    }
+    printf(" %10.2f", ns_per_call(start, osGetTime(), numCalls));
+    n = count_mismatches(sRefProducts, sProducts, sizeof(Mat4));
+    printf(" %10d\n", n);
+    numMismatches += n;
+
+    start = osGetTime();
+    for (n = 0; n < iterations; n++) {
+        for (i = 0; i < MATH_BENCH_MATRICES; i++) {
+            mtxf_to_mtx_ref(&sRefFixed[i], sRefProducts[i]);
+        }
+    }
+    printf("%-16s %10.2f", "mtxf_to_mtx", ns_per_call(start, osGetTime(), numCalls));
+    start = osGetTime();
+    for (n = 0; n < iterations; n++) {
+        mtxf_to_mtx_batch(sFixed, sRefProducts, MATH_BENCH_MATRICES);
+    }
+    printf(" %10.2f", ns_per_call(start, osGetTime(), numCalls));
+    n = count_mismatches(sRefFixed, sFixed, sizeof(Mtx));
+    printf(" %10d\n", n);
+    numMismatches += n;
+#else
+    start = osGetTime();
+    for (n = 0; n < iterations; n++) {
+        for (i = 0; i < MATH_BENCH_MATRICES; i++) {
+            mtxf_mul(sProducts[i], sInputs[i], sInputs[(i + n) % MATH_BENCH_MATRICES]);
+        }
+    }
+    printf("%-16s %10.2f %10s %10s\n", "mtxf_mul", ns_per_call(start, osGetTime(), numCalls), "-", "-");
+    start = osGetTime();
+    for (n = 0; n < iterations; n++) {
+        mtxf_to_mtx_batch(sFixed, sProducts, MATH_BENCH_MATRICES);
+    }
+    printf("%-16s %10.2f %10s %10s\n", "mtxf_to_mtx", ns_per_call(start, osGetTime(), numCalls), "-", "-");
+    printf("no SIMD kernels for this host\n");
+#endif
+
+    return numMismatches;
+}
+
+#endif
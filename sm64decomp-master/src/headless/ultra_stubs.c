@@ -0,0 +1,262 @@
+#include <ultra64.h>
+#include <string.h>
+#include <time.h>
+
+#include "macros.h"
+
+/**
+ * Stand-ins for the parts of libultra that the game uses, for the headless
+ * build. Everything runs on one thread, so the message queues never block:
+ * receiving from an empty queue returns immediately, as if whichever thread
+ * or interrupt would have sent the message had already done so. PI DMAs are
+ * plain copies, since the "ROM" data is linked into the executable.
+ */
+
+u64 osClockRate = 62500000;
+u32 osTvType = TV_TYPE_NTSC;
+u32 osMemSize = 0x400000;
+
+OSViMode osViModeTable[56];
+
+// The RSP microcode is never run, but the game still points its tasks at it.
+u64 rspF3DBootStart[1], rspF3DBootEnd[1];
+u64 rspF3DStart[1], rspF3DEnd[1];
+u64 rspF3DDataStart[1], rspF3DDataEnd[1];
+u64 rspAspMainStart[1], rspAspMainEnd[1];
+u64 rspAspMainDataStart[1], rspAspMainDataEnd[1];
+
+static OSPiHandle sCartRomHandle;
+
+void osInitialize(void) {
+}
+
+void osCreateThread(UNUSED OSThread *thread, UNUSED OSId id, UNUSED void (*entry)(void *),
+                    UNUSED void *arg, UNUSED void *sp, UNUSED OSPri pri) {
+}
+
+void osStartThread(UNUSED OSThread *thread) {
+}
+
+void osSetThreadPri(UNUSED OSThread *thread, UNUSED OSPri pri) {
+}
+
+OSThread *__osGetCurrFaultedThread(void) {
+    return NULL;
+}
+
+void osCreateMesgQueue(OSMesgQueue *mq, OSMesg *msg, s32 count) {
+    mq->mtqueue = NULL;
+    mq->fullqueue = NULL;
+    mq->validCount = 0;
+    mq->first = 0;
+    mq->msgCount = count;
+    mq->msg = msg;
+}
+
+s32 osSendMesg(OSMesgQueue *mq, OSMesg msg, UNUSED s32 flag) {
+    if (mq == NULL || mq->validCount >= mq->msgCount) {
+        return -1;
+    }
+
+    mq->msg[(mq->first + mq->validCount) % mq->msgCount] = msg;
+    mq->validCount++;
+    return 0;
+}
+
+s32 osJamMesg(OSMesgQueue *mq, OSMesg msg, UNUSED s32 flag) {
+    if (mq == NULL || mq->validCount >= mq->msgCount) {
+        return -1;
+    }
+
+    mq->first = (mq->first + mq->msgCount - 1) % mq->msgCount;
+    mq->msg[mq->first] = msg;
+    mq->validCount++;
+    return 0;
+}
+
+s32 osRecvMesg(OSMesgQueue *mq, OSMesg *msg, s32 flag) {
+    if (mq->validCount == 0) {
+        if (flag == OS_MESG_NOBLOCK) {
+            return -1;
+        }
+        if (msg != NULL) {
+            *msg = NULL;
+        }
+        return 0;
+    }
+
+    if (msg != NULL) {
+        *msg = mq->msg[mq->first];
+    }
+    mq->first = (mq->first + 1) % mq->msgCount;
+    mq->validCount--;
+    return 0;
+}
+
+void osSetEventMesg(UNUSED OSEvent event, UNUSED OSMesgQueue *mq, UNUSED OSMesg msg) {
+}
+
+void osViSetEvent(UNUSED OSMesgQueue *mq, UNUSED OSMesg msg, UNUSED u32 retraceCount) {
+}
+
+/**
+ * Time in CPU counter ticks (3/4 of osClockRate), so that the profiler's
+ * conversions stay valid.
+ */
+OSTime osGetTime(void) {
+    struct timespec ts;
+    OSTime rate = osClockRate * 3 / 4;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (OSTime) ts.tv_sec * rate + (OSTime) ts.tv_nsec * rate / 1000000000;
+}
+
+void osSetTime(UNUSED OSTime time) {
+}
+
+u32 osGetCount(void) {
+    return (u32) osGetTime();
+}
+
+uintptr_t osVirtualToPhysical(void *addr) {
+    return (uintptr_t) addr;
+}
+
+void osInvalDCache(UNUSED void *vaddr, UNUSED size_t nbytes) {
+}
+
+void osInvalICache(UNUSED void *vaddr, UNUSED size_t nbytes) {
+}
+
+void osWritebackDCache(UNUSED void *vaddr, UNUSED size_t nbytes) {
+}
+
+void osWritebackDCacheAll(void) {
+}
+
+void osMapTLB(UNUSED s32 index, UNUSED OSPageMask pm, UNUSED void *vaddr, UNUSED u32 evenpaddr,
+              UNUSED u32 oddpaddr, UNUSED s32 asid) {
+}
+
+void osUnmapTLBAll(void) {
+}
+
+void osCreatePiManager(UNUSED OSPri pri, UNUSED OSMesgQueue *cmdQ, UNUSED OSMesg *cmdBuf,
+                       UNUSED s32 cmdMsgCnt) {
+}
+
+OSPiHandle *osCartRomInit(void) {
+    return &sCartRomHandle;
+}
+
+OSPiHandle *osDriveRomInit(void) {
+    return &sCartRomHandle;
+}
+
+s32 osPiStartDma(OSIoMesg *mb, UNUSED s32 priority, UNUSED s32 direction, uintptr_t devAddr, void *vAddr,
+                 size_t nbytes, OSMesgQueue *mq) {
+    memcpy(vAddr, (const void *) devAddr, nbytes);
+    osSendMesg(mq, mb, OS_MESG_NOBLOCK);
+    return 0;
+}
+
+s32 osEPiStartDma(UNUSED OSPiHandle *pihandle, OSIoMesg *mb, UNUSED s32 direction) {
+    memcpy(mb->dramAddr, (const void *) mb->devAddr, mb->size);
+    osSendMesg(mb->hdr.retQueue, mb, OS_MESG_NOBLOCK);
+    return 0;
+}
+
+void osCreateViManager(UNUSED OSPri pri) {
+}
+
+void osViSetMode(UNUSED OSViMode *mode) {
+}
+
+void osViBlack(UNUSED u8 active) {
+}
+
+void osViSetSpecialFeatures(UNUSED u32 func) {
+}
+
+void osViSwapBuffer(UNUSED void *vaddr) {
+}
+
+void osSpTaskLoad(UNUSED OSTask *task) {
+}
+
+void osSpTaskStartGo(UNUSED OSTask *task) {
+}
+
+void osSpTaskYield(void) {
+}
+
+OSYieldResult osSpTaskYielded(UNUSED OSTask *task) {
+    return 0;
+}
+
+s32 osAiSetFrequency(u32 frequency) {
+    return frequency;
+}
+
+s32 osAiSetNextBuffer(UNUSED void *buf, UNUSED u32 size) {
+    return 0;
+}
+
+u32 osAiGetLength(void) {
+    return 0;
+}
+
+/**
+ * A single controller is plugged into port 1. Its inputs are always neutral;
+ * demos overwrite them in run_demo_inputs.
+ */
+s32 osContInit(UNUSED OSMesgQueue *mq, u8 *bitpattern, OSContStatus *status) {
+    *bitpattern = 1;
+    status->type = CONT_TYPE_NORMAL;
+    status->status = 0;
+    status->errnum = 0;
+    return 0;
+}
+
+s32 osContStartReadData(OSMesgQueue *mq) {
+    osSendMesg(mq, NULL, OS_MESG_NOBLOCK);
+    return 0;
+}
+
+void osContGetReadData(OSContPad *pad) {
+    pad->button = 0;
+    pad->stick_x = 0;
+    pad->stick_y = 0;
+    pad->errnum = 0;
+}
+
+/**
+ * There is no EEPROM, so every save file fails its checksum and starts empty.
+ */
+s32 osEepromProbe(UNUSED OSMesgQueue *mq) {
+    return 1;
+}
+
+s32 osEepromLongRead(UNUSED OSMesgQueue *mq, UNUSED u8 address, u8 *buffer, int nbytes) {
+    memset(buffer, 0, nbytes);
+    return 0;
+}
+
+s32 osEepromLongWrite(UNUSED OSMesgQueue *mq, UNUSED u8 address, UNUSED u8 *buffer, UNUSED int nbytes) {
+    return 0;
+}
+
+#ifdef VERSION_SH
+// There is no Rumble Pak.
+u32 osMotorInit(UNUSED OSMesgQueue *mq, UNUSED void *pfs, UNUSED s32 channel) {
+    return 1;
+}
+
+s32 osMotorStart(UNUSED void *pfs) {
+    return 0;
+}
+
+s32 osMotorStop(UNUSED void *pfs) {
+    return 0;
+}
+#endif
@@ -10,6 +10,8 @@
 #include <stdlib.h>
 #include <stdarg.h>
 
+#include "vadpcm.h"
+
 typedef signed char s8;
 typedef short s16;
 typedef int s32;
@@ -93,7 +95,7 @@ typedef struct
 } ALADPCMloop;
 
 
-static char usage[] = "input.aifc output.aiff";
+static char usage[] = "[-v] input.aifc output.aiff";
 static const char *progname, *infilename;
 
 #define checked_fread(a, b, c, d) if (fread(a, b, c, d) != c) fail_parse("error parsing file")
@@ -389,6 +391,8 @@ int main(int argc, char **argv)
     ALADPCMloop *aloops = NULL;
     s16 npredictors = -1;
     s32 ***coefTable = NULL;
+    vadpcm_book_t book;
+    s32 verify = 0;
     s32 state[16];
     s32 soundPointer = -1;
     s32 currPos = 0;
@@ -402,6 +406,13 @@ int main(int argc, char **argv)
     FILE *ofile;
     progname = argv[0];
 
+    // -v: check every frame against the reference decoder
+    if (argc > 1 && strcmp(argv[1], "-v") == 0) {
+        verify = 1;
+        argc--;
+        argv++;
+    }
+
     if (argc < 3) {
         fprintf(stderr, "%s %s\n", progname, usage);
         exit(1);
@@ -522,6 +533,19 @@ int main(int argc, char **argv)
         fail_parse("Codebook missing from bitstream");
     }
 
+    s16 *entries = malloc(npredictors * order * 8 * sizeof(s16));
+    for (s32 i = 0; i < npredictors; i++) {
+        for (s32 j = 0; j < order; j++) {
+            for (s32 k = 0; k < 8; k++) {
+                entries[(i * order + j) * 8 + k] = coefTable[i][k][j];
+            }
+        }
+    }
+    if (!vadpcm_book_init(&book, entries, order, npredictors)) {
+        fail_parse("codebook has order %d and %d predictors, which aren't supported", order, npredictors);
+    }
+    free(entries);
+
     for (s32 i = 0; i < order; i++) {
         state[15 - i] = 0;
     }
@@ -542,9 +566,20 @@ int main(int argc, char **argv)
         checked_fread(input, 9, 1, ifile);
 
         // Decode for real
-        my_decodeframe(input, state, order, coefTable);
+        if (!vadpcm_decode_frame(&book, input, state)) {
+            fail_parse("frame at sample %d uses predictor %d of %d", currPos, input[0] & 0xf, npredictors);
+        }
         memcpy(decoded, state, sizeof(lastState));
 
+        if (verify) {
+            s32 reference[16];
+            memcpy(reference, lastState, sizeof(lastState));
+            my_decodeframe(input, reference, order, coefTable);
+            if (memcmp(reference, decoded, sizeof(reference)) != 0) {
+                fail_parse("decoders disagree on the frame at sample %d", currPos);
+            }
+        }
+
         // Create a guess from that, by clamping to 16 bits
         for (s32 i = 0; i < 16; i++) {
             origGuess[i] = clamp_to_s16(state[i]);
@@ -1,7 +1,11 @@
 #!/usr/bin/env python3
 from collections import namedtuple, OrderedDict
 from json import JSONDecoder
+import concurrent.futures
+import copy
+import hashlib
 import os
+import pickle
 import re
 import struct
 import subprocess
@@ -24,6 +28,7 @@ class Aifc:
         self.name = name
         self.fname = fname
         self.data = data
+        self.size = len(data)
         self.sample_rate = sample_rate
         self.book = book
         self.loop = loop
@@ -45,6 +50,78 @@ class SampleBank:
 Book = namedtuple("Book", ["order", "npredictors", "table"])
 Loop = namedtuple("Loop", ["start", "end", "count", "state"])
 Bank = namedtuple("Bank", ["name", "sample_bank", "json"])
+SampleNames = namedtuple("SampleNames", ["name", "name_to_entry"])
+
+
+class Cache:
+    # Results of earlier runs, stored one per file and named by a hash of
+    # everything that went into them, including this script.
+    def __init__(self, dir):
+        self.dir = dir
+        self.used = set()
+        os.makedirs(dir, exist_ok=True)
+        with open(__file__, "rb") as f:
+            self.salt = f.read()
+
+    def key(self, kind, *parts):
+        h = hashlib.sha1(self.salt)
+        h.update(repr(parts).encode())
+        return kind + "-" + h.hexdigest()
+
+    def get(self, key):
+        self.used.add(key)
+        try:
+            with open(os.path.join(self.dir, key), "rb") as f:
+                return pickle.load(f)
+        except Exception:
+            return None
+
+    def put(self, key, value):
+        self.used.add(key)
+        path = os.path.join(self.dir, key)
+        with open(path + ".tmp", "wb") as f:
+            pickle.dump(value, f, pickle.HIGHEST_PROTOCOL)
+        os.replace(path + ".tmp", path)
+
+    def prune(self):
+        # Drop whatever this run didn't use, so the cache only holds one build.
+        for f in os.listdir(self.dir):
+            if f not in self.used:
+                os.remove(os.path.join(self.dir, f))
+
+
+class InlineExecutor:
+    # Stand-in for ProcessPoolExecutor that runs each job as it's submitted.
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        return False
+
+    def submit(self, fn, *args):
+        future = concurrent.futures.Future()
+        try:
+            future.set_result(fn(*args))
+        except Exception as e:
+            future.set_exception(e)
+        return future
+
+
+def init_worker(endian_marker, word_bytes):
+    global ENDIAN_MARKER
+    global WORD_BYTES
+    ENDIAN_MARKER = endian_marker
+    WORD_BYTES = word_bytes
+
+
+def make_executor(jobs):
+    if jobs <= 1:
+        return InlineExecutor()
+    return concurrent.futures.ProcessPoolExecutor(
+        max_workers=jobs,
+        initializer=init_worker,
+        initargs=(ENDIAN_MARKER, WORD_BYTES),
+    )
 
 
 def align(val, al):
@@ -553,7 +630,7 @@ def serialize_ctl(bank, base_ser, is_shindou):
             continue
         sample_name_to_addr[name] = ser.size
         aifc = bank.sample_bank.name_to_entry[name]
-        sample_len = len(aifc.data)
+        sample_len = aifc.size
 
         # Sample
         ser.add(pack("IX", align(sample_len, 2) if is_shindou else 0))
@@ -663,6 +740,63 @@ def serialize_ctl(bank, base_ser, is_shindou):
     )
 
 
+def load_bank(fname, cpp_command, defines, sample_names):
+    if cpp_command:
+        data = subprocess.run(
+            [cpp_command, fname] + ["-D" + x for x in defines],
+            stdout=subprocess.PIPE,
+            check=True,
+        ).stdout.decode()
+    else:
+        with open(fname, "r") as inf:
+            data = inf.read()
+        data = strip_comments(data)
+    bank_json = orderedJsonDecoder.decode(data)
+
+    defines_set = {d.split("=")[0] for d in defines}
+    bank_json = apply_ifs(bank_json, defines_set)
+    validate_bank_toplevel(bank_json)
+    apply_version_diffs(bank_json, defines_set)
+    normalize_sound_json(bank_json)
+
+    sample_bank_name = bank_json["sample_bank"]
+    validate(
+        sample_bank_name in sample_names,
+        "sample bank " + sample_bank_name + " not found",
+    )
+    validate_bank(
+        bank_json, SampleNames(sample_bank_name, sample_names[sample_bank_name])
+    )
+    return bank_json
+
+
+def sample_bank_layout(sample_bank):
+    # Copy of a sample bank with only what serialize_ctl reads, which leaves
+    # out the sample data so that it's cheap to hand to a worker.
+    layout = copy.copy(sample_bank)
+    layout.uses = [None] * len(sample_bank.uses)
+    layout.entries = []
+    layout.name_to_entry = {}
+    for e in sample_bank.entries:
+        e = copy.copy(e)
+        e.data = None
+        layout.entries.append(e)
+        layout.name_to_entry[e.name] = e
+    return layout
+
+
+def serialize_bank(bank, is_shindou):
+    ser = GarbageSerializer()
+    meta = serialize_ctl(bank, ser, is_shindou)
+    return ser.finish(), meta
+
+
+def add_serialized(entry, ser, is_shindou):
+    data, meta = entry
+    ser.add(data)
+    return meta
+
+
 def serialize_tbl(sample_bank, ser, is_shindou):
     ser.reset_garbage_pos()
     base_addr = ser.size
@@ -887,6 +1021,8 @@ def main():
     print_samples = False
     sequences_out_file = None
     sequences_header_out_file = None
+    cache_dir = None
+    jobs = 1
     defines = []
     args = []
     for i, a in enumerate(sys.argv[1:], 1):
@@ -929,6 +1065,18 @@ def main():
             DUMP_INDIVIDUAL_BINS = True
         elif a == "--print-samples":
             print_samples = True
+        elif a == "--cache":
+            cache_dir = sys.argv[i + 1]
+            skip_next = 1
+        elif a == "-j":
+            try:
+                jobs = int(sys.argv[i + 1])
+            except ValueError:
+                jobs = -1
+            if jobs < 0:
+                fail("-j takes a number of jobs, or 0 for one per CPU")
+            jobs = jobs or os.cpu_count() or 1
+            skip_next = 1
         elif a == "--sequences":
             sequences_out_file = sys.argv[i + 1]
             sequences_header_out_file = sys.argv[i + 2]
@@ -966,6 +1114,8 @@ def main():
             " [--cpp <preprocessor>]"
             " [-D <symbol>]"
             " [--stack-trace]"
+            " [--cache <dir>]"
+            " [-j <jobs>]"
             " | --sequences <out sequence .bin> <out Shindou sequence header .bin> "
             "<out bank sets .bin> <sound bank dir> <sequences.json> <inputs...>".format(
                 sys.argv[0]
@@ -1005,78 +1155,123 @@ def main():
             sample_banks.append(sample_bank)
             name_to_sample_bank[name] = sample_bank
 
+    # Banks are parsed and serialized independently, by worker processes if
+    # there are several jobs. With a cache, each result is reused for as long
+    # as its inputs stay the same: parsing depends on the bank's JSON and on
+    # the names of the samples, and serializing on the parsed JSON and on the
+    # layout of its sample bank.
+    cache = Cache(cache_dir) if cache_dir is not None else None
+    sample_names = {b.name: set(b.name_to_entry) for b in sample_banks}
+    sample_listing = [(b.name, sorted(b.name_to_entry)) for b in sample_banks]
     bank_names = sorted(os.listdir(sound_bank_dir))
-    for f in bank_names:
-        fname = os.path.join(sound_bank_dir, f)
-        if not f.endswith(".json"):
-            continue
-
-        try:
-            if cpp_command:
-                data = subprocess.run(
-                    [cpp_command, fname] + ["-D" + x for x in defines],
-                    stdout=subprocess.PIPE,
-                    check=True,
-                ).stdout.decode()
-            else:
-                with open(fname, "r") as inf:
-                    data = inf.read()
-                data = strip_comments(data)
-            bank_json = orderedJsonDecoder.decode(data)
+    bank_jsons = {}
+    bank_keys = {}
+    with make_executor(jobs) as executor:
+        load_jobs = []
+        for f in bank_names:
+            fname = os.path.join(sound_bank_dir, f)
+            if not f.endswith(".json"):
+                continue
 
-            bank_json = apply_ifs(bank_json, defines_set)
-            validate_bank_toplevel(bank_json)
-            apply_version_diffs(bank_json, defines_set)
-            normalize_sound_json(bank_json)
+            # Banks that go through the preprocessor can include other files,
+            # so only their serialized form is cached.
+            key = None
+            if cache is not None and not cpp_command:
+                with open(fname, "rb") as inf:
+                    key = cache.key("bank", inf.read(), defines, sample_listing)
+                bank_keys[f] = key
+                bank_jsons[f] = cache.get(key)
+                if bank_jsons[f] is not None:
+                    continue
 
-            sample_bank_name = bank_json["sample_bank"]
-            validate(
-                sample_bank_name in name_to_sample_bank,
-                "sample bank " + sample_bank_name + " not found",
-            )
-            sample_bank = name_to_sample_bank[sample_bank_name]
+            job = executor.submit(load_bank, fname, cpp_command, defines, sample_names)
+            load_jobs.append((fname, f, key, job))
 
-            validate_bank(bank_json, sample_bank)
+        for fname, f, key, job in load_jobs:
+            try:
+                bank_jsons[f] = job.result()
+            except Exception as e:
+                fail("failed to parse bank " + fname + ": " + str(e))
+            if key is not None:
+                cache.put(key, bank_jsons[f])
+
+        # The key of a bank's parsed JSON stands in for the JSON itself.
+        json_keys = []
+        for f in bank_names:
+            if f in bank_jsons:
+                bank_json = bank_jsons[f]
+                sample_bank = name_to_sample_bank[bank_json["sample_bank"]]
+                bank = Bank(f[:-5], sample_bank, bank_json)
+                mark_sample_bank_uses(bank)
+                banks.append(bank)
+                json_keys.append(bank_keys.get(f) or bank_json)
+
+        sample_banks = [b for b in sample_banks if b.uses]
+        sample_banks.sort(key=lambda b: b.uses[0].name)
+        sample_bank_index = 0
+        for sample_bank in sample_banks:
+            sample_bank.index = sample_bank_index
+            sample_bank_index += 1
+
+        serialize_seqfile(
+            tbl_data_out,
+            tbl_data_header_out,
+            sample_banks,
+            serialize_tbl,
+            [x.sample_bank.index for x in banks],
+            TYPE_TBL,
+            is_shindou,
+        )
 
-            bank = Bank(f[:-5], sample_bank, bank_json)
-            mark_sample_bank_uses(bank)
-            banks.append(bank)
+        layouts = {b.name: sample_bank_layout(b) for b in sample_banks}
+        ctl_entries = [None] * len(banks)
+        ctl_jobs = []
+        for i, bank in enumerate(banks):
+            layout = layouts[bank.sample_bank.name]
+            key = None
+            if cache is not None:
+                key = cache.key(
+                    "ctl",
+                    json_keys[i],
+                    is_shindou,
+                    ENDIAN_MARKER,
+                    WORD_BYTES,
+                    layout.index,
+                    len(layout.uses),
+                    [
+                        (e.name, e.size, e.offset, e.sample_rate, e.book, e.loop)
+                        for e in layout.entries
+                    ],
+                )
+                ctl_entries[i] = cache.get(key)
+                if ctl_entries[i] is not None:
+                    continue
 
-        except Exception as e:
-            fail("failed to parse bank " + fname + ": " + str(e))
+            layout_bank = Bank(bank.name, layout, bank.json)
+            job = executor.submit(serialize_bank, layout_bank, is_shindou)
+            ctl_jobs.append((i, key, job))
 
-    sample_banks = [b for b in sample_banks if b.uses]
-    sample_banks.sort(key=lambda b: b.uses[0].name)
-    sample_bank_index = 0
-    for sample_bank in sample_banks:
-        sample_bank.index = sample_bank_index
-        sample_bank_index += 1
+        for i, key, job in ctl_jobs:
+            ctl_entries[i] = job.result()
+            if key is not None:
+                cache.put(key, ctl_entries[i])
 
-    serialize_seqfile(
-        tbl_data_out,
-        tbl_data_header_out,
-        sample_banks,
-        serialize_tbl,
-        [x.sample_bank.index for x in banks],
-        TYPE_TBL,
-        is_shindou,
-    )
+    if cache is not None:
+        cache.prune()
 
     if DUMP_INDIVIDUAL_BINS:
         # Debug logic, may simplify diffing
         os.makedirs("ctl/", exist_ok=True)
-        for b in banks:
+        for b, (data, meta) in zip(banks, ctl_entries):
             with open("ctl/" + b.name + ".bin", "wb") as f:
-                ser = GarbageSerializer()
-                serialize_ctl(b, ser, is_shindou)
-                f.write(ser.finish())
+                f.write(data)
         print("wrote to ctl/")
 
     serialize_seqfile(
         ctl_data_out,
         ctl_data_header_out,
-        banks,
-        serialize_ctl,
+        ctl_entries,
+        add_serialized,
         list(range(len(banks))),
         TYPE_CTL,
         is_shindou,
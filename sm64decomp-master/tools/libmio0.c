@@ -6,6 +6,11 @@
 #include <fcntl.h>
 #endif
 
+#ifdef MIO0_STANDALONE
+#include <pthread.h>
+#include <time.h>
+#endif
+
 #include "libmio0.h"
 #include "utils.h"
 
@@ -13,8 +18,6 @@
 
 #define MIO0_VERSION "0.1"
 
-#define GET_BIT(buf, bit) ((buf)[(bit) / 8] & (1 << (7 - ((bit) % 8))))
-
 // types
 typedef struct
 {
@@ -64,13 +67,14 @@ static void PUT_BIT(unsigned char *buf, int bit, int val)
    buf[offset] = (buf[offset] & ~(mask)) | (val ? mask : 0);
 }
 
-// used to find longest matching stream in buffer
+// used to find longest matching stream in buffer by checking every earlier
+// occurrence of its first byte
 // buf: buffer
 // start_offset: offset in buf to look back from
 // max_search: max number of bytes to find
 // found_offset: returned offset found (0 if none found)
 // returns max length of matching stream (0 if none found)
-static int find_longest(const unsigned char *buf, int start_offset, int max_search, int *found_offset, lookback *lkbk)
+static int find_longest_lookback(const unsigned char *buf, int start_offset, int max_search, int *found_offset, lookback *lkbk)
 {
    int best_length = 0;
    int best_offset = 0;
@@ -125,6 +129,128 @@ static int find_longest(const unsigned char *buf, int start_offset, int max_sear
    return best_length;
 }
 
+// hash chains index every position by its first three bytes, which any match
+// worth encoding shares with its source. each chain runs from oldest to newest
+// position so that the search can stop at the first longest match, which is
+// the one find_longest_lookback picks among matches of equal length
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define HASH_NONE -1
+
+typedef struct
+{
+   const unsigned char *buf;
+   int length;
+   int *first;    // oldest position in each chain that may be in the window
+   int *last;     // newest position in each chain
+   int *next;     // next newer position in the same chain
+   int inserted;  // positions below this are in the chains
+   lookback *lookbacks; // used instead of the chains by the reference encoder
+} match_finder;
+
+static inline unsigned int hash3(const unsigned char *buf)
+{
+   unsigned int key = ((unsigned int)buf[0] << 16) | (buf[1] << 8) | buf[2];
+   return (key * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static void match_finder_init(match_finder *mf, const unsigned char *buf, int length, int reference)
+{
+   int i;
+   memset(mf, 0, sizeof(*mf));
+   mf->buf = buf;
+   mf->length = length;
+   if (reference) {
+      mf->lookbacks = lookback_init();
+      return;
+   }
+   mf->first = malloc(HASH_SIZE * sizeof(*mf->first));
+   mf->last = malloc(HASH_SIZE * sizeof(*mf->last));
+   mf->next = malloc(length * sizeof(*mf->next));
+   for (i = 0; i < HASH_SIZE; i++) {
+      mf->first[i] = HASH_NONE;
+   }
+}
+
+static void match_finder_free(match_finder *mf)
+{
+   if (mf->lookbacks) {
+      lookback_free(mf->lookbacks);
+   }
+   free(mf->first);
+   free(mf->last);
+   free(mf->next);
+}
+
+// record that the byte at index has been passed; the hash chains catch up
+// lazily in find_longest instead
+static inline void match_finder_push(match_finder *mf, int index)
+{
+   if (mf->lookbacks) {
+      lookback_push(mf->lookbacks, mf->buf[index], index);
+   }
+}
+
+// same as find_longest_lookback for matches of 3 or more bytes, which are
+// the only ones the encoder uses; shorter ones are reported as no match
+static int find_longest(match_finder *mf, int start_offset, int max_search, int *found_offset)
+{
+   const unsigned char *buf = mf->buf;
+   const unsigned char *start = &buf[start_offset];
+   int best_length = 0;
+   int best_offset = 0;
+   int farthest;
+   int off;
+   int i;
+   unsigned int h;
+
+   if (mf->lookbacks) {
+      return find_longest_lookback(buf, start_offset, max_search, found_offset, mf->lookbacks);
+   }
+
+   if (max_search < 3) {
+      *found_offset = 0;
+      return 0;
+   }
+
+   // add the positions passed since the last search
+   for ( ; mf->inserted < start_offset; mf->inserted++) {
+      off = mf->inserted;
+      if (off + 3 > mf->length) {
+         continue;
+      }
+      h = hash3(&buf[off]);
+      if (mf->first[h] == HASH_NONE) {
+         mf->first[h] = off;
+      } else {
+         mf->next[mf->last[h]] = off;
+      }
+      mf->last[h] = off;
+      mf->next[off] = HASH_NONE;
+   }
+
+   // drop positions that have left the 4096 byte window
+   farthest = MAX(start_offset - 4096, 0);
+   h = hash3(start);
+   for (off = mf->first[h]; off != HASH_NONE && off < farthest; off = mf->next[off]) {}
+   mf->first[h] = off;
+
+   for ( ; off != HASH_NONE; off = mf->next[off]) {
+      // matches may run into the bytes they produce, like the decoder's copies
+      for (i = 0; i < max_search && buf[off + i] == start[i]; i++) {}
+      if (i > best_length) {
+         best_length = i;
+         best_offset = start_offset - off;
+         if (best_length == max_search) {
+            break;
+         }
+      }
+   }
+
+   *found_offset = best_offset;
+   return best_length;
+}
+
 // decode MIO0 header
 // returns 1 if valid header, 0 otherwise
 int mio0_decode_header(const unsigned char *buf, mio0_header_t *head)
@@ -146,54 +272,130 @@ void mio0_encode_header(unsigned char *buf, const mio0_header_t *head)
    write_u32_be(&buf[12], head->uncomp_offset);
 }
 
-int mio0_decode(const unsigned char *in, unsigned char *out, unsigned int *end)
+int mio0_stream_init(mio0_stream_t *stream, const unsigned char *in, unsigned char *out)
 {
-   mio0_header_t head;
-   unsigned int bytes_written = 0;
-   int bit_idx = 0;
-   int comp_idx = 0;
-   int uncomp_idx = 0;
-   int valid;
+   if (!mio0_decode_header(in, &stream->head)) {
+      return 0;
+   }
+   stream->in = in;
+   stream->out = out;
+   stream->bytes_written = 0;
+   stream->bit_idx = MIO0_HEADER_LENGTH;
+   stream->comp_idx = stream->head.comp_offset;
+   stream->uncomp_idx = stream->head.uncomp_offset;
+   stream->bits = 0;
+   stream->bits_left = 0;
+   stream->match_length = 0;
+   stream->match_offset = 0;
+   return 1;
+}
 
-   // extract header
-   valid = mio0_decode_header(in, &head);
-   // verify MIO0 header
-   if (!valid) {
-      return -2;
+// copy a lookback match of 'length' bytes from 'offset' bytes back
+// matches that don't overlap their source are copied with a single memcpy,
+// ones that do are copied in chunks no longer than the offset
+static inline void mio0_copy_match(unsigned char *out, unsigned int offset, unsigned int length)
+{
+   const unsigned char *src = out - offset;
+   if (offset >= length) {
+      memcpy(out, src, length);
+   } else if (offset >= 8) {
+      while (length >= 8) {
+         memcpy(out, src, 8);
+         out += 8;
+         src += 8;
+         length -= 8;
+      }
+      memcpy(out, src, length);
+   } else {
+      while (length--) {
+         *out++ = *src++;
+      }
    }
+}
 
-   // decode data
-   while (bytes_written < head.dest_size) {
-      if (GET_BIT(&in[MIO0_HEADER_LENGTH], bit_idx)) {
+unsigned int mio0_stream_decode(mio0_stream_t *stream, unsigned int max_bytes)
+{
+   const unsigned char *in = stream->in;
+   unsigned char *out = stream->out;
+   unsigned int bytes_written = stream->bytes_written;
+   unsigned int limit = stream->head.dest_size;
+   unsigned int bit_idx = stream->bit_idx;
+   unsigned int comp_idx = stream->comp_idx;
+   unsigned int uncomp_idx = stream->uncomp_idx;
+   unsigned int bits = stream->bits;
+   int bits_left = stream->bits_left;
+   unsigned int length;
+
+   if (max_bytes < limit - bytes_written) {
+      limit = bytes_written + max_bytes;
+   }
+
+   // finish a match that the previous call stopped in the middle of
+   if (stream->match_length > 0) {
+      length = MIN(stream->match_length, limit - bytes_written);
+      mio0_copy_match(&out[bytes_written], stream->match_offset, length);
+      bytes_written += length;
+      stream->match_length -= length;
+   }
+
+   while (bytes_written < limit) {
+      // layout bits are consumed 32 at a time, most significant first
+      if (bits_left == 0) {
+         bits = ((unsigned int)in[bit_idx] << 24) | (in[bit_idx + 1] << 16) |
+                (in[bit_idx + 2] << 8) | in[bit_idx + 3];
+         bit_idx += 4;
+         bits_left = 32;
+      }
+      if (bits & 0x80000000) {
          // 1 - pull uncompressed data
-         out[bytes_written] = in[head.uncomp_offset + uncomp_idx];
-         bytes_written++;
-         uncomp_idx++;
+         out[bytes_written++] = in[uncomp_idx++];
       } else {
          // 0 - read compressed data
-         int idx;
-         int length;
-         int i;
-         const unsigned char *vals = &in[head.comp_offset + comp_idx];
+         const unsigned char *vals = &in[comp_idx];
+         unsigned int offset = ((vals[0] & 0x0F) << 8) + vals[1] + 1;
          comp_idx += 2;
          length = ((vals[0] & 0xF0) >> 4) + 3;
-         idx = ((vals[0] & 0x0F) << 8) + vals[1] + 1;
-         for (i = 0; i < length; i++) {
-            out[bytes_written] = out[bytes_written - idx];
-            bytes_written++;
+         if (length > limit - bytes_written) {
+            stream->match_length = length - (limit - bytes_written);
+            stream->match_offset = offset;
+            length = limit - bytes_written;
          }
+         mio0_copy_match(&out[bytes_written], offset, length);
+         bytes_written += length;
       }
-      bit_idx++;
+      bits <<= 1;
+      bits_left--;
    }
 
+   max_bytes = bytes_written - stream->bytes_written;
+   stream->bytes_written = bytes_written;
+   stream->bit_idx = bit_idx;
+   stream->comp_idx = comp_idx;
+   stream->uncomp_idx = uncomp_idx;
+   stream->bits = bits;
+   stream->bits_left = bits_left;
+   return max_bytes;
+}
+
+int mio0_decode(const unsigned char *in, unsigned char *out, unsigned int *end)
+{
+   mio0_stream_t stream;
+
+   // extract and verify header
+   if (!mio0_stream_init(&stream, in, out)) {
+      return -2;
+   }
+
+   mio0_stream_decode(&stream, stream.head.dest_size);
+
    if (end) {
-      *end = head.uncomp_offset + uncomp_idx;
+      *end = stream.uncomp_idx;
    }
 
-   return bytes_written;
+   return stream.bytes_written;
 }
 
-int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out)
+static int mio0_encode_with(const unsigned char *in, unsigned int length, unsigned char *out, int reference)
 {
    unsigned char *bit_buf;
    unsigned char *comp_buf;
@@ -206,10 +408,10 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    int bit_idx = 0;
    int comp_idx = 0;
    int uncomp_idx = 0;
-   lookback *lookbacks;
+   match_finder finder;
 
-   // initialize lookback buffer
-   lookbacks = lookback_init();
+   // initialize match finder
+   match_finder_init(&finder, in, length, reference);
 
    // allocate some temporary buffers worst case size
    bit_buf = malloc((length + 7) / 8); // 1-bit/byte
@@ -219,7 +421,7 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
 
    // encode data
    // special case for first byte
-   lookback_push(lookbacks, in[0], 0);
+   match_finder_push(&finder, 0);
    uncomp_buf[uncomp_idx] = in[0];
    uncomp_idx += 1;
    bytes_proc += 1;
@@ -227,14 +429,14 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    while (bytes_proc < length) {
       int offset;
       int max_length = MIN(length - bytes_proc, 18);
-      int longest_match = find_longest(in, bytes_proc, max_length, &offset, lookbacks);
+      int longest_match = find_longest(&finder, bytes_proc, max_length, &offset);
       // push current byte before checking next longer match
-      lookback_push(lookbacks, in[bytes_proc], bytes_proc);
+      match_finder_push(&finder, bytes_proc);
       if (longest_match > 2) {
          int lookahead_offset;
          // lookahead to next byte to see if longer match
          int lookahead_length = MIN(length - bytes_proc - 1, 18);
-         int lookahead_match = find_longest(in, bytes_proc + 1, lookahead_length, &lookahead_offset, lookbacks);
+         int lookahead_match = find_longest(&finder, bytes_proc + 1, lookahead_length, &lookahead_offset);
          // better match found, use uncompressed + lookahead compressed
          if ((longest_match + 1) < lookahead_match) {
             // uncompressed byte
@@ -245,11 +447,11 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
             longest_match = lookahead_match;
             offset = lookahead_offset;
             bit_idx++;
-            lookback_push(lookbacks, in[bytes_proc], bytes_proc);
+            match_finder_push(&finder, bytes_proc);
          }
          // first byte already pushed above
          for (int i = 1; i < longest_match; i++) {
-            lookback_push(lookbacks, in[bytes_proc + i], bytes_proc + i);
+            match_finder_push(&finder, bytes_proc + i);
          }
          // compressed block
          comp_buf[comp_idx] = (((longest_match - 3) & 0x0F) << 4) |
@@ -283,6 +485,8 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    write_u32_be(&out[12], uncomp_offset);
    // output data
    memcpy(&out[MIO0_HEADER_LENGTH], bit_buf, bit_length);
+   // zero the alignment padding, which would otherwise depend on what 'out' held before
+   memset(&out[MIO0_HEADER_LENGTH + bit_length], 0, comp_offset - (MIO0_HEADER_LENGTH + bit_length));
    memcpy(&out[comp_offset], comp_buf, comp_idx);
    memcpy(&out[uncomp_offset], uncomp_buf, uncomp_idx);
 
@@ -290,11 +494,16 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    free(bit_buf);
    free(comp_buf);
    free(uncomp_buf);
-   lookback_free(lookbacks);
+   match_finder_free(&finder);
 
    return bytes_written;
 }
 
+int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out)
+{
+   return mio0_encode_with(in, length, out, 0);
+}
+
 static FILE *mio0_open_out_file(const char *out_file) {
    if (strcmp(out_file, "-") == 0) {
 #if defined(_WIN32) || defined(_WIN64)
@@ -449,32 +658,211 @@ free_all:
 
 // mio0 standalone executable
 #ifdef MIO0_STANDALONE
+#define GET_BIT(buf, bit) ((buf)[(bit) / 8] & (1 << (7 - ((bit) % 8))))
+
+// byte at a time decoder that mio0_decode is verified against
+static void mio0_decode_reference(const unsigned char *in, const mio0_header_t *head, unsigned char *out)
+{
+   unsigned int bytes_written = 0;
+   int bit_idx = 0;
+   int comp_idx = 0;
+   int uncomp_idx = 0;
+
+   while (bytes_written < head->dest_size) {
+      if (GET_BIT(&in[MIO0_HEADER_LENGTH], bit_idx)) {
+         out[bytes_written] = in[head->uncomp_offset + uncomp_idx];
+         bytes_written++;
+         uncomp_idx++;
+      } else {
+         int idx;
+         int length;
+         int i;
+         const unsigned char *vals = &in[head->comp_offset + comp_idx];
+         comp_idx += 2;
+         length = ((vals[0] & 0xF0) >> 4) + 3;
+         idx = ((vals[0] & 0x0F) << 8) + vals[1] + 1;
+         for (i = 0; i < length; i++) {
+            out[bytes_written] = out[bytes_written - idx];
+            bytes_written++;
+         }
+      }
+      bit_idx++;
+   }
+}
+
+// decode every MIO0 block found in a file with the reference decoder, with
+// mio0_decode and with mio0_stream_decode in several step sizes, and check
+// that they all agree
+// returns 0 if they do, 6 on a mismatch or a mio0_decode_file error code
+static int mio0_verify_file(const char *in_file)
+{
+   static const unsigned int step_sizes[] = { 1, 3, 17, 4096 };
+   mio0_header_t head;
+   mio0_stream_t stream;
+   FILE *in;
+   unsigned char *in_buf;
+   unsigned char *ref_buf;
+   unsigned char *out_buf;
+   long file_size;
+   long offset;
+   unsigned int i;
+   int block_count = 0;
+   int mismatch_count = 0;
+   int ret_val = 0;
+
+   in = fopen(in_file, "rb");
+   if (in == NULL) {
+      return 1;
+   }
+   fseek(in, 0, SEEK_END);
+   file_size = ftell(in);
+   fseek(in, 0, SEEK_SET);
+   in_buf = malloc(file_size);
+   if (fread(in_buf, 1, file_size, in) != (size_t)file_size) {
+      free(in_buf);
+      fclose(in);
+      return 2;
+   }
+   fclose(in);
+
+   // MIO0 blocks are 4-byte aligned in the ROM and in the assets
+   for (offset = 0; offset + MIO0_HEADER_LENGTH <= file_size; offset += 4) {
+      if (!mio0_decode_header(&in_buf[offset], &head)) {
+         continue;
+      }
+      if (head.comp_offset < MIO0_HEADER_LENGTH || head.comp_offset > head.uncomp_offset ||
+          head.uncomp_offset > file_size - offset || head.dest_size > 16 * MB) {
+         continue;
+      }
+      ref_buf = malloc(head.dest_size);
+      out_buf = malloc(head.dest_size);
+      mio0_decode_reference(&in_buf[offset], &head, ref_buf);
+      block_count++;
+
+      memset(out_buf, 0, head.dest_size);
+      if (mio0_decode(&in_buf[offset], out_buf, NULL) != (int)head.dest_size ||
+          memcmp(ref_buf, out_buf, head.dest_size) != 0) {
+         ERROR("Mismatch decoding MIO0 block at 0x%lX\n", offset);
+         mismatch_count++;
+      }
+      for (i = 0; i < DIM(step_sizes); i++) {
+         memset(out_buf, 0, head.dest_size);
+         mio0_stream_init(&stream, &in_buf[offset], out_buf);
+         while (stream.bytes_written < head.dest_size) {
+            mio0_stream_decode(&stream, step_sizes[i]);
+         }
+         if (memcmp(ref_buf, out_buf, head.dest_size) != 0) {
+            ERROR("Mismatch decoding MIO0 block at 0x%lX in steps of %u bytes\n", offset, step_sizes[i]);
+            mismatch_count++;
+         }
+      }
+      free(ref_buf);
+      free(out_buf);
+   }
+   free(in_buf);
+
+   printf("%d MIO0 blocks checked, %d mismatches\n", block_count, mismatch_count);
+   if (mismatch_count > 0) {
+      ret_val = 6;
+   }
+   return ret_val;
+}
+
+// run fn(ctx, 0) to fn(ctx, count - 1) on up to 'jobs' threads
 typedef struct
 {
-   char *in_filename;
-   char *out_filename;
+   void (*fn)(void *ctx, int index);
+   void *ctx;
+   int count;
+   int next;
+   pthread_mutex_t lock;
+} work_queue;
+
+static void *work_queue_thread(void *arg)
+{
+   work_queue *queue = arg;
+   int index;
+
+   for (;;) {
+      pthread_mutex_lock(&queue->lock);
+      index = queue->next++;
+      pthread_mutex_unlock(&queue->lock);
+      if (index >= queue->count) {
+         return NULL;
+      }
+      queue->fn(queue->ctx, index);
+   }
+}
+
+static void run_parallel(int count, int jobs, void (*fn)(void *ctx, int index), void *ctx)
+{
+   pthread_t *threads;
+   work_queue queue;
+   int i;
+
+   queue.fn = fn;
+   queue.ctx = ctx;
+   queue.count = count;
+   queue.next = 0;
+   pthread_mutex_init(&queue.lock, NULL);
+
+   jobs = MIN(jobs, count);
+   threads = malloc(jobs * sizeof(*threads));
+   for (i = 0; i < jobs; i++) {
+      pthread_create(&threads[i], NULL, work_queue_thread, &queue);
+   }
+   for (i = 0; i < jobs; i++) {
+      pthread_join(threads[i], NULL);
+   }
+   free(threads);
+   pthread_mutex_destroy(&queue.lock);
+}
+
+static double wall_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct
+{
+   char **files;
+   int file_count;
    unsigned int offset;
    int compress;
+   int verify;
+   int benchmark;
+   int jobs;
 } arg_config;
 
 static arg_config default_config =
 {
    NULL,
-   NULL,
+   0,
+   0,
+   1,
+   0,
    0,
    1
 };
 
 static void print_usage(void)
 {
-   ERROR("Usage: mio0 [-c / -d] [-o OFFSET] FILE [OUTPUT]\n"
+   ERROR("Usage: mio0 [-c / -d / -v] [-o OFFSET] FILE [OUTPUT]\n"
+         "       mio0 [-c / -d] -j JOBS FILE OUTPUT [FILE OUTPUT ...]\n"
+         "       mio0 -b [-j JOBS] FILE [FILE ...]\n"
          "\n"
          "mio0 v" MIO0_VERSION ": MIO0 compression and decompression tool\n"
          "\n"
          "Optional arguments:\n"
          " -c           compress raw data into MIO0 (default: compress)\n"
          " -d           decompress MIO0 into raw data\n"
+         " -v           verify the decoder against a reference on every MIO0 block in FILE\n"
          " -o OFFSET    starting offset in FILE (default: 0)\n"
+         " -j JOBS      process several FILE OUTPUT pairs on JOBS threads\n"
+         " -b           compare the encoder with the reference encoder on each FILE,\n"
+         "              and time compressing them all on JOBS threads\n"
          "\n"
          "File arguments:\n"
          " FILE        input file\n"
@@ -486,11 +874,11 @@ static void print_usage(void)
 static void parse_arguments(int argc, char *argv[], arg_config *config)
 {
    int i;
-   int file_count = 0;
    if (argc < 2) {
       print_usage();
       exit(1);
    }
+   config->files = malloc(argc * sizeof(*config->files));
    for (i = 1; i < argc; i++) {
       if (argv[i][0] == '-' && argv[i][1] != '\0') {
          switch (argv[i][1]) {
@@ -500,76 +888,251 @@ static void parse_arguments(int argc, char *argv[], arg_config *config)
             case 'd':
                config->compress = 0;
                break;
+            case 'v':
+               config->verify = 1;
+               break;
+            case 'b':
+               config->benchmark = 1;
+               break;
             case 'o':
                if (++i >= argc) {
                   print_usage();
                }
                config->offset = strtoul(argv[i], NULL, 0);
                break;
+            case 'j':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->jobs = strtoul(argv[i], NULL, 0);
+               if (config->jobs < 1) {
+                  print_usage();
+               }
+               break;
             default:
                print_usage();
                break;
          }
       } else {
-         switch (file_count) {
-            case 0:
-               config->in_filename = argv[i];
-               break;
-            case 1:
-               config->out_filename = argv[i];
-               break;
-            default: // too many
-               print_usage();
-               break;
-         }
-         file_count++;
+         config->files[config->file_count++] = argv[i];
       }
    }
-   if (file_count < 1) {
+   if (config->file_count < 1) {
       print_usage();
    }
+   if (!config->benchmark) {
+      if (config->jobs > 1 ? (config->file_count % 2) != 0 : config->file_count > 2) {
+         print_usage();
+      }
+   }
+}
+
+static void print_error(int ret_val, const arg_config *config, const char *in_file, const char *out_file)
+{
+   switch (ret_val) {
+      case 1:
+         ERROR("Error opening input file \"%s\"\n", in_file);
+         break;
+      case 2:
+         ERROR("Error reading from input file \"%s\"\n", in_file);
+         break;
+      case 3:
+         ERROR("Error decoding MIO0 data. Wrong offset (0x%X)?\n", config->offset);
+         break;
+      case 4:
+         ERROR("Error opening output file \"%s\"\n", out_file);
+         break;
+      case 5:
+         ERROR("Error writing bytes to output file \"%s\"\n", out_file);
+         break;
+      case 6:
+         ERROR("MIO0 decoder does not match the reference in \"%s\"\n", in_file);
+         break;
+   }
+}
+
+typedef struct
+{
+   const arg_config *config;
+   int *ret_vals;
+} file_jobs;
+
+static void process_file_pair(void *ctx, int index)
+{
+   file_jobs *jobs = ctx;
+   const arg_config *config = jobs->config;
+   const char *in_file = config->files[2 * index];
+   const char *out_file = config->files[2 * index + 1];
+
+   if (config->compress) {
+      jobs->ret_vals[index] = mio0_encode_file(in_file, out_file);
+   } else {
+      jobs->ret_vals[index] = mio0_decode_file(in_file, config->offset, out_file);
+   }
+}
+
+typedef struct
+{
+   unsigned char **in_bufs;
+   unsigned int *in_sizes;
+   unsigned char **out_bufs;
+   int *out_sizes;
+   int reference;
+} bench_set;
+
+static void bench_encode(void *ctx, int index)
+{
+   bench_set *set = ctx;
+   set->out_sizes[index] = mio0_encode_with(set->in_bufs[index], set->in_sizes[index],
+                                            set->out_bufs[index], set->reference);
+}
+
+// compress every file with the reference and hash chain encoders, and with
+// the hash chain encoder on 'jobs' threads, reporting times and sizes
+static int mio0_benchmark(const arg_config *config)
+{
+   bench_set ref_set;
+   bench_set set;
+   FILE *in;
+   unsigned long total_in = 0;
+   unsigned long total_ref = 0;
+   unsigned long total_out = 0;
+   double start;
+   double ref_time;
+   double time;
+   int count = config->file_count;
+   int mismatch_count = 0;
+   int i;
+
+   ref_set.in_bufs = malloc(count * sizeof(*ref_set.in_bufs));
+   ref_set.in_sizes = malloc(count * sizeof(*ref_set.in_sizes));
+   ref_set.out_bufs = malloc(count * sizeof(*ref_set.out_bufs));
+   ref_set.out_sizes = malloc(count * sizeof(*ref_set.out_sizes));
+   ref_set.reference = 1;
+   set = ref_set;
+   set.out_bufs = malloc(count * sizeof(*set.out_bufs));
+   set.out_sizes = malloc(count * sizeof(*set.out_sizes));
+   set.reference = 0;
+
+   for (i = 0; i < count; i++) {
+      long file_size;
+      in = fopen(config->files[i], "rb");
+      if (in == NULL) {
+         print_error(1, config, config->files[i], NULL);
+         return 1;
+      }
+      fseek(in, 0, SEEK_END);
+      file_size = ftell(in);
+      fseek(in, 0, SEEK_SET);
+      // the encoder always reads the first byte
+      ref_set.in_bufs[i] = calloc(MAX(file_size, 1), 1);
+      ref_set.in_sizes[i] = file_size;
+      if (fread(ref_set.in_bufs[i], 1, file_size, in) != (size_t)file_size) {
+         fclose(in);
+         print_error(2, config, config->files[i], NULL);
+         return 2;
+      }
+      fclose(in);
+      ref_set.out_bufs[i] = malloc(MIO0_HEADER_LENGTH + ((file_size + 7) / 8) + file_size + 4);
+      set.out_bufs[i] = malloc(MIO0_HEADER_LENGTH + ((file_size + 7) / 8) + file_size + 4);
+      total_in += file_size;
+   }
+
+   start = wall_time();
+   for (i = 0; i < count; i++) {
+      bench_encode(&ref_set, i);
+      total_ref += ref_set.out_sizes[i];
+   }
+   ref_time = wall_time() - start;
+
+   start = wall_time();
+   for (i = 0; i < count; i++) {
+      bench_encode(&set, i);
+      total_out += set.out_sizes[i];
+      if (set.out_sizes[i] != ref_set.out_sizes[i] ||
+          memcmp(set.out_bufs[i], ref_set.out_bufs[i], set.out_sizes[i]) != 0) {
+         ERROR("Output differs from the reference encoder for \"%s\"\n", config->files[i]);
+         mismatch_count++;
+      }
+   }
+   time = wall_time() - start;
+
+   printf("%d files, %lu bytes\n", count, total_in);
+   printf("reference encoder:  %8.3f s, %lu bytes\n", ref_time, total_ref);
+   printf("hash chain encoder: %8.3f s, %lu bytes, %d outputs differ\n", time, total_out, mismatch_count);
+
+   if (config->jobs > 1) {
+      start = wall_time();
+      run_parallel(count, config->jobs, bench_encode, &set);
+      time = wall_time() - start;
+      printf("hash chain encoder: %8.3f s on %d threads\n", time, config->jobs);
+   }
+
+   for (i = 0; i < count; i++) {
+      free(ref_set.in_bufs[i]);
+      free(ref_set.out_bufs[i]);
+      free(set.out_bufs[i]);
+   }
+   free(ref_set.in_bufs);
+   free(ref_set.in_sizes);
+   free(ref_set.out_bufs);
+   free(ref_set.out_sizes);
+   free(set.out_bufs);
+   free(set.out_sizes);
+
+   return mismatch_count > 0 ? 7 : 0;
 }
 
 int main(int argc, char *argv[])
 {
    char out_filename[FILENAME_MAX];
+   char *in_filename;
+   char *out_filename_arg;
    arg_config config;
-   int ret_val;
+   file_jobs jobs;
+   int ret_val = 0;
+   int i;
 
    // get configuration from arguments
    config = default_config;
    parse_arguments(argc, argv, &config);
-   if (config.out_filename == NULL) {
-      config.out_filename = out_filename;
-      sprintf(config.out_filename, "%s.out", config.in_filename);
+
+   if (config.benchmark) {
+      return mio0_benchmark(&config);
+   }
+
+   if (config.jobs > 1) {
+      jobs.config = &config;
+      jobs.ret_vals = calloc(config.file_count / 2, sizeof(*jobs.ret_vals));
+      run_parallel(config.file_count / 2, config.jobs, process_file_pair, &jobs);
+      for (i = 0; i < config.file_count / 2; i++) {
+         if (jobs.ret_vals[i] != 0) {
+            print_error(jobs.ret_vals[i], &config, config.files[2 * i], config.files[2 * i + 1]);
+            ret_val = jobs.ret_vals[i];
+         }
+      }
+      free(jobs.ret_vals);
+      return ret_val;
+   }
+
+   in_filename = config.files[0];
+   out_filename_arg = config.file_count > 1 ? config.files[1] : NULL;
+   if (out_filename_arg == NULL) {
+      out_filename_arg = out_filename;
+      sprintf(out_filename_arg, "%s.out", in_filename);
    }
 
    // operation
-   if (config.compress) {
-      ret_val = mio0_encode_file(config.in_filename, config.out_filename);
+   if (config.verify) {
+      ret_val = mio0_verify_file(in_filename);
+   } else if (config.compress) {
+      ret_val = mio0_encode_file(in_filename, out_filename_arg);
    } else {
-      ret_val = mio0_decode_file(config.in_filename, config.offset, config.out_filename);
+      ret_val = mio0_decode_file(in_filename, config.offset, out_filename_arg);
    }
 
-   switch (ret_val) {
-      case 1:
-         ERROR("Error opening input file \"%s\"\n", config.in_filename);
-         break;
-      case 2:
-         ERROR("Error reading from input file \"%s\"\n", config.in_filename);
-         break;
-      case 3:
-         ERROR("Error decoding MIO0 data. Wrong offset (0x%X)?\n", config.offset);
-         break;
-      case 4:
-         ERROR("Error opening output file \"%s\"\n", config.out_filename);
-         break;
-      case 5:
-         ERROR("Error writing bytes to output file \"%s\"\n", config.out_filename);
-         break;
-   }
+   print_error(ret_val, &config, in_filename, out_filename_arg);
 
    return ret_val;
 }
 #endif // MIO0_STANDALONE
-
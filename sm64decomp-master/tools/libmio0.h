@@ -14,6 +14,22 @@ typedef struct
    unsigned int uncomp_offset;
 } mio0_header_t;
 
+// state of an incremental decode, see mio0_stream_init
+typedef struct
+{
+   const unsigned char *in;
+   unsigned char *out;
+   mio0_header_t head;
+   unsigned int bytes_written;
+   unsigned int bit_idx;
+   unsigned int comp_idx;
+   unsigned int uncomp_idx;
+   unsigned int bits;
+   int bits_left;
+   unsigned int match_length;
+   unsigned int match_offset;
+} mio0_stream_t;
+
 // function prototypes
 
 // decode MIO0 header
@@ -30,6 +46,20 @@ void mio0_encode_header(unsigned char *buf, const mio0_header_t *head);
 // returns bytes extracted to 'out' or negative value on failure
 int mio0_decode(const unsigned char *in, unsigned char *out, unsigned int *end);
 
+// start an incremental decode of MIO0 data in memory
+// stream: state to initialize
+// in: buffer containing MIO0 data, which must stay valid until the decode completes
+// out: buffer for output data, at least stream->head.dest_size bytes
+// returns 1 if valid header, 0 otherwise
+int mio0_stream_init(mio0_stream_t *stream, const unsigned char *in, unsigned char *out);
+
+// continue an incremental decode
+// stream: state from mio0_stream_init
+// max_bytes: maximum number of bytes to write to 'out' in this call
+// returns bytes written by this call; the decode is complete once
+// stream->bytes_written reaches stream->head.dest_size
+unsigned int mio0_stream_decode(mio0_stream_t *stream, unsigned int max_bytes);
+
 // encode MIO0 data in memory
 // in: buffer containing raw data
 // out: buffer for MIO0 data
@@ -5,8 +5,310 @@
 #include <getopt.h>
 #include "vadpcm.h"
 
+#ifdef __sgi
+
 static char usage[] = "[-t -l min_loop_length] -c codebook aifcfile compressedfile";
 
+#else
+
+#include <time.h>
+#include <unistd.h>
+#include "../../vadpcm.h"
+
+static char usage[] = "[-t -l min_loop_length] [-j threads] [-r] -c codebook aifcfile compressedfile\n"
+                      "       -b [-j threads] [-c codebook] aifffile...";
+
+// Frames are queued rather than encoded as they are read, so that a run of
+// them can be encoded at once, and split across threads if it is long.
+typedef struct
+{
+    s32 ***coefTable;
+    s32 order;
+    s32 npredictors;
+    // whether book holds the codebook; if not, frames are encoded with
+    // vencodeframe, which also takes codebooks with entries beyond 16 bits
+    s32 useBook;
+    vadpcm_book_t book;
+    s32 threads;
+    s16 *samples;
+    s32 nframes;
+    s32 allocated;
+} FrameQueue;
+
+static void initframequeue(FrameQueue *queue, s32 ***coefTable, s32 order, s32 npredictors, s32 reference, s32 threads)
+{
+    static s16 entries[VADPCM_MAX_PREDICTORS * VADPCM_MAX_ORDER * 8];
+    s32 i;
+    s32 j;
+    s32 k;
+
+    queue->coefTable = coefTable;
+    queue->order = order;
+    queue->npredictors = npredictors;
+    queue->useBook = !reference && order >= 1 && order <= VADPCM_MAX_ORDER &&
+                     npredictors >= 1 && npredictors <= VADPCM_MAX_PREDICTORS;
+    for (i = 0; i < npredictors && queue->useBook; i++)
+    {
+        for (j = 0; j < order; j++)
+        {
+            for (k = 0; k < 8; k++)
+            {
+                if (coefTable[i][k][j] < -0x8000 || coefTable[i][k][j] > 0x7fff)
+                {
+                    queue->useBook = 0;
+                }
+                entries[(i * order + j) * 8 + k] = coefTable[i][k][j];
+            }
+        }
+    }
+    if (queue->useBook)
+    {
+        vadpcm_book_init(&queue->book, entries, order, npredictors);
+    }
+    if (threads <= 0)
+    {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    queue->threads = threads;
+    queue->samples = NULL;
+    queue->nframes = 0;
+    queue->allocated = 0;
+}
+
+// Queue a frame of nsam samples, padded with zeroes to 16.
+static void queueframe(FrameQueue *queue, s16 *inBuffer, s32 nsam)
+{
+    s16 *frame;
+    s32 i;
+
+    if (queue->nframes == queue->allocated)
+    {
+        queue->allocated = queue->allocated ? queue->allocated * 2 : 1024;
+        queue->samples = realloc(queue->samples, queue->allocated * 16 * sizeof(s16));
+        if (queue->samples == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    frame = queue->samples + queue->nframes * 16;
+    for (i = 0; i < 16; i++)
+    {
+        frame[i] = i < nsam ? inBuffer[i] : 0;
+    }
+    queue->nframes++;
+}
+
+// Encode the queued frames to ofile, leaving state as after the last of them.
+static void flushframes(FILE *ofile, FrameQueue *queue, s32 *state)
+{
+    u8 *out;
+    s32 i;
+
+    if (queue->nframes == 0)
+    {
+        return;
+    }
+    if (queue->useBook)
+    {
+        out = malloc(queue->nframes * VADPCM_FRAME_BYTES);
+        if (out == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        vadpcm_encode(&queue->book, queue->samples, queue->nframes, state, out, queue->threads);
+        fwrite(out, VADPCM_FRAME_BYTES, queue->nframes, ofile);
+        free(out);
+    }
+    else
+    {
+        for (i = 0; i < queue->nframes; i++)
+        {
+            vencodeframe(ofile, queue->samples + i * 16, state, queue->coefTable, queue->order, queue->npredictors, 16);
+        }
+    }
+    queue->nframes = 0;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Read the samples of an AIFF file, and its codebook if it has one, as the
+// AIFFs that the build extracts to sound/samples do.
+static s32 readaiff(FILE *ifile, s16 **samples, s32 *nsamples, s32 ****coefTable, s16 *order, s16 *npredictors)
+{
+    Chunk FormChunk;
+    ChunkHeader Header;
+    s32 offset;
+    s16 version;
+    u8 strnLen;
+    char name[12];
+    u32 formType;
+
+    *samples = NULL;
+    *coefTable = NULL;
+    if (fread(&FormChunk, sizeof(Chunk), 1, ifile) != 1)
+    {
+        return 0;
+    }
+    BSWAP32(FormChunk.ckID)
+    if (FormChunk.ckID != 0x464f524d) // FORM
+    {
+        return 0;
+    }
+    while (fread(&Header, sizeof(ChunkHeader), 1, ifile) == 1)
+    {
+        BSWAP32(Header.ckID)
+        BSWAP32(Header.ckSize)
+        Header.ckSize++, Header.ckSize &= ~1;
+        offset = ftell(ifile);
+        if (Header.ckID == 0x53534e44 && Header.ckSize >= sizeof(SoundDataChunk)) // SSND
+        {
+            fseek(ifile, sizeof(SoundDataChunk), SEEK_CUR);
+            *nsamples = (Header.ckSize - sizeof(SoundDataChunk)) / sizeof(s16);
+            *samples = malloc(*nsamples * sizeof(s16) + 1);
+            *nsamples = fread(*samples, sizeof(s16), *nsamples, ifile);
+            BSWAP16_MANY(*samples, *nsamples)
+        }
+        else if (Header.ckID == 0x4150504c) // APPL
+        {
+            fread(&formType, sizeof(u32), 1, ifile);
+            BSWAP32(formType)
+            fread(&strnLen, 1, 1, ifile);
+            if (formType == 0x73746f63 && strnLen == 11) // stoc
+            {
+                fread(name, 11, 1, ifile);
+                name[11] = '\0';
+                fread(&version, sizeof(s16), 1, ifile);
+                BSWAP16(version)
+                if (strcmp(name, "VADPCMCODES") == 0 && version == 1)
+                {
+                    readaifccodebook(ifile, coefTable, order, npredictors);
+                }
+            }
+        }
+        fseek(ifile, offset + Header.ckSize, SEEK_SET);
+    }
+    return *samples != NULL;
+}
+
+// Encode whole files with vencodeframe, and with vadpcm_encode on one thread
+// and on several, check that all three give the same frames, and report how
+// fast each was.
+static s32 benchmark(char **files, s32 nfiles, s32 ***coefTable, s32 order, s32 npredictors, s32 threads)
+{
+    FrameQueue queues[3];
+    FILE *ifile;
+    FILE *tfile;
+    s16 *samples;
+    s32 nsamples;
+    s32 ***fileTable;
+    s16 fileOrder;
+    s16 fileNpredictors;
+    s32 state[16];
+    u8 *out[3];
+    double times[3] = {0.0, 0.0, 0.0};
+    double start;
+    long totalFrames = 0;
+    s32 nFrames;
+    s32 failed = 0;
+    s32 i;
+    s32 q;
+
+    if (threads <= 0)
+    {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    tfile = tmpfile();
+    for (i = 0; i < nfiles; i++)
+    {
+        if ((ifile = fopen(files[i], MODE_READ)) == NULL)
+        {
+            fprintf(stderr, "%s: could not be opened\n", files[i]);
+            failed = 1;
+            continue;
+        }
+        if (!readaiff(ifile, &samples, &nsamples, &fileTable, &fileOrder, &fileNpredictors))
+        {
+            fprintf(stderr, "%s: could not read samples\n", files[i]);
+            fclose(ifile);
+            failed = 1;
+            continue;
+        }
+        fclose(ifile);
+        if (coefTable == NULL && fileTable == NULL)
+        {
+            fprintf(stderr, "%s: no codebook, skipping\n", files[i]);
+            free(samples);
+            continue;
+        }
+        if (coefTable == NULL)
+        {
+            initframequeue(&queues[0], fileTable, fileOrder, fileNpredictors, 1, 1);
+            initframequeue(&queues[1], fileTable, fileOrder, fileNpredictors, 0, 1);
+            initframequeue(&queues[2], fileTable, fileOrder, fileNpredictors, 0, threads);
+        }
+        else
+        {
+            initframequeue(&queues[0], coefTable, order, npredictors, 1, 1);
+            initframequeue(&queues[1], coefTable, order, npredictors, 0, 1);
+            initframequeue(&queues[2], coefTable, order, npredictors, 0, threads);
+        }
+        for (nFrames = 0; nFrames * 16 < nsamples; nFrames++)
+        {
+            for (q = 0; q < 3; q++)
+            {
+                queueframe(&queues[q], samples + nFrames * 16, nsamples - nFrames * 16);
+            }
+        }
+
+        for (q = 0; q < 3; q++)
+        {
+            memset(state, 0, sizeof(state));
+            rewind(tfile);
+            start = seconds();
+            flushframes(tfile, &queues[q], state);
+            fflush(tfile);
+            times[q] += seconds() - start;
+            out[q] = malloc(nFrames * VADPCM_FRAME_BYTES + 1);
+            rewind(tfile);
+            fread(out[q], VADPCM_FRAME_BYTES, nFrames, tfile);
+            free(queues[q].samples);
+        }
+        if (memcmp(out[0], out[1], nFrames * VADPCM_FRAME_BYTES) != 0 ||
+            memcmp(out[0], out[2], nFrames * VADPCM_FRAME_BYTES) != 0)
+        {
+            fprintf(stderr, "%s: encoders disagree\n", files[i]);
+            failed = 1;
+        }
+        for (q = 0; q < 3; q++)
+        {
+            free(out[q]);
+        }
+        free(samples);
+        totalFrames += nFrames;
+    }
+    fclose(tfile);
+    if (totalFrames == 0)
+    {
+        return failed;
+    }
+
+    printf("%ld frames in %ld files\n", totalFrames, (long) nfiles);
+    printf("vencodeframe:          %8.3f s %10.0f frames/s\n", times[0], totalFrames / times[0]);
+    printf("vadpcm_encode:         %8.3f s %10.0f frames/s\n", times[1], totalFrames / times[1]);
+    printf("vadpcm_encode, -j %-3ld %8.3f s %10.0f frames/s\n", (long) threads, times[2], totalFrames / times[2]);
+    return failed;
+}
+
+#endif
+
 int main(int argc, char **argv)
 {
     s32 c;
@@ -60,6 +362,12 @@ int main(int argc, char **argv)
     FILE *fhandle;
     FILE *ifile;
     FILE *ofile;
+#ifndef __sgi
+    s32 reference = 0;
+    s32 threads = 1;
+    s32 bench = 0;
+    FrameQueue queue;
+#endif
 
     if (argc < 2)
     {
@@ -67,7 +375,11 @@ int main(int argc, char **argv)
         exit(1);
     }
 
+#ifdef __sgi
     while ((c = getopt(argc, argv, "tc:l:")) != -1)
+#else
+    while ((c = getopt(argc, argv, "tc:l:j:rb")) != -1)
+#endif
     {
         switch (c)
         {
@@ -95,11 +407,32 @@ int main(int argc, char **argv)
             sscanf(optarg, "%d", &minLoopLength);
             break;
 
+#ifndef __sgi
+        case 'j':
+            sscanf(optarg, "%d", &threads);
+            break;
+
+        case 'r':
+            reference = 1;
+            break;
+
+        case 'b':
+            bench = 1;
+            break;
+#endif
+
         default:
             break;
         }
     }
 
+#ifndef __sgi
+    if (bench)
+    {
+        return benchmark(argv + optind, argc - optind, coefTable, order, npredictors, threads);
+    }
+#endif
+
     if (coefTable == 0)
     {
         fprintf(stderr, "You should specify a coefficient codebook with the [-c] option\n");
@@ -118,6 +451,10 @@ int main(int argc, char **argv)
         exit(1);
     }
 
+#ifndef __sgi
+    initframequeue(&queue, coefTable, order, npredictors, reference, threads);
+#endif
+
     state = malloc(16 * sizeof(s32));
     for (i = 0; i < 16; i++)
     {
@@ -377,7 +714,11 @@ int main(int argc, char **argv)
                 if (fread(inBuffer, sizeof(s16), 16, ifile) == 16)
                 {
                     BSWAP16_MANY(inBuffer, 16)
+#ifdef __sgi
                     vencodeframe(ofile, inBuffer, state, coefTable, order, npredictors, 16);
+#else
+                    queueframe(&queue, inBuffer, 16);
+#endif
                     currentPos += 16;
                     nBytes += 9;
                 }
@@ -388,6 +729,9 @@ int main(int argc, char **argv)
                 }
             }
 
+#ifndef __sgi
+            flushframes(ofile, &queue, state);
+#endif
             for (j = 0; j < 16; j++)
             {
                 if (state[j] >= 0x8000)
@@ -409,7 +753,11 @@ int main(int argc, char **argv)
                     if (fread(inBuffer, sizeof(s16), 16, ifile) == 16)
                     {
                         BSWAP16_MANY(inBuffer, 16)
+#ifdef __sgi
                         vencodeframe(ofile, inBuffer, state, coefTable, order, npredictors, 16);
+#else
+                        queueframe(&queue, inBuffer, 16);
+#endif
                         nBytes += 9;
                     }
                 }
@@ -419,7 +767,11 @@ int main(int argc, char **argv)
                 fseek(ifile, startPointer, SEEK_SET);
                 fread(inBuffer + left, sizeof(s16), 16 - left, ifile);
                 BSWAP16_MANY(inBuffer + left, 16 - left)
+#ifdef __sgi
                 vencodeframe(ofile, inBuffer, state, coefTable, order, npredictors, 16);
+#else
+                queueframe(&queue, inBuffer, 16);
+#endif
                 nBytes += 9;
                 currentPos = aloops[i].start - left + 16;
                 nRepeats--;
@@ -449,7 +801,11 @@ int main(int argc, char **argv)
         if (fread(inBuffer, 2, nsam, ifile) == nsam)
         {
             BSWAP16_MANY(inBuffer, nsam)
+#ifdef __sgi
             vencodeframe(ofile, inBuffer, state, coefTable, order, npredictors, nsam);
+#else
+            queueframe(&queue, inBuffer, nsam);
+#endif
             currentPos += nsam;
             nBytes += 9;
         }
@@ -460,6 +816,10 @@ int main(int argc, char **argv)
         }
     }
 
+#ifndef __sgi
+    flushframes(ofile, &queue, state);
+#endif
+
     if (nBytes % 2)
     {
         nBytes++;
@@ -0,0 +1,459 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "vadpcm.h"
+
+// Each half frame of 8 samples is predicted from the 'order' samples before it
+// and from its own residuals, so with the codebook expanded into a matrix per
+// predictor a half frame is one matrix-vector product. The arithmetic is that
+// of the encoder's model, as in aifc_decode's original decoder: sums wrap at
+// 32 bits, are shifted down by 11 rounding towards minus infinity, and the
+// decoded samples are kept unclamped for predicting the next half.
+//
+// The encoder is vadpcm_enc's, down to its float rounding, so that it writes
+// the same bitstream. Frames depend on each other only through the last
+// 'order' samples of the state, so a long run can be split across threads:
+// each thread but the first guesses the state its part starts with and warms
+// up on the frames before it. The state it ends up with usually converges to
+// the real one, and the parts are then checked in order, re-encoding frames
+// from the real state until they agree with what the thread found. To tell
+// when it won't, the thread also warms up from silence, and if the two
+// warm-ups don't end in the same state it leaves its part to be encoded
+// serially rather than encode it twice.
+
+// defines
+
+// frames a thread encodes before its part, to let a guessed state converge
+#define ENCODE_WARMUP_FRAMES 64
+// parts shorter than this aren't worth a thread
+#define ENCODE_MIN_FRAMES_PER_THREAD 2048
+#define ENCODE_MAX_THREADS 64
+
+// functions
+
+int vadpcm_book_init(vadpcm_book_t *book, const short *entries, int order, int npredictors)
+{
+   if (order < 1 || order > VADPCM_MAX_ORDER ||
+       npredictors < 1 || npredictors > VADPCM_MAX_PREDICTORS) {
+      return 0;
+   }
+
+   memset(book, 0, sizeof(*book));
+   book->order = order;
+   book->npredictors = npredictors;
+
+   int pad = order & 1;
+   for (int p = 0; p < npredictors; p++) {
+      const short *rows = entries + p * order * 8;
+      for (int i = 0; i < 8; i++) {
+         for (int j = 0; j < order; j++) {
+            book->coefs[p][j][i] = rows[j * 8 + i];
+         }
+         // residual k feeds forward into later outputs through the last row;
+         // its own output gets it with weight 2048, added after the shift
+         for (int k = 0; k < i; k++) {
+            book->coefs[p][order + k][i] = rows[(order - 1) * 8 + i - k - 1];
+         }
+      }
+
+      for (int v = 0; v < order + 8; v++) {
+         int q = (v + pad) / 2;
+         int h = (v + pad) % 2;
+         for (int i = 0; i < 8; i++) {
+            book->pairs[p][q][i * 2 + h] = (short)book->coefs[p][v][i];
+         }
+      }
+   }
+   return 1;
+}
+
+static void decode_half_scalar(const vadpcm_book_t *book, int p, const int *prev, const int *ix, int *out)
+{
+   int order = book->order;
+   for (int i = 0; i < 8; i++) {
+      unsigned int acc = 0;
+      for (int j = 0; j < order; j++) {
+         acc += (unsigned int)prev[j] * (unsigned int)book->coefs[p][j][i];
+      }
+      for (int k = 0; k < i; k++) {
+         acc += (unsigned int)ix[k] * (unsigned int)book->coefs[p][order + k][i];
+      }
+      out[i] = ((int)acc >> 11) + ix[i];
+   }
+}
+
+#ifdef __SSE2__
+// broadcast the 16-bit pair at index q of in to all lanes and multiply-add it
+// with the coefficients of that pair for outputs 0-3 and 4-7
+#define MADD_PAIR(in, q, coefs, lo, hi) do { \
+   __m128i pair = _mm_shuffle_epi32(in, _MM_SHUFFLE(q, q, q, q)); \
+   lo = _mm_add_epi32(lo, _mm_madd_epi16(pair, _mm_loadu_si128((const __m128i *)&coefs[q][0]))); \
+   hi = _mm_add_epi32(hi, _mm_madd_epi16(pair, _mm_loadu_si128((const __m128i *)&coefs[q][8]))); \
+} while (0)
+
+// multiplies in 16 bits, so only for half frames whose previous samples and
+// residuals all fit
+static void decode_half_sse2(const vadpcm_book_t *book, int p, const int *prev, const int *ix, int *out)
+{
+   const short (*coefs)[16] = book->pairs[p];
+   short in[16] = {0};
+   int pad = book->order & 1;
+
+   for (int j = 0; j < book->order; j++) {
+      in[pad + j] = (short)prev[j];
+   }
+   for (int k = 0; k < 8; k++) {
+      in[pad + book->order + k] = (short)ix[k];
+   }
+
+   __m128i in0 = _mm_loadu_si128((const __m128i *)&in[0]);
+   __m128i in1 = _mm_loadu_si128((const __m128i *)&in[8]);
+   __m128i lo = _mm_setzero_si128();
+   __m128i hi = _mm_setzero_si128();
+   MADD_PAIR(in0, 0, coefs, lo, hi);
+   MADD_PAIR(in0, 1, coefs, lo, hi);
+   MADD_PAIR(in0, 2, coefs, lo, hi);
+   MADD_PAIR(in0, 3, coefs, lo, hi);
+   // there are always more than 8 inputs, and the unused pairs are zero
+   coefs += 4;
+   MADD_PAIR(in1, 0, coefs, lo, hi);
+   MADD_PAIR(in1, 1, coefs, lo, hi);
+   MADD_PAIR(in1, 2, coefs, lo, hi);
+   MADD_PAIR(in1, 3, coefs, lo, hi);
+
+   lo = _mm_add_epi32(_mm_srai_epi32(lo, 11), _mm_loadu_si128((const __m128i *)&ix[0]));
+   hi = _mm_add_epi32(_mm_srai_epi32(hi, 11), _mm_loadu_si128((const __m128i *)&ix[4]));
+   _mm_storeu_si128((__m128i *)&out[0], lo);
+   _mm_storeu_si128((__m128i *)&out[4], hi);
+}
+
+static int fits_s16(const int *values, int count)
+{
+   for (int i = 0; i < count; i++) {
+      if (values[i] < -0x8000 || values[i] > 0x7fff) {
+         return 0;
+      }
+   }
+   return 1;
+}
+#endif
+
+static void decode_half(const vadpcm_book_t *book, int p, int shift, const int *prev, const int *ix, int *out)
+{
+#ifdef __SSE2__
+   // residuals are at most 8 << shift in size
+   if (shift <= 12 && fits_s16(prev, book->order)) {
+      decode_half_sse2(book, p, prev, ix, out);
+      return;
+   }
+#else
+   (void)shift;
+#endif
+   decode_half_scalar(book, p, prev, ix, out);
+}
+
+int vadpcm_decode_frame(const vadpcm_book_t *book, const unsigned char *frame, int *state)
+{
+   int shift = frame[0] >> 4;
+   int p = frame[0] & 0xf;
+   int ix[16];
+
+   if (p >= book->npredictors) {
+      return 0;
+   }
+
+   for (int i = 0; i < 8; i++) {
+      // sign extend each nibble, then scale
+      ix[i * 2] = (int)((unsigned int)((signed char)frame[1 + i] >> 4) << shift);
+      ix[i * 2 + 1] = (int)((unsigned int)((signed char)(frame[1 + i] << 4) >> 4) << shift);
+   }
+
+   // the first half follows the last samples of the previous frame, which it
+   // doesn't overwrite, and the second half follows the first
+   decode_half(book, p, shift, &state[16 - book->order], &ix[0], &state[0]);
+   decode_half(book, p, shift, &state[8 - book->order], &ix[8], &state[8]);
+   return 1;
+}
+
+int vadpcm_decode(const vadpcm_book_t *book, const unsigned char *frames, int nframes, int *state, short *out)
+{
+   for (int f = 0; f < nframes; f++) {
+      if (!vadpcm_decode_frame(book, frames + f * VADPCM_FRAME_BYTES, state)) {
+         return f;
+      }
+      for (int i = 0; i < VADPCM_FRAME_SAMPLES; i++) {
+         int s = state[i];
+         out[f * VADPCM_FRAME_SAMPLES + i] = (short)(s < -0x8000 ? -0x8000 : s > 0x7fff ? 0x7fff : s);
+      }
+   }
+   return nframes;
+}
+
+// residuals the predictor leaves on a half frame, without quantization, each
+// prediction taking the residuals before it into account
+static void predict_half(const vadpcm_book_t *book, int p, const int *prev, const short *samples, int *err)
+{
+   const int (*coefs)[8] = book->coefs[p];
+   int order = book->order;
+   unsigned int acc[8] = {0};
+
+   for (int j = 0; j < order; j++) {
+      for (int i = 0; i < 8; i++) {
+         acc[i] += (unsigned int)prev[j] * (unsigned int)coefs[j][i];
+      }
+   }
+   for (int k = 0; k < 8; k++) {
+      err[k] = samples[k] - ((int)acc[k] >> 11);
+      // coefs[order + k][i] is 0 for i <= k
+      for (int i = 0; i < 8; i++) {
+         acc[i] += (unsigned int)err[k] * (unsigned int)coefs[order + k][i];
+      }
+   }
+}
+
+// residual / 2^scale rounded to nearest, as vadpcm_enc's qsample
+static short quantize(float x, int scale)
+{
+   if (x > 0.0f) {
+      return (short)((x / scale) + 0.4999999);
+   } else {
+      return (short)((x / scale) - 0.4999999);
+   }
+}
+
+// quantize a half frame at the given scale, starting from 'prev' and writing
+// the decoded samples to 'out'; returns the largest adjustment clipping to
+// 4 bits needed
+static int quantize_half(const vadpcm_book_t *book, int p, int scale, const int *prev,
+                         const short *samples, short *ix, int *out)
+{
+   const int (*coefs)[8] = book->coefs[p];
+   int order = book->order;
+   unsigned int acc[8] = {0};
+   int maxClip = 0;
+
+   for (int j = 0; j < order; j++) {
+      for (int i = 0; i < 8; i++) {
+         acc[i] += (unsigned int)prev[j] * (unsigned int)coefs[j][i];
+      }
+   }
+   for (int k = 0; k < 8; k++) {
+      int prediction = (int)acc[k] >> 11;
+      int q = quantize((float)samples[k] - (float)prediction, 1 << scale);
+      int clipped = q < -8 ? -8 : q > 7 ? 7 : q;
+      int r;
+      if (abs(clipped - q) > maxClip) {
+         maxClip = abs(clipped - q);
+      }
+      ix[k] = (short)clipped;
+      r = clipped * (1 << scale);
+      out[k] = prediction + r;
+      for (int i = 0; i < 8; i++) {
+         acc[i] += (unsigned int)r * (unsigned int)coefs[order + k][i];
+      }
+   }
+   return maxClip;
+}
+
+void vadpcm_encode_frame(const vadpcm_book_t *book, const short *samples, int *state, unsigned char *frame)
+{
+   int order = book->order;
+   int second[VADPCM_MAX_ORDER];
+   int err[16];
+   int best[16];
+   int saveState[16];
+   short ix[16];
+   float min = 1e30f;
+   int optimalp = 0;
+   int max;
+   int scale;
+
+   // the second half's prediction starts from the input, since the residuals
+   // aren't quantized yet
+   for (int i = 0; i < order; i++) {
+      second[i] = samples[8 - order + i];
+   }
+
+   // pick the predictor with the least squared error
+   for (int p = 0; p < book->npredictors; p++) {
+      float se = 0.0f;
+      predict_half(book, p, &state[16 - order], &samples[0], &err[0]);
+      predict_half(book, p, second, &samples[8], &err[8]);
+      for (int i = 0; i < 16; i++) {
+         float e = (float)err[i];
+         se += e * e;
+      }
+      if (se < min) {
+         min = se;
+         optimalp = p;
+         memcpy(best, err, sizeof(best));
+      }
+   }
+
+   // find the smallest scale that fits the largest residual, clamped to 16
+   // bits, into 4; on a tie the first residual wins, as in vadpcm_enc
+   max = 0;
+   for (int i = 0; i < 16; i++) {
+      float e = (float)best[i];
+      int ie;
+      if (e > 32767.0f) {
+         e = 32767.0f;
+      }
+      if (e < -32768.0f) {
+         e = -32768.0f;
+      }
+      ie = e > 0.0f ? (int)(e + 0.5) : (int)(e - 0.5);
+      if (abs(ie) > abs(max)) {
+         max = ie;
+      }
+   }
+   for (scale = 0; scale <= 12; scale++) {
+      if (max <= 7 && max >= -8) {
+         break;
+      }
+      max /= 2;
+   }
+   if (scale > 12) {
+      scale = 12;
+   }
+
+   // quantize, and if that needed clipping by more than 1, try once more at
+   // the next scale
+   memcpy(saveState, state, sizeof(saveState));
+   for (int nIter = 0; nIter < 2; nIter++) {
+      int clip0, clip1;
+      if (nIter > 0 && scale < 12) {
+         scale++;
+      }
+      clip0 = quantize_half(book, optimalp, scale, &saveState[16 - order], &samples[0], &ix[0], &state[0]);
+      clip1 = quantize_half(book, optimalp, scale, &state[8 - order], &samples[8], &ix[8], &state[8]);
+      if (clip0 < 2 && clip1 < 2) {
+         break;
+      }
+   }
+
+   frame[0] = (unsigned char)((scale << 4) | (optimalp & 0xf));
+   for (int i = 0; i < 16; i += 2) {
+      frame[1 + i / 2] = (unsigned char)(((ix[i] & 0xf) << 4) | (ix[i + 1] & 0xf));
+   }
+}
+
+typedef struct
+{
+   const vadpcm_book_t *book;
+   const short *samples;
+   unsigned char *frames;
+   // last 'order' samples of the state after each frame of the part
+   int *tails;
+   int start;
+   int end;
+   // the state the part starts with, real for the first part and guessed for
+   // the others, replaced by the state it ends with
+   int state[16];
+   // whether the part was encoded, which it isn't if its warm-ups disagree
+   int encoded;
+} encode_part_t;
+
+static void *encode_part(void *arg)
+{
+   encode_part_t *part = arg;
+   const vadpcm_book_t *book = part->book;
+   int order = book->order;
+   unsigned char scratch[VADPCM_FRAME_BYTES];
+   int silence[16] = {0};
+
+   for (int f = part->start - ENCODE_WARMUP_FRAMES; f < part->start; f++) {
+      if (f >= 0) {
+         vadpcm_encode_frame(book, &part->samples[f * VADPCM_FRAME_SAMPLES], part->state, scratch);
+         if (part->start > 0) {
+            vadpcm_encode_frame(book, &part->samples[f * VADPCM_FRAME_SAMPLES], silence, scratch);
+         }
+      }
+   }
+   part->encoded = part->start == 0 ||
+                   memcmp(&part->state[16 - order], &silence[16 - order], order * sizeof(int)) == 0;
+   if (!part->encoded) {
+      return NULL;
+   }
+   for (int f = part->start; f < part->end; f++) {
+      vadpcm_encode_frame(book, &part->samples[f * VADPCM_FRAME_SAMPLES], part->state, &part->frames[f * VADPCM_FRAME_BYTES]);
+      if (part->tails) {
+         memcpy(&part->tails[f * order], &part->state[16 - order], order * sizeof(int));
+      }
+   }
+   return NULL;
+}
+
+void vadpcm_encode(const vadpcm_book_t *book, const short *samples, int nframes, int *state, unsigned char *frames, int threads)
+{
+   encode_part_t parts[ENCODE_MAX_THREADS];
+   pthread_t tids[ENCODE_MAX_THREADS];
+   int started[ENCODE_MAX_THREADS];
+   int order = book->order;
+   int *tails;
+
+   if (threads > nframes / ENCODE_MIN_FRAMES_PER_THREAD) {
+      threads = nframes / ENCODE_MIN_FRAMES_PER_THREAD;
+   }
+   if (threads > ENCODE_MAX_THREADS) {
+      threads = ENCODE_MAX_THREADS;
+   }
+   tails = threads > 1 ? malloc(nframes * order * sizeof(*tails)) : NULL;
+   if (tails == NULL) {
+      for (int f = 0; f < nframes; f++) {
+         vadpcm_encode_frame(book, &samples[f * VADPCM_FRAME_SAMPLES], state, &frames[f * VADPCM_FRAME_BYTES]);
+      }
+      return;
+   }
+
+   for (int t = 0; t < threads; t++) {
+      encode_part_t *part = &parts[t];
+      part->book = book;
+      part->samples = samples;
+      part->frames = frames;
+      part->tails = tails;
+      part->start = (int)((long long)nframes * t / threads);
+      part->end = (int)((long long)nframes * (t + 1) / threads);
+      if (t == 0) {
+         memcpy(part->state, state, sizeof(part->state));
+      } else {
+         // guess that decoding reproduces the input before the warm-up
+         int f = part->start - ENCODE_WARMUP_FRAMES - 1;
+         for (int i = 0; i < 16; i++) {
+            part->state[i] = f >= 0 ? samples[f * VADPCM_FRAME_SAMPLES + i] : state[i];
+         }
+      }
+   }
+   // a part whose thread couldn't be started, or that its thread didn't
+   // encode, is encoded serially below
+   for (int t = 1; t < threads; t++) {
+      parts[t].encoded = 0;
+      started[t] = pthread_create(&tids[t], NULL, encode_part, &parts[t]) == 0;
+   }
+   encode_part(&parts[0]);
+   memcpy(state, parts[0].state, sizeof(parts[0].state));
+
+   for (int t = 1; t < threads; t++) {
+      encode_part_t *part = &parts[t];
+      if (started[t]) {
+         pthread_join(tids[t], NULL);
+      }
+      // re-encode from the real state until a frame leaves the same tail as
+      // the thread's; the frames after that are then the same too
+      for (int f = part->start; f < part->end; f++) {
+         vadpcm_encode_frame(book, &samples[f * VADPCM_FRAME_SAMPLES], state, &frames[f * VADPCM_FRAME_BYTES]);
+         if (part->encoded && memcmp(&state[16 - order], &tails[f * order], order * sizeof(int)) == 0) {
+            if (f < part->end - 1) {
+               memcpy(state, part->state, sizeof(part->state));
+            }
+            break;
+         }
+      }
+   }
+   free(tails);
+}
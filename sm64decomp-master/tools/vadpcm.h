@@ -0,0 +1,69 @@
+#ifndef VADPCM_H_
+#define VADPCM_H_
+
+// defines
+
+#define VADPCM_FRAME_BYTES 9
+#define VADPCM_FRAME_SAMPLES 16
+#define VADPCM_MAX_ORDER 8
+#define VADPCM_MAX_PREDICTORS 16
+
+// typedefs
+
+// predictor matrices for decoding, see vadpcm_book_init
+typedef struct
+{
+   int order;
+   int npredictors;
+   // coefs[p][v][i]: coefficient of input v in output i of a half frame, where
+   // the inputs are the 'order' samples before the half frame followed by its
+   // 8 scaled residuals
+   int coefs[VADPCM_MAX_PREDICTORS][VADPCM_MAX_ORDER + 8][8];
+   // the same coefficients as pairs of 16-bit values, inputs 2q and 2q + 1 for
+   // each output in turn, with the previous samples padded to an even count
+   short pairs[VADPCM_MAX_PREDICTORS][VADPCM_MAX_ORDER / 2 + 4][16];
+} vadpcm_book_t;
+
+// function prototypes
+
+// build the predictor matrices for a codebook
+// book: book to initialize
+// entries: codebook as stored in a VADPCMCODES chunk, npredictors * order * 8 values
+// order: number of previous samples each prediction uses, 1 to VADPCM_MAX_ORDER
+// npredictors: number of predictors, 1 to VADPCM_MAX_PREDICTORS
+// returns 1 on success, 0 if order or npredictors is out of range
+int vadpcm_book_init(vadpcm_book_t *book, const short *entries, int order, int npredictors);
+
+// decode one frame
+// book: book from vadpcm_book_init
+// frame: VADPCM_FRAME_BYTES bytes of encoded data
+// state: the previous frame's 16 decoded samples, replaced by this frame's;
+//        samples are not clamped, so that decoding follows the encoder's model
+// returns 1 on success, 0 if the frame uses a predictor the book doesn't have
+int vadpcm_decode_frame(const vadpcm_book_t *book, const unsigned char *frame, int *state);
+
+// decode a run of frames into 16-bit samples
+// book: book from vadpcm_book_init
+// frames: nframes * VADPCM_FRAME_BYTES bytes of encoded data
+// state: as for vadpcm_decode_frame, left holding the last frame's samples
+// out: buffer for nframes * VADPCM_FRAME_SAMPLES samples, clamped to 16 bits
+// returns the number of frames decoded, which is short of nframes on a bad predictor
+int vadpcm_decode(const vadpcm_book_t *book, const unsigned char *frames, int nframes, int *state, short *out);
+
+// encode one frame, choosing the predictor and scale the way vadpcm_enc does
+// book: book from vadpcm_book_init
+// samples: VADPCM_FRAME_SAMPLES samples
+// state: as for vadpcm_decode_frame
+// frame: buffer for VADPCM_FRAME_BYTES bytes of encoded data
+void vadpcm_encode_frame(const vadpcm_book_t *book, const short *samples, int *state, unsigned char *frame);
+
+// encode a run of frames, the same as calling vadpcm_encode_frame on each
+// book: book from vadpcm_book_init
+// samples: nframes * VADPCM_FRAME_SAMPLES samples
+// nframes: number of frames
+// state: as for vadpcm_decode_frame, left holding the last frame's samples
+// frames: buffer for nframes * VADPCM_FRAME_BYTES bytes of encoded data
+// threads: number of threads to split the run across
+void vadpcm_encode(const vadpcm_book_t *book, const short *samples, int nframes, int *state, unsigned char *frames, int threads);
+
+#endif // VADPCM_H_